@@ -0,0 +1,171 @@
+#include "cutlistBatch.h"
+
+// Throughput benchmark for optimizeCutlistBatch. Builds a night's worth of small orders, a fifth of them repeats of
+// earlier ones, and reports orders per second for one optimizeCutlist call per order against the batch API with and
+// without reuse of identical orders, on 1..maxThreads threads. Every batch result is checked against the plain calls.
+// Then writes the orders as CSV and binary order files in memory and reports how fast readCutlistOrders gets them back.
+//
+// Usage: bench_cutlist_batch [orderCount] [maxThreads]
+
+#define BENCH_MAX_PIECES 30
+
+// Same LCG on every platform, so the orders do not depend on the C library's rand()
+static unsigned int nextRandom(unsigned int *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 16;
+}
+
+int main(int argc, char **argv)
+{
+    size_t order_count = (argc > 1) ? (size_t)atol(argv[1]) : 20000;
+    int max_threads = (argc > 2) ? atoi(argv[2]) : 4;
+    if (order_count < 1) order_count = 1;
+    if (max_threads < 1) max_threads = 1;
+
+    int *pieces = (int *)malloc(order_count * BENCH_MAX_PIECES * sizeof(int));
+    int *expected_assignments = (int *)malloc(order_count * BENCH_MAX_PIECES * sizeof(int));
+    int *assignments = (int *)malloc(order_count * BENCH_MAX_PIECES * sizeof(int));
+    CutlistInput *inputs = (CutlistInput *)calloc(order_count, sizeof(CutlistInput));
+    CutlistResult *expected = (CutlistResult *)calloc(order_count, sizeof(CutlistResult));
+    CutlistResult *results = (CutlistResult *)calloc(order_count, sizeof(CutlistResult));
+    if (!pieces || !expected_assignments || !assignments || !inputs || !expected || !results)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    // Orders of 8 to 30 pieces from a catalogue of 6 lengths each, on 6 m bars
+    unsigned int seed = 2024;
+    for (size_t order = 0; order < order_count; order++)
+    {
+        int *order_pieces = &pieces[order * BENCH_MAX_PIECES];
+        inputs[order].requiredPieces = order_pieces;
+        inputs[order].stockLength = 6000;
+
+        if ((order > 0) && (nextRandom(&seed) % 5 == 0))
+        {
+            size_t original = nextRandom(&seed) % order;
+            inputs[order].pieceCount = inputs[original].pieceCount;
+            memcpy(order_pieces, inputs[original].requiredPieces, (size_t)inputs[order].pieceCount * sizeof(int));
+            continue;
+        }
+
+        int lengths[6];
+        for (int length_index = 0; length_index < 6; length_index++)
+        {
+            lengths[length_index] = 300 + (int)(nextRandom(&seed) % 2700);
+        }
+        inputs[order].pieceCount = 8 + (int)(nextRandom(&seed) % (BENCH_MAX_PIECES - 7));
+        for (int piece_index = 0; piece_index < inputs[order].pieceCount; piece_index++)
+        {
+            order_pieces[piece_index] = lengths[nextRandom(&seed) % 6];
+        }
+    }
+
+    for (size_t order = 0; order < order_count; order++)
+    {
+        expected[order].assignments = &expected_assignments[order * BENCH_MAX_PIECES];
+        results[order].assignments = &assignments[order * BENCH_MAX_PIECES];
+    }
+
+    printf("%-26s | %-8s | %-12s | %-8s\n", "Mode", "Threads", "Orders/sec", "Speedup");
+    printf("---------------------------+----------+--------------+---------\n");
+
+    double start = getCutlistWallSeconds();
+    for (size_t order = 0; order < order_count; order++)
+    {
+        optimizeCutlist(inputs[order], &expected[order]);
+    }
+    double baseline_rate = order_count / (getCutlistWallSeconds() - start);
+    printf("%-26s | %-8d | %12.0f | %7.2fx\n", "optimizeCutlist per order", 1, baseline_rate, 1.0);
+
+    int mismatches = 0;
+    for (int reuse = 0; reuse <= 1; reuse++)
+    {
+        for (int thread_count = 1; thread_count <= max_threads; thread_count++)
+        {
+            CutlistBatchOptions options = {thread_count, reuse};
+
+            start = getCutlistWallSeconds();
+            optimizeCutlistBatch(inputs, results, order_count, &options);
+            double rate = order_count / (getCutlistWallSeconds() - start);
+            printf("%-26s | %-8d | %12.0f | %7.2fx\n", reuse ? "batch, reusing repeats" : "batch", thread_count, rate, rate / baseline_rate);
+
+            for (size_t order = 0; order < order_count; order++)
+            {
+                if ((results[order].stockUsed != expected[order].stockUsed) ||
+                    (memcmp(results[order].assignments, expected[order].assignments, (size_t)inputs[order].pieceCount * sizeof(int)) != 0))
+                {
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    printf("\n%-26s | %-8s | %-12s | %-8s\n", "Order file", "MB", "Orders/sec", "MB/sec");
+    printf("---------------------------+----------+--------------+---------\n");
+    for (int format = CUTLIST_ORDER_CSV; format <= CUTLIST_ORDER_BINARY; format++)
+    {
+        CutlistSink sink;
+        initCutlistGrowableSink(&sink);
+        writeCutlistOrderHeader(&sink, (CutlistOrderFormat)format);
+        for (size_t order = 0; order < order_count; order++)
+        {
+            writeCutlistOrder(&sink, (CutlistOrderFormat)format, (long long)order, &inputs[order]);
+        }
+        if (sink.error != CUTLIST_SINK_OK)
+        {
+            printf("Out of memory\n");
+            return 1;
+        }
+
+        // Best of a few passes, each reading every order back in default-sized chunks
+        CutlistOrder *orders = (CutlistOrder *)malloc(CUTLIST_ORDER_CHUNK_DEFAULT * sizeof(CutlistOrder));
+        double best_seconds = 0;
+        for (int pass = 0; pass < 5; pass++)
+        {
+            CutlistOrderReader *reader = openCutlistOrderReaderFromMemory(sink.buffer, sink.length, (CutlistOrderFormat)format, NULL);
+            size_t read_count = 0;
+            size_t count;
+            start = getCutlistWallSeconds();
+            while ((count = readCutlistOrders(reader, orders, CUTLIST_ORDER_CHUNK_DEFAULT)) > 0)
+            {
+                for (size_t index = 0; index < count; index++, read_count++)
+                {
+                    const CutlistInput *input = &inputs[orders[index].orderId];
+                    if ((orders[index].input.pieceCount != input->pieceCount) ||
+                        (memcmp(orders[index].input.requiredPieces, input->requiredPieces, (size_t)input->pieceCount * sizeof(int)) != 0))
+                    {
+                        mismatches++;
+                    }
+                }
+            }
+            double seconds = getCutlistWallSeconds() - start;
+            if ((read_count != order_count) || (getCutlistOrderReaderStatus(reader, NULL) != CUTLIST_READ_OK))
+            {
+                mismatches++;
+            }
+            closeCutlistOrderReader(reader);
+            best_seconds = ((pass == 0) || (seconds < best_seconds)) ? seconds : best_seconds;
+        }
+        double megabytes = sink.length / 1e6;
+        printf("%-26s | %8.2f | %12.0f | %8.1f\n", (format == CUTLIST_ORDER_CSV) ? "CSV" : "binary", megabytes,
+               order_count / best_seconds, megabytes / best_seconds);
+        free(orders);
+        freeCutlistSink(&sink);
+    }
+
+    if (mismatches > 0)
+    {
+        printf("%d batch results or read orders do not match!\n", mismatches);
+    }
+
+    free(pieces);
+    free(expected_assignments);
+    free(assignments);
+    free(inputs);
+    free(expected);
+    free(results);
+    return (mismatches == 0) ? 0 : 1;
+}
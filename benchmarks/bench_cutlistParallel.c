@@ -0,0 +1,80 @@
+#include "cutlistOptimizer.h"
+
+// Thread-scaling benchmark for the parallel search. Solves a fixed set of orders whose optimum is above the lower
+// bound (so the whole tree has to be searched) with 1..maxThreads threads, and checks every thread count returns
+// the single-threaded packing.
+//
+// Usage: bench_cutlist_parallel [maxThreads]
+
+typedef struct {
+    unsigned int seed;
+    int pieceCount;
+} BenchmarkOrder;
+
+static const BenchmarkOrder benchmark_orders[] = {
+    {30, 24},
+    {32, 24},
+    {38, 24},
+    {25, 26},
+};
+
+// Same LCG on every platform, so the orders do not depend on the C library's rand()
+static void generateOrder(BenchmarkOrder order, int *pieces)
+{
+    unsigned int seed = order.seed;
+    for (int piece_index = 0; piece_index < order.pieceCount; piece_index++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        pieces[piece_index] = 200 + (int)((seed >> 16) % 400);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = (argc > 1) ? atoi(argv[1]) : 8;
+    if (max_threads < 1) max_threads = 1;
+
+    int order_count = (int)(sizeof(benchmark_orders) / sizeof(benchmark_orders[0]));
+    int pieces[64];
+    int baseline_assignments[sizeof(benchmark_orders) / sizeof(benchmark_orders[0])][64];
+    int assignments[64];
+    double baseline_seconds = 0.0;
+    int mismatches = 0;
+
+    printf("%-8s | %-12s | %-8s\n", "Threads", "Seconds", "Speedup");
+    printf("---------+--------------+---------\n");
+
+    for (int thread_count = 1; thread_count <= max_threads; thread_count++)
+    {
+        double total_seconds = 0.0;
+
+        for (int order_index = 0; order_index < order_count; order_index++)
+        {
+            BenchmarkOrder order = benchmark_orders[order_index];
+            generateOrder(order, pieces);
+
+            CutlistInput input = {pieces, order.pieceCount, 1000, CUTLIST_TRACE_OFF, thread_count, CUTLIST_STRATEGY_BRANCH_AND_BOUND};
+            CutlistResult result;
+            result.assignments = (thread_count == 1) ? baseline_assignments[order_index] : assignments;
+
+            double start = getCutlistWallSeconds();
+            optimizeCutlist(input, &result);
+            total_seconds += getCutlistWallSeconds() - start;
+
+            if ((thread_count > 1) &&
+                (memcmp(baseline_assignments[order_index], assignments, (size_t)order.pieceCount * sizeof(int)) != 0))
+            {
+                printf("Order %d with %d threads does not match the serial packing!\n", order_index, thread_count);
+                mismatches++;
+            }
+        }
+
+        if (thread_count == 1)
+        {
+            baseline_seconds = total_seconds;
+        }
+        printf("%-8d | %12.4f | %7.2fx\n", thread_count, total_seconds, baseline_seconds / total_seconds);
+    }
+
+    return (mismatches == 0) ? 0 : 1;
+}
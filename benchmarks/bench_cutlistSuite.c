@@ -0,0 +1,416 @@
+#include "cutlistOptimizer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Performance suite and regression gate for the solver. Solves seeded orders from four generators, 5 to 10,000 pieces,
+// in every solver mode, and reports wall time, search nodes, nodes per second and the process's peak RSS for each.
+// Every case runs on a warmed-up solver with a node budget, so serial node counts are the same on every machine and
+// catch search regressions exactly; wall times catch everything else. Compared against a stored JSON baseline, any
+// case that explores more nodes or uses more stock than the baseline by more than the threshold fails, and so does
+// any case slower by more than the time threshold. Wall times are noisy on shared machines, so that one is looser.
+//
+// Usage: bench_cutlist_suite [--filter text] [--repetitions n] [--output file.json]
+//                            [--baseline file.json] [--threshold fraction] [--time-threshold fraction]
+//
+// Regenerate the baseline with --output benchmarks/cutlistSuiteBaseline.json on the machine that gates upgrades
+
+#define SUITE_STOCK_LENGTH 1000
+// Node budget per case is this over the piece count, at most SUITE_MAX_NODE_LIMIT, since a node of a big order costs
+// more to search. Keeps the whole suite within a couple of minutes
+#define SUITE_NODE_WORK 20000000LL
+#define SUITE_MAX_NODE_LIMIT 200000LL
+#define SUITE_THREADS 4
+#define SUITE_MAX_PIECES 10000
+#define SUITE_MAX_CASES 256
+#define SUITE_NAME_LENGTH 64
+
+// Time differences below this are timer noise, never a regression
+#define SUITE_TIME_FLOOR_SECONDS 0.002
+
+typedef enum {
+    GENERATOR_UNIFORM,     // Lengths uniform over a tenth to half a stock
+    GENERATOR_REPEATED,    // Six lengths, each repeated many times
+    GENERATOR_NEAR_EXACT,  // Stocks cut into 2 to 5 parts with at most 2 left over, so the optimum is nearly waste-free
+    GENERATOR_ADVERSARIAL  // Falkenauer triplets: three pieces between a quarter and a half that fill a stock exactly
+} Generator;
+
+static const char *generator_names[] = {"uniform", "repeated", "nearexact", "adversarial"};
+
+typedef struct {
+    const char *name;
+    CutlistStrategy strategy;
+    int threadCount;
+    int useCatalogue;
+    int deterministic;     // Node count is the same on every run
+} SolverMode;
+
+static const SolverMode solver_modes[] = {
+    {"ffd", CUTLIST_STRATEGY_FIRST_FIT_DECREASING, 1, 0, 1},
+    {"bfd", CUTLIST_STRATEGY_BEST_FIT_DECREASING, 1, 0, 1},
+    {"bnb", CUTLIST_STRATEGY_BRANCH_AND_BOUND, 1, 0, 1},
+    {"bnb_mt", CUTLIST_STRATEGY_BRANCH_AND_BOUND, SUITE_THREADS, 0, 0},
+    {"patterns", CUTLIST_STRATEGY_PATTERNS, 1, 0, 1},
+    {"exact", CUTLIST_STRATEGY_EXACT, 1, 0, 1},
+    {"catalogue", CUTLIST_STRATEGY_EXACT, 1, 1, 1},
+};
+
+static const int suite_sizes[] = {5, 20, 100, 1000, 10000};
+
+typedef struct {
+    char name[SUITE_NAME_LENGTH];
+    double minSeconds;
+    double meanSeconds;
+    long long nodes;
+    int stockUsed;
+    int provenOptimal;
+    long peakRssKb;
+    int deterministic;
+} CaseResult;
+
+// Same LCG on every platform, so the orders do not depend on the C library's rand()
+static unsigned int nextRandom(unsigned int *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 16;
+}
+
+static int randomBetween(unsigned int *seed, int low, int high)
+{
+    return low + (int)(nextRandom(seed) % (unsigned int)(high - low + 1));
+}
+
+static void generateOrder(Generator generator, unsigned int seed, int *pieces, int pieceCount)
+{
+    int lengths[6];
+    for (int length_index = 0; length_index < 6; length_index++)
+    {
+        lengths[length_index] = randomBetween(&seed, SUITE_STOCK_LENGTH / 10, SUITE_STOCK_LENGTH * 7 / 10);
+    }
+
+    int piece_index = 0;
+    while (piece_index < pieceCount)
+    {
+        switch (generator)
+        {
+        case GENERATOR_UNIFORM:
+            pieces[piece_index++] = randomBetween(&seed, SUITE_STOCK_LENGTH / 10, SUITE_STOCK_LENGTH / 2);
+            break;
+
+        case GENERATOR_REPEATED:
+            pieces[piece_index++] = lengths[nextRandom(&seed) % 6];
+            break;
+
+        case GENERATOR_NEAR_EXACT:
+        {
+            int part_count = randomBetween(&seed, 2, 5);
+            int remaining = SUITE_STOCK_LENGTH - randomBetween(&seed, 0, 2);
+            for (int part = 0; (part < part_count) && (piece_index < pieceCount); part++)
+            {
+                int parts_left = part_count - part;
+                int length = (parts_left == 1) ? remaining : randomBetween(&seed, 1, remaining - parts_left + 1);
+                pieces[piece_index++] = length;
+                remaining -= length;
+            }
+            break;
+        }
+
+        case GENERATOR_ADVERSARIAL:
+        {
+            int first = randomBetween(&seed, SUITE_STOCK_LENGTH * 38 / 100, SUITE_STOCK_LENGTH * 49 / 100);
+            int second = randomBetween(&seed, SUITE_STOCK_LENGTH / 4, (SUITE_STOCK_LENGTH - first) / 2);
+            int triplet[] = {first, second, SUITE_STOCK_LENGTH - first - second};
+            for (int part = 0; (part < 3) && (piece_index < pieceCount); part++)
+            {
+                pieces[piece_index++] = triplet[part];
+            }
+            break;
+        }
+        }
+    }
+
+    // Shuffle, so the generators' structure does not show in the input order
+    for (int index = pieceCount - 1; index > 0; index--)
+    {
+        int other = (int)(nextRandom(&seed) % (unsigned int)(index + 1));
+        int swap = pieces[index];
+        pieces[index] = pieces[other];
+        pieces[other] = swap;
+    }
+}
+
+// Peak resident set size of the whole process so far, in KB
+static long getPeakRssKb(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return (long)(counters.PeakWorkingSetSize / 1024);
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (long)(usage.ru_maxrss / 1024);
+#else
+    return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void runCase(const SolverMode *mode, Generator generator, int pieceCount, int repetitions, const int *pieces,
+                    int *assignments, int *stockTypes, CaseResult *caseResult)
+{
+    // A yard of short, standard and long bars, the long ones cheapest per unit length but few
+    CutlistStockType yard[] = {
+        {SUITE_STOCK_LENGTH * 6 / 10, CUTLIST_STOCK_UNLIMITED, 650},
+        {SUITE_STOCK_LENGTH, CUTLIST_STOCK_UNLIMITED, 1000},
+        {SUITE_STOCK_LENGTH * 3 / 2, pieceCount / 10 + 1, 1400},
+    };
+    long long node_limit = SUITE_NODE_WORK / pieceCount;
+    CutlistSolveOptions options = {0, (node_limit < SUITE_MAX_NODE_LIMIT) ? node_limit : SUITE_MAX_NODE_LIMIT, 0};
+    CutlistInput input = {pieces, pieceCount, SUITE_STOCK_LENGTH, CUTLIST_TRACE_OFF, mode->threadCount, mode->strategy, &options};
+    if (mode->useCatalogue)
+    {
+        input.stockTypes = yard;
+        input.stockTypeCount = 3;
+    }
+
+    CutlistResult result;
+    result.assignments = assignments;
+    result.stockTypeOfStock = stockTypes;
+
+    snprintf(caseResult->name, SUITE_NAME_LENGTH, "%s/%s/%d", mode->name, generator_names[generator], pieceCount);
+    caseResult->minSeconds = 0.0;
+    caseResult->meanSeconds = 0.0;
+    caseResult->deterministic = mode->deterministic;
+
+    CutlistSolver *solver = createCutlistSolver(pieceCount);
+    for (int repetition = 0; repetition < repetitions; repetition++)
+    {
+        double start = getCutlistWallSeconds();
+        solveCutlist(solver, input, &result);
+        double seconds = getCutlistWallSeconds() - start;
+
+        if ((repetition == 0) || (seconds < caseResult->minSeconds))
+        {
+            caseResult->minSeconds = seconds;
+        }
+        caseResult->meanSeconds += seconds / repetitions;
+    }
+
+    caseResult->nodes = result.stats.nodesExpanded;
+    caseResult->stockUsed = result.stockUsed;
+    caseResult->provenOptimal = result.provenOptimal;
+    caseResult->peakRssKb = getPeakRssKb();
+    destroyCutlistSolver(solver);
+}
+
+static int writeResults(const char *path, const CaseResult *results, int caseCount, int repetitions)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return -1;
+    }
+
+    fprintf(file, "{\n  \"context\": {\"repetitions\": %d, \"nodeWork\": %lld, \"stockLength\": %d},\n  \"benchmarks\": [\n",
+            repetitions, SUITE_NODE_WORK, SUITE_STOCK_LENGTH);
+    for (int case_index = 0; case_index < caseCount; case_index++)
+    {
+        const CaseResult *result = &results[case_index];
+        double nodes_per_second = (result->minSeconds > 0) ? result->nodes / result->minSeconds : 0.0;
+        fprintf(file, "    {\"name\": \"%s\", \"wallSeconds\": %.6f, \"meanSeconds\": %.6f, \"nodes\": %lld, \"nodesPerSecond\": %.0f, "
+                      "\"peakRssKb\": %ld, \"stockUsed\": %d, \"provenOptimal\": %d, \"deterministic\": %d}%s\n",
+                result->name, result->minSeconds, result->meanSeconds, result->nodes, nodes_per_second, result->peakRssKb,
+                result->stockUsed, result->provenOptimal, result->deterministic, (case_index + 1 < caseCount) ? "," : "");
+    }
+    fputs("  ]\n}\n", file);
+
+    fclose(file);
+    return 0;
+}
+
+// Reads the value after "key": in text, which must start before end. Returns 0 if the key is not there
+static int readJsonNumber(const char *text, const char *end, const char *key, double *value)
+{
+    char pattern[SUITE_NAME_LENGTH];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+    const char *found = strstr(text, pattern);
+    if (!found || (end && (found >= end)))
+    {
+        return 0;
+    }
+    *value = strtod(found + strlen(pattern), NULL);
+    return 1;
+}
+
+// Compares every case against the baseline written by an earlier --output run. Returns the number of regressions, or
+// -1 if the baseline cannot be read
+static int compareWithBaseline(const char *path, const CaseResult *results, int caseCount, double threshold, double timeThreshold)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = (char *)malloc((size_t)size + 1);
+    if (!text || (fread(text, 1, (size_t)size, file) != (size_t)size))
+    {
+        free(text);
+        fclose(file);
+        return -1;
+    }
+    text[size] = '\0';
+    fclose(file);
+
+    int regressions = 0;
+    printf("\nComparing against %s, threshold %.0f%%, time threshold %.0f%%\n", path, threshold * 100, timeThreshold * 100);
+    for (int case_index = 0; case_index < caseCount; case_index++)
+    {
+        const CaseResult *result = &results[case_index];
+        char pattern[SUITE_NAME_LENGTH + 16];
+        snprintf(pattern, sizeof(pattern), "\"name\": \"%s\"", result->name);
+
+        const char *entry = strstr(text, pattern);
+        if (!entry)
+        {
+            printf("  %-32s not in baseline\n", result->name);
+            continue;
+        }
+        const char *entry_end = strstr(entry + 1, "\"name\":");
+
+        double baseline_seconds = 0, baseline_nodes = 0, baseline_stock = 0;
+        readJsonNumber(entry, entry_end, "wallSeconds", &baseline_seconds);
+        readJsonNumber(entry, entry_end, "nodes", &baseline_nodes);
+        readJsonNumber(entry, entry_end, "stockUsed", &baseline_stock);
+
+        if (result->deterministic && (result->nodes > baseline_nodes * (1 + threshold)))
+        {
+            printf("  %-32s REGRESSION nodes %lld, baseline %.0f\n", result->name, result->nodes, baseline_nodes);
+            regressions++;
+        }
+        if ((result->minSeconds > baseline_seconds * (1 + timeThreshold)) &&
+            (result->minSeconds - baseline_seconds > SUITE_TIME_FLOOR_SECONDS))
+        {
+            printf("  %-32s REGRESSION time %.6fs, baseline %.6fs\n", result->name, result->minSeconds, baseline_seconds);
+            regressions++;
+        }
+        if (result->deterministic && (result->stockUsed > baseline_stock))
+        {
+            printf("  %-32s REGRESSION stock used %d, baseline %.0f\n", result->name, result->stockUsed, baseline_stock);
+            regressions++;
+        }
+    }
+
+    free(text);
+    printf("%d regression%s\n", regressions, (regressions == 1) ? "" : "s");
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *output_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 0.25;
+    double time_threshold = 1.0;
+    int repetitions = 3;
+
+    for (int arg_index = 1; arg_index + 1 < argc; arg_index += 2)
+    {
+        if (strcmp(argv[arg_index], "--filter") == 0) filter = argv[arg_index + 1];
+        else if (strcmp(argv[arg_index], "--output") == 0) output_path = argv[arg_index + 1];
+        else if (strcmp(argv[arg_index], "--baseline") == 0) baseline_path = argv[arg_index + 1];
+        else if (strcmp(argv[arg_index], "--threshold") == 0) threshold = atof(argv[arg_index + 1]);
+        else if (strcmp(argv[arg_index], "--time-threshold") == 0) time_threshold = atof(argv[arg_index + 1]);
+        else if (strcmp(argv[arg_index], "--repetitions") == 0) repetitions = atoi(argv[arg_index + 1]);
+        else
+        {
+            printf("Unknown option %s\n", argv[arg_index]);
+            return 2;
+        }
+    }
+    if (repetitions < 1) repetitions = 1;
+
+    int *pieces = (int *)malloc(SUITE_MAX_PIECES * sizeof(int));
+    int *assignments = (int *)malloc(SUITE_MAX_PIECES * sizeof(int));
+    int *stock_types = (int *)malloc(SUITE_MAX_PIECES * sizeof(int));
+    CaseResult *results = (CaseResult *)calloc(SUITE_MAX_CASES, sizeof(CaseResult));
+    if (!pieces || !assignments || !stock_types || !results)
+    {
+        printf("Out of memory\n");
+        return 2;
+    }
+
+    printf("%-32s %12s %12s %12s %12s %6s %8s %10s\n", "Benchmark", "Time (s)", "Mean (s)", "Nodes", "Nodes/s", "Stock", "Proven", "Peak RSS");
+    printf("--------------------------------------------------------------------------------------------------------------------\n");
+
+    // Sizes ascending, so the peak RSS column shows when memory grows
+    int case_count = 0;
+    int size_count = (int)(sizeof(suite_sizes) / sizeof(suite_sizes[0]));
+    int mode_count = (int)(sizeof(solver_modes) / sizeof(solver_modes[0]));
+    for (int size_index = 0; size_index < size_count; size_index++)
+    {
+        for (int generator = GENERATOR_UNIFORM; generator <= GENERATOR_ADVERSARIAL; generator++)
+        {
+            int piece_count = suite_sizes[size_index];
+            generateOrder((Generator)generator, 1000u + (unsigned int)(generator * 97 + piece_count), pieces, piece_count);
+
+            for (int mode_index = 0; (mode_index < mode_count) && (case_count < SUITE_MAX_CASES); mode_index++)
+            {
+                char name[SUITE_NAME_LENGTH];
+                snprintf(name, sizeof(name), "%s/%s/%d", solver_modes[mode_index].name, generator_names[generator], piece_count);
+                if (filter && !strstr(name, filter))
+                {
+                    continue;
+                }
+
+                CaseResult *result = &results[case_count++];
+                runCase(&solver_modes[mode_index], (Generator)generator, piece_count, repetitions, pieces, assignments, stock_types, result);
+                printf("%-32s %12.6f %12.6f %12lld %12.0f %6d %8s %8ld KB\n", result->name, result->minSeconds, result->meanSeconds,
+                       result->nodes, (result->minSeconds > 0) ? result->nodes / result->minSeconds : 0.0, result->stockUsed,
+                       result->provenOptimal ? "yes" : "no", result->peakRssKb);
+            }
+        }
+    }
+
+    int exit_code = 0;
+    if (output_path && (writeResults(output_path, results, case_count, repetitions) != 0))
+    {
+        printf("Cannot write %s\n", output_path);
+        exit_code = 2;
+    }
+    if (baseline_path)
+    {
+        int regressions = compareWithBaseline(baseline_path, results, case_count, threshold, time_threshold);
+        if (regressions < 0)
+        {
+            printf("Cannot read %s\n", baseline_path);
+            exit_code = 2;
+        }
+        else if (regressions > 0)
+        {
+            exit_code = 1;
+        }
+    }
+
+    free(pieces);
+    free(assignments);
+    free(stock_types);
+    free(results);
+    return exit_code;
+}
@@ -0,0 +1,33 @@
+#ifndef CUTLIST_BATCH_H
+#define CUTLIST_BATCH_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+#include "cutlistReader.h"
+
+typedef struct {
+    int threadCount;          // Threads solving orders side by side, 0 or 1 solves on the calling thread
+    int reuseIdenticalInputs; // 1 to solve byte-identical orders once and copy the result to the others
+} CutlistBatchOptions;
+
+// Solves inputs[i] into results[i] for every order of a batch, each result's assignments supplied by the caller as
+// for optimizeCutlist. Every thread keeps one CutlistSolver for all the orders it takes, and threads take the next
+// unsolved order as they finish, so long orders do not hold up the rest. An order's own threadCount still applies
+// within it, leave it at 0 or 1 when the batch itself runs on several threads. options may be NULL for one thread
+// and no reuse. A reused result keeps the stats of the solve it came from. Every result gets a status; returns the
+// number of orders not solved with CUTLIST_STATUS_OK
+size_t optimizeCutlistBatch(const CutlistInput *inputs, CutlistResult *results, size_t count, const CutlistBatchOptions *options);
+
+// Receives every order of a stream with its result, in file order. Both are only valid during the call
+typedef void (*CutlistOrderResultCallback)(const CutlistOrder *order, const CutlistResult *result, void *userData);
+
+// Solves every order reader yields, chunkOrders at a time (CUTLIST_ORDER_CHUNK_DEFAULT for 0), each chunk with
+// optimizeCutlistBatch, and hands the results to onResult. Only one chunk of orders and their assignments is held at
+// once, so a file of any size streams through in bounded memory. A read that fails ends the stream after the orders
+// before it; getCutlistOrderReaderStatus says why. Returns the number of orders not solved with CUTLIST_STATUS_OK, or
+// SIZE_MAX if the stream's own buffers cannot be allocated
+size_t optimizeCutlistOrderStream(CutlistOrderReader *reader, size_t chunkOrders, const CutlistBatchOptions *options,
+                                  CutlistOrderResultCallback onResult, void *userData);
+
+#endif // CUTLIST_BATCH_H
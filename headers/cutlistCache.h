@@ -0,0 +1,45 @@
+#ifndef CUTLIST_CACHE_H
+#define CUTLIST_CACHE_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+
+// Record bytes a cache keeps by default, 64 MB
+#define CUTLIST_CACHE_DEFAULT_CAPACITY ((size_t)64 << 20)
+
+// Results of solved orders, keyed on the order's canonical form: its pieces as a sorted multiset, the stock length,
+// kerf, trim, strategy, node limit and transposition table size. Orders differing only in piece order share an entry.
+// The least recently used entries are evicted once the records outgrow the capacity. Safe to share between threads
+typedef struct CutlistCache CutlistCache;
+
+typedef struct {
+    long long hits;
+    long long misses;
+    long long stores;
+    long long evictions;
+    long long loadedEntries;      // Read from the store file when the cache was opened
+    size_t entryCount;
+    size_t bytes;                 // Record bytes held, at most capacityBytes
+    size_t capacityBytes;
+    double hitRate;               // hits / (hits + misses), 0 before the first lookup
+} CutlistCacheStats;
+
+// Opens a cache holding up to capacityBytes of records, 0 for CUTLIST_CACHE_DEFAULT_CAPACITY. With a path, the
+// records already stored there are memory-mapped and indexed without being copied, and new ones are appended as they
+// are stored, so the cache is warm straight after a restart. A missing or unreadable store starts empty. path may be
+// NULL for a cache in memory only. Returns NULL if the cache cannot be allocated
+CutlistCache *openCutlistCache(const char *path, size_t capacityBytes);
+
+// Rewrites the store without evicted or damaged records if it holds any, then frees the cache. Returns 0, or -1 if the
+// store could not be rewritten, in which case it keeps what it had
+int closeCutlistCache(CutlistCache *cache);
+
+// solveCutlist through the cache. A hit copies the stored packing back in the caller's piece order, with empty stats
+// and without calling options->onImprovement. Only results that are CUTLIST_STATUS_OK and CUTLIST_STOP_COMPLETED are
+// stored. Inputs with a catalogue, and a NULL cache, go straight to solveCutlist
+int solveCutlistCached(CutlistCache *cache, CutlistSolver *solver, CutlistInput input, CutlistResult *result);
+
+void getCutlistCacheStats(CutlistCache *cache, CutlistCacheStats *stats);
+
+#endif // CUTLIST_CACHE_H
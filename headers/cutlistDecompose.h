@@ -0,0 +1,31 @@
+#ifndef CUTLIST_DECOMPOSE_H
+#define CUTLIST_DECOMPOSE_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+
+// From this many pieces the automatic choice decomposes an order the pattern engine cannot take, since one search
+// over all of its pieces would not get past the greedy packing
+#ifndef CUTLIST_DECOMPOSE_MIN_PIECES
+#define CUTLIST_DECOMPOSE_MIN_PIECES 4096
+#endif
+
+// Most pieces in one window, and the search nodes it may use. A window this size has few enough lengths for the
+// pattern engine, whose LP bound settles most windows, and still finishes or gives up quickly
+#define CUTLIST_DECOMPOSE_WINDOW_PIECES 64
+#define CUTLIST_DECOMPOSE_WINDOW_NODES 20000
+
+// Bytes of scratch findBestPackingByDecomposition needs for pieceCount pieces
+size_t getDecompositionScratchSize(int pieceCount);
+
+// Improves the incumbent packing of a large order window by window. A window is the least-filled stocks, with up to
+// half of CUTLIST_DECOMPOSE_WINDOW_PIECES pieces, and a run of fuller stocks with the rest; its pieces are searched
+// alone with windowSolver for a packing on fewer stocks, and every other stock stays as it is. The run moves up the
+// stocks from one window to the next, and passes over the packing go on while they save a stock and the budget lasts.
+// A window costs O(CUTLIST_DECOMPOSE_WINDOW_PIECES) plus its bounded search, a saved stock O(n + stocks log stocks).
+// state must be prepared as for findBestPacking(state, 0), with an incumbent packing and no catalogue. windowSolver is
+// created on first use and kept for later solves. Returns -1 if it cannot be created, leaving the incumbent as it was
+int findBestPackingByDecomposition(PackingState *state, CutlistSolver **windowSolver, void *scratch);
+
+#endif // CUTLIST_DECOMPOSE_H
@@ -0,0 +1,90 @@
+#ifndef CUTLIST_DEMAND_H
+#define CUTLIST_DEMAND_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+
+// Orders of up to this many pieces are expanded and solved piece by piece, with every engine solveCutlist has. Larger
+// ones are packed pattern by pattern, at a cost that no longer grows with their quantities
+#ifndef CUTLIST_DEMAND_EXPAND_MAX_PIECES
+#define CUTLIST_DEMAND_EXPAND_MAX_PIECES 4096
+#endif
+
+// One length of an order and how many pieces of it are needed
+typedef struct {
+    int length;
+    int quantity;                 // 0 or more
+} CutlistDemand;
+
+// An order as distinct lengths with quantities, for unlimited stocks of stockLength. The other fields are those of
+// CutlistInput
+typedef struct {
+    const CutlistDemand *demands; // Never modified. Lengths may repeat, each demand keeps its own pieces
+    int demandCount;
+    int stockLength;
+    CutlistTraceLevel traceLevel;
+    int threadCount;
+    CutlistStrategy strategy;
+    const CutlistSolveOptions *options;
+    int kerfWidth;
+    int trimLength;
+} CutlistDemandInput;
+
+// Pieces of one demand cut from every stock of a pattern
+typedef struct {
+    int demandIndex;              // Into the input's demands
+    int quantity;
+} CutlistPatternCut;
+
+// One way of cutting a stock, and how many stocks are cut that way
+typedef struct {
+    int repeat;
+    int firstCut;                 // Its cuts are cuts[firstCut, firstCut + cutCount), longest first
+    int cutCount;
+    int waste;                    // Offcut of one stock, counted as CutlistResult.waste is
+} CutlistPattern;
+
+// Outcome of a demand solve: the fields of CutlistResult, with the packing as patterns instead of per-piece
+// assignments. patterns and cuts are allocated by a successful solve and belong to the caller, who frees them with
+// freeCutlistDemandResult; a failed one leaves them NULL
+typedef struct {
+    CutlistPattern *patterns;
+    int patternCount;
+    CutlistPatternCut *cuts;
+    int cutCount;
+    int stockUsed;
+    long long waste;
+    int stockLowerBound;
+    int provenOptimal;
+    double optimalityGap;
+    CutlistStatus status;
+    long long cost;
+    CutlistStats stats;
+    CutlistStopReason stopReason;
+} CutlistDemandResult;
+
+void optimizeCutlistDemand(CutlistDemandInput input, CutlistDemandResult *result);
+
+// Solves an order given as demand. Up to CUTLIST_DEMAND_EXPAND_MAX_PIECES pieces it is solveCutlist on the expanded
+// pieces, the same packing grouped into patterns. Above that it never expands: the greedy packing fills one stock at a
+// time, largest lengths first, and cuts as many stocks to that pattern as the quantities allow, which is the first-fit
+// decreasing packing in O(patterns * lengths). The search strategies then round the Gilmore-Gomory LP over the lengths
+// down to whole stocks and solve what is left, usually a few stocks' worth, with solveCutlist on solver. The LP takes
+// at most CUTLIST_PATTERN_MAX_CLASSES distinct lengths, a stock of at most CUTLIST_PATTERN_MAX_STOCK_LENGTH after trim
+// and kerf, and no zero-size pieces; a larger order outside those limits gets the greedy packing with stopReason
+// CUTLIST_STOP_SEARCH_SKIPPED. The search proves its packing optimal only when it meets the LP or L2 bound. Returns 0,
+// or -1 with result->status saying why
+int solveCutlistDemand(CutlistSolver *solver, CutlistDemandInput input, CutlistDemandResult *result);
+
+void freeCutlistDemandResult(CutlistDemandResult *result);
+
+// Writes every demand's length quantity times into pieces, demand by demand, and returns how many it wrote. The
+// CutlistInput of those pieces is the same order, piece by piece
+int expandCutlistDemand(const CutlistDemand *demands, int demandCount, int *pieces);
+
+// Writes the stock of every piece of expandCutlistDemand into assignments, numbering stocks pattern by pattern, all
+// copies of pattern 0 first. O(pieces). Returns 0, or -1 if its scratch cannot be allocated
+int expandCutlistPatterns(const CutlistDemand *demands, int demandCount, const CutlistDemandResult *result, int *assignments);
+
+#endif // CUTLIST_DEMAND_H
@@ -0,0 +1,69 @@
+#ifndef CUTLIST_FORMAT_H
+#define CUTLIST_FORMAT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cutlistOptimizer.h"
+#include "cutlistDemand.h"
+
+// Bytes the formatter stages before handing them to a sink, so a cut sheet of any size takes this much stack plus
+// one int per piece and per stock
+#define CUTLIST_FORMAT_CHUNK_SIZE 4096
+
+typedef enum {
+    CUTLIST_FORMAT_TEXT = 0,      // "Stock #1: 100, 80" lines, as printed by the trace
+    CUTLIST_FORMAT_CSV,           // "stock,piece,length" header, then one row per piece grouped by stock
+    CUTLIST_FORMAT_JSON           // {"stockCount":n,"stocks":[{"stock":0,"pieces":[{"piece":0,"length":100}]}]}
+} CutlistFormat;
+
+// Where a sink's output goes
+typedef enum {
+    CUTLIST_SINK_FILE = 0,        // Written straight to file
+    CUTLIST_SINK_BUFFER,          // Copied into the caller's buffer, cut short once it is full
+    CUTLIST_SINK_GROWABLE         // Copied into a buffer the sink reallocates as needed, freed by freeCutlistSink
+} CutlistSinkKind;
+
+// First failure of a sink. Once set it sticks, and later writes are dropped or, for a full buffer, only counted
+typedef enum {
+    CUTLIST_SINK_OK = 0,
+    CUTLIST_SINK_TRUNCATED,       // The caller's buffer filled up, length says how big it needs to be
+    CUTLIST_SINK_OUT_OF_MEMORY,   // A growable buffer or the formatter's scratch could not be allocated
+    CUTLIST_SINK_WRITE_FAILED     // fwrite wrote less than it was given
+} CutlistSinkError;
+
+// Destination for formatted output. Buffers are always NUL-terminated, capacity included
+typedef struct {
+    CutlistSinkKind kind;
+    FILE *file;
+    char *buffer;
+    size_t capacity;
+    size_t length;                // Bytes written to the sink, or for a truncated buffer the bytes it would need, NUL excluded
+    CutlistSinkError error;
+} CutlistSink;
+
+void initCutlistFileSink(CutlistSink *sink, FILE *file);
+void initCutlistBufferSink(CutlistSink *sink, char *buffer, size_t capacity);
+void initCutlistGrowableSink(CutlistSink *sink);
+void freeCutlistSink(CutlistSink *sink);
+CutlistSinkError appendToCutlistSink(CutlistSink *sink, const char *data, size_t length);
+
+// Writes the pieces of every stock in stockCount stocks, each stock's pieces in ascending piece index. Groups the
+// pieces with one counting pass over the assignments, O(pieces + stocks) overall. Pieces assigned outside
+// [0, stockCount), like the -1 of an unplaced piece, are left out. CSV and JSON number stocks and pieces from 0 like
+// the assignments do; text numbers stocks from 1. Returns the sink's error, CUTLIST_SINK_OK if all of it got through
+CutlistSinkError writeCutlistAssignments(CutlistSink *sink, CutlistFormat format, const int *pieceSizes,
+                                         const int *assignments, int pieceCount, int stockCount);
+
+// Writes the cut sheet of a solved order: the input's pieces, in the caller's order, on the result's stocks
+CutlistSinkError writeCutlistResult(CutlistSink *sink, CutlistFormat format, const CutlistInput *input,
+                                    const CutlistResult *result);
+
+// Writes the cut sheet of an order solved as demand, one pattern and the stocks cut to it at a time, so its size grows
+// with the patterns rather than the pieces. Text is "12 x Stock: 450 x 13, 300 x 2" lines; CSV a
+// "pattern,stocks,demand,length,quantity" header and one row per cut; JSON
+// {"stockCount":n,"patterns":[{"pattern":0,"stocks":12,"cuts":[{"demand":0,"length":450,"quantity":13}]}]}
+CutlistSinkError writeCutlistPatterns(CutlistSink *sink, CutlistFormat format, const CutlistDemandInput *input,
+                                      const CutlistDemandResult *result);
+
+#endif // CUTLIST_FORMAT_H
@@ -0,0 +1,24 @@
+#ifndef CUTLIST_HEURISTICS_H
+#define CUTLIST_HEURISTICS_H
+
+#include <stddef.h>
+
+// Ints of scratch space packFirstFitDecreasing and packBestFitDecreasing need for pieceCount pieces, whatever the
+// stock length
+size_t getHeuristicScratchSize(int pieceCount);
+
+// Greedy packings of pieces sorted by descending size, both O(n log n). Stocks are numbered in the order they are
+// opened, like the exact search numbers them. Write each piece's stock into assignments and return the stock count
+int packFirstFitDecreasing(const int *sortedPieces, int pieceCount, int stockLength, int *assignments, int *scratch);
+int packBestFitDecreasing(const int *sortedPieces, int pieceCount, int stockLength, int *assignments, int *scratch);
+
+// Greedy packing of pieces sorted by descending size over a catalogue of typeCount kinds of stock, sorted by
+// descending length. Every piece goes into the first open stock with room, or with bestFit the one it leaves the
+// least space on; a new stock is the kind still on hand with the lowest cost per unit length that fits the piece.
+// Afterwards every stock is swapped for the cheapest kind on hand that still holds its pieces. O(n * stocks), needs
+// pieceCount + typeCount ints of scratch. Writes each piece's stock into assignments and each stock's kind into
+// stockTypes, and returns the stock count, or -1 if the stock on hand runs out first
+int packCatalogueDecreasing(const int *sortedPieces, int pieceCount, const int *typeLengths, const int *typeCosts,
+                            const int *typeOnHand, int typeCount, int bestFit, int *assignments, int *stockTypes, int *scratch);
+
+#endif // CUTLIST_HEURISTICS_H
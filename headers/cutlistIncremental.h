@@ -0,0 +1,24 @@
+#ifndef CUTLIST_INCREMENTAL_H
+#define CUTLIST_INCREMENTAL_H
+
+#include "cutlistOptimizer.h"
+
+// Pieces removed from and added to an order since it was solved. The changed order is the previous one without the
+// removed pieces, the others kept in their order, followed by the added pieces
+typedef struct {
+    const int *removedPieces;     // Indices into the previous order, each at most once, in any order
+    int removedCount;
+    int addedCount;               // The last addedCount pieces of the changed order
+} CutlistOrderChange;
+
+// Re-solves a changed order from previous, the result of solving it before the change with the same stock length, kerf
+// and trim. Kept pieces stay on their stocks, stocks left empty are dropped, and added pieces go best fit into the
+// space left or onto new stocks, O(pieces + added * stocks). previous's lower bound, less the stocks that held removed
+// pieces, still holds for the changed order; a repaired packing meeting it, or the length bound, is returned without
+// sorting or searching. Otherwise the repaired packing is the incumbent of a full solve, within input.options' budget.
+// previous->assignments may be result->assignments. Inputs with a catalogue, and previous results that are not
+// CUTLIST_STATUS_OK, are solved from scratch. Returns as solveCutlist does
+int reoptimizeCutlist(CutlistSolver *solver, CutlistInput input, const CutlistResult *previous,
+                      const CutlistOrderChange *change, CutlistResult *result);
+
+#endif // CUTLIST_INCREMENTAL_H
@@ -0,0 +1,22 @@
+#ifndef CUTLIST_KERNELS_H
+#define CUTLIST_KERNELS_H
+
+#include <stdint.h>
+
+// Stocks covered by one getFittingStockMask call
+#define CUTLIST_STOCK_MASK_WIDTH 64
+
+// Bit i is set if stock firstStock + i has at least pieceSize space left. Covers up to CUTLIST_STOCK_MASK_WIDTH stocks
+// from firstStock, never reading past stockCount
+uint64_t getFittingStockMask(const int *remainingSpace, int firstStock, int stockCount, int pieceSize);
+
+// Returns 1 if any stock in [firstStock, lastStock) has exactly space left
+int containsStockSpace(const int *remainingSpace, int firstStock, int lastStock, int space);
+
+// Total space left on stocks in [0, stockCount) that have at least minimumSpace left
+long long sumFittingStockSpace(const int *remainingSpace, int stockCount, int minimumSpace);
+
+// Index of the lowest set bit of a non-zero mask
+int getLowestSetBit(uint64_t mask);
+
+#endif // CUTLIST_KERNELS_H
@@ -0,0 +1,39 @@
+#ifndef CUTLIST_LOCAL_SEARCH_H
+#define CUTLIST_LOCAL_SEARCH_H
+
+#include "cutlistOptimizer.h"
+
+// Moves every search thread tries when neither a move nor a time limit is given
+#define CUTLIST_LOCAL_SEARCH_DEFAULT_MOVES 200000
+
+// Pieces one placement may push out in turn, each smaller than the one before it
+#define CUTLIST_LOCAL_SEARCH_CHAIN_DEPTH 3
+
+// Stocks holding more pieces than this are not emptied piece by piece, only thinned out by the fill moves
+#define CUTLIST_LOCAL_SEARCH_MAX_TARGET_PIECES 256
+
+// Budget and threads of improveCutlistPacking
+typedef struct {
+    double timeLimitSeconds;      // Wall-clock limit, 0 for none
+    long long moveLimit;          // Moves every thread tries, placements and fill moves alike. 0 for none, or
+                                  // CUTLIST_LOCAL_SEARCH_DEFAULT_MOVES when there is no time limit either
+    int threadCount;              // Independent searches side by side, 0 or 1 searches on the calling thread
+    unsigned int seed;            // Thread t searches from a random sequence of its own, drawn from seed and t
+    const atomic_int *cancelRequested; // Set it nonzero from any thread to stop, checked with the budget. NULL for none
+} CutlistLocalSearchOptions;
+
+// Improves result, a packing of input, in place by local search, for packings too large to prove optimal. Every round
+// tries to empty one of the least-filled stocks: its pieces go, largest first, best fit into the other stocks, and a
+// piece that fits nowhere takes the place of a smaller one, which is placed in turn, up to
+// CUTLIST_LOCAL_SEARCH_CHAIN_DEPTH deep. A round that cannot empty its stock is undone and followed by random moves
+// and swaps between stocks that leave the fuller stock fuller, which gathers the offcuts into fewer, longer ones and
+// leaves the next round an emptier stock to try. Moves are priced from the stocks' loads alone, in O(1). The search
+// stops at the budget or at result->stockLowerBound; every thread keeps its best packing, as it never accepts a worse
+// one, and the one with the fewest stocks, then the longest offcuts, then the lowest thread index wins. The outcome is
+// reproducible for a seed and thread count whenever the move limit, not the clock, ends the search. Stocks are
+// renumbered from 0, and stockUsed, waste, cost, the bound fields and stats are brought up to date; moves count as
+// nodes. Only for inputs without a catalogue. Returns 0, or -1 leaving result as it was if it is not a valid
+// CUTLIST_STATUS_OK packing of input or memory runs out
+int improveCutlistPacking(CutlistInput input, const CutlistLocalSearchOptions *options, CutlistResult *result);
+
+#endif // CUTLIST_LOCAL_SEARCH_H
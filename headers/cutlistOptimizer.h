@@ -4,34 +4,275 @@
 #include <stdio.h>
 #include <stdlib.h>  // For malloc and free
 #include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
+// How much of the search is printed to stdout. Anything above CUTLIST_MAX_TRACE_LEVEL is compiled out entirely,
+// build with -DCUTLIST_MAX_TRACE_LEVEL=0 for a solver that never formats or prints
+typedef enum {
+    CUTLIST_TRACE_OFF = 0,   // Silent, the default
+    CUTLIST_TRACE_SUMMARY,   // Lower bound, every improved packing and the final stock assignments
+    CUTLIST_TRACE_FULL       // Every placement and backtrack of the search
+} CutlistTraceLevel;
+
+#ifndef CUTLIST_MAX_TRACE_LEVEL
+#define CUTLIST_MAX_TRACE_LEVEL CUTLIST_TRACE_FULL
+#endif
+
+#define CUTLIST_TRACING(traceLevel, level) ((CUTLIST_MAX_TRACE_LEVEL >= (level)) && ((traceLevel) >= (level)))
+
+// Prints trace output when it is both compiled in (CUTLIST_MAX_TRACE_LEVEL) and requested at runtime (traceLevel).
+// With tracing off the arguments are never evaluated, so the search does no formatting, I/O or allocation
+#define CUTLIST_TRACE(traceLevel, level, ...) \
+    do { if (CUTLIST_TRACING((traceLevel), (level))) { printf(__VA_ARGS__); } } while (0)
+
+// optimalTask of a search that has not found a packing yet
+#define CUTLIST_NO_TASK INT_MAX
+
+// Why the search cut off a subtree, indexing CutlistStats.prunes
+typedef enum {
+    CUTLIST_PRUNE_LOWER_BOUND = 0,  // Its bound on stocks, or on cost with a catalogue, cannot beat the best packing
+    CUTLIST_PRUNE_TRANSPOSITION,    // An equivalent state was already searched to such a bound
+    CUTLIST_PRUNE_SYMMETRY,         // Placing the piece there is equivalent to a placement already tried
+    CUTLIST_PRUNE_REASON_COUNT
+} CutlistPruneReason;
+
+// Improvements of the best packing kept in CutlistStats
+#define CUTLIST_STATS_MAX_IMPROVEMENTS 16
+
+// One improvement of the best packing, the greedy packing included
+typedef struct {
+    double seconds;               // Since the solve started
+    long long nodes;              // Search nodes expanded by then
+    int stockUsed;
+    int waste;
+    long long cost;
+} CutlistImprovement;
+
+// What a solve did and what it cost, collected with plain counters only. Times are wall-clock seconds
+typedef struct {
+    long long nodesExpanded;      // Search nodes across all threads, pattern engine nodes included
+    long long prunes[CUTLIST_PRUNE_REASON_COUNT]; // Subtrees cut off, by CutlistPruneReason
+    int maxDepth;                 // Most pieces placed on any path searched, or stocks cut by the pattern engine
+    int improvementCount;         // Times the best packing improved. Past CUTLIST_STATS_MAX_IMPROVEMENTS, each one
+    CutlistImprovement improvements[CUTLIST_STATS_MAX_IMPROVEMENTS]; // overwrites the last entry, so the list always
+                                  // ends with the packing returned
+    double secondsToFirstSolution; // -1 if no packing was found
+    double secondsToOptimum;      // Until the packing was proven optimal, -1 if it was not
+    double totalSeconds;
+    long long transpositionHits;
+    long long transpositionMisses;
+    long long transpositionStores; // States written to the table, replacing others or not
+    size_t memoryBytes;           // Working memory: the solver and its arena, and the parallel search's own buffers
+} CutlistStats;
+
+struct SharedIncumbent;
+struct TranspositionTable;
+
+// Where the search is at one piece: which placements of the piece are left to try, and which one its subtree is
+// searching. findBestPacking keeps one per piece, so the search never recurses
+typedef struct {
+    uint64_t stateKey;         // Transposition key of the state before the piece was placed
+    uint64_t fittingStocks;    // Stocks of the block at blockStart with room for the piece, not tried yet
+    int blockStart;
+    int firstStock;            // First open stock the piece may go into
+    int nextType;              // Next kind of stock to open for the piece, -1 while open stocks are being tried
+    int previousLength;        // Length of the last kind opened, so kinds of the same length are only tried once
+    int placedStock;           // Stock holding the piece in the subtree being searched, -1 if none
+} SearchFrame;
+
+// Fields the search reads at every node come first, so they share the first few cache lines; the setup, budget and
+// reporting fields follow, and the stats, by far the largest member, go last
 typedef struct 
 {
-    int *optimalAssignments;
-    int *currentAssignments;
     int *remainingStockSpace;
-    int optimalStockCount;
-    int optimalWaste;
+    int *currentAssignments;
+    int *pieceSizes;           // Private copy of the pieces, sorted by descending size, each with kerfWidth added
+    SearchFrame *searchStack;  // One frame per piece
+    int *remainingPieceLength; // Total length of pieces [i, totalPieces), used for lower bounds
     int currentStockCount;
-    int stockLength;
     int totalPieces;
-    int *pieceSizes;
+    int stockLength;           // Length packed into a stock: its length less the trim, plus one kerf
+    int stopSearch;            // Set once the best packing is proven optimal or the budget runs out
+    long long nodeCount;       // Search nodes expanded so far
+    long long openedLength;    // Total length of the open stocks, so a packing's waste is known without summing them
+    int optimalStockCount;
+    int optimalWaste;
+    int optimalTask;           // Task that found the best packing, ties on waste go to the earlier task
+    int taskIndex;             // Position of the subtree being searched in serial search order, 0 for a serial solve
+    int rootLowerBound;        // No packing can use fewer stocks than this
+    int optimalPrefixLength;   // Leading pieces placed where the best packing has them, an improvement copies the rest
+    struct TranspositionTable *transpositions; // Bounds proven for states already searched, NULL to search without
+    struct SharedIncumbent *sharedIncumbent; // Best packing across all workers of a parallel solve, NULL otherwise
+    int pieceClassCount;       // Number of distinct piece sizes
+    int stockTypeCount;        // Kinds of stock in the catalogue, 0 for unlimited stocks of stockLength
+    int *classOfPiece;         // Class index of every sorted piece
+    int *classSizes;           // Piece size of every class, descending
+    int *classCounts;          // Number of pieces in every class
+    int *classFirstPiece;      // Index of the first sorted piece in every class
+    CutlistTraceLevel traceLevel;
+    int *optimalAssignments;
+    long long currentCost;     // Cost of the open stocks
+    long long optimalCost;     // Cost of the best packing, LLONG_MAX if none is known. Replaces waste as the objective
+    int *stockTypeLengths;     // Catalogue by descending length, then ascending cost; stockLength is the longest
+    int *stockTypeCosts;
+    int *stockTypeOnHand;      // Stocks of every kind not opened yet, INT_MAX for unlimited
+    int *stockTypeIndex;       // Caller's catalogue index of every kind
+    int *stockTypesByUnitCost; // Kinds by ascending cost per unit length, for the cost bound
+    int *currentStockTypes;    // Kind of every open stock
+    int *optimalStockTypes;    // Kind of every stock of the best packing
+    long long rootCostLowerBound; // No packing can cost less than this
+    long long *minCoverCost;   // Cheapest stock on hand totalling at least i * coverLengthUnit, NULL if too long to tabulate
+    int coverLengthUnit;       // Greatest common divisor of the lengths on hand
+    int coverEntryCount;
+    int kerfWidth;             // Added to every piece and to every stock length, so the last cut of a stock costs nothing
+    int *sortedToOriginal;     // Caller's index of every sorted piece
+    long long nodeLimit;       // Stop after this many nodes, 0 for no limit
+    double deadline;           // Stop at this wall-clock time in seconds, 0 for no limit
+    int budgetExhausted;       // Set if the search stopped on nodeLimit or deadline before proving optimality
+    double startTime;          // Wall-clock time the solve started, improvements are timed from it
+    const atomic_int *cancelRequested; // Stops the search once nonzero, NULL if it cannot be cancelled
+    void (*onImprovement)(const CutlistImprovement *improvement, void *userData); // NULL for no callback
+    void *userData;
+    int stockCost;             // Cost of one stock without a catalogue: its length before trim
+    CutlistStats stats;        // Counters of this search. Parallel workers count into their own, and record
+                               // improvements through sharedIncumbent
 } PackingState;
 
+// How solveCutlist finds its packing
+typedef enum {
+    CUTLIST_STRATEGY_EXACT = 0,             // Exact engine picked by estimated cost, seeded with the better greedy packing, the default
+    CUTLIST_STRATEGY_FIRST_FIT_DECREASING,  // Greedy O(n log n) packing only, for fast quotes
+    CUTLIST_STRATEGY_BEST_FIT_DECREASING,   // Greedy O(n log n) packing only, for fast quotes
+    CUTLIST_STRATEGY_BRANCH_AND_BOUND,      // Exact search placing one piece at a time, can use several threads
+    CUTLIST_STRATEGY_PATTERNS,              // Exact search cutting one stock pattern at a time, for few distinct lengths
+    CUTLIST_STRATEGY_DECOMPOSE              // Greedy packing improved by exact searches over windows of its least-filled
+                                            // stocks, for orders of many thousand pieces. Proves the packing optimal only
+                                            // when it reaches the lower bound. With a catalogue it is CUTLIST_STRATEGY_BRANCH_AND_BOUND
+} CutlistStrategy;
+
+// Budget, cancellation and tuning for the exact search. When it runs out, or the solve is cancelled, the best packing
+// found so far is returned, with CutlistResult.provenOptimal cleared, stopReason saying why and optimalityGap saying
+// how far from the lower bound it may be
+typedef struct {
+    double timeLimitSeconds;      // Wall-clock limit for the whole solve, 0 for no limit
+    long long nodeLimit;          // Search nodes across all threads, checked every CUTLIST_BUDGET_CHECK_INTERVAL, 0 for no limit
+    long long transpositionEntries; // Transposition table size per search thread, 0 for the default, negative for none
+    const atomic_int *cancelRequested; // Set it nonzero from any thread to stop the solve, checked with the budget. NULL for none
+    void (*onImprovement)(const CutlistImprovement *improvement, void *userData); // Called with every better packing
+                                  // found, the greedy one included. Parallel searches call it from their worker threads,
+                                  // one call at a time while holding up other improvements, so keep it short. NULL for none
+    void *userData;               // Handed to onImprovement
+} CutlistSolveOptions;
+
+// Nodes between checks of the search budget, a power of two
+#define CUTLIST_BUDGET_CHECK_INTERVAL 256
+
+// Stocks on hand without a limit
+#define CUTLIST_STOCK_UNLIMITED -1
+
+// One kind of stock in the yard
 typedef struct {
-    int *requiredPieces;
+    int length;
+    int count;                    // Stocks of this kind on hand, CUTLIST_STOCK_UNLIMITED for no limit
+    int cost;                     // Price of one stock, 0 or more. Use the length to minimize material
+} CutlistStockType;
+
+// Largest table of cheapest stock covers the catalogue search bounds its cost with, 512 KB. Longer orders, counted in
+// units of the greatest common divisor of the stock lengths, are bounded without it
+#ifndef CUTLIST_COVER_TABLE_MAX_ENTRIES
+#define CUTLIST_COVER_TABLE_MAX_ENTRIES (1 << 16)
+#endif
+
+typedef struct {
+    const int *requiredPieces;    // Never modified, so one input can be shared between threads
     int pieceCount;
     int stockLength;
+    CutlistTraceLevel traceLevel; // Defaults to CUTLIST_TRACE_OFF
+    int threadCount;              // Worker threads for the search, 0 or 1 searches on the calling thread
+    CutlistStrategy strategy;     // Defaults to CUTLIST_STRATEGY_EXACT
+    const CutlistSolveOptions *options; // NULL for an unlimited search
+    const CutlistStockType *stockTypes; // Stock catalogue replacing stockLength, NULL for unlimited stocks of stockLength.
+                                        // Packings then minimize total cost, searched on the calling thread piece by piece
+    int stockTypeCount;
+    int kerfWidth;                // Material the saw turns to dust per cut. The last piece of a stock needs no cut after it
+    int trimLength;               // Cut off every stock before use, both ends together
 } CutlistInput;
 
+// Why a solve stopped searching
+typedef enum {
+    CUTLIST_STOP_COMPLETED = 0,   // Searched as far as the strategy goes
+    CUTLIST_STOP_NODE_LIMIT,      // CutlistSolveOptions.nodeLimit ran out
+    CUTLIST_STOP_TIME_LIMIT,      // CutlistSolveOptions.timeLimitSeconds ran out
+    CUTLIST_STOP_CANCELLED,       // CutlistSolveOptions.cancelRequested was set
+    CUTLIST_STOP_SEARCH_SKIPPED   // The order is beyond what the strategy's search takes, its greedy packing is returned
+} CutlistStopReason;
+
+// Outcome of a solve. Anything but CUTLIST_STATUS_OK comes with stockUsed and waste set to -1
+typedef enum {
+    CUTLIST_STATUS_OK = 0,
+    CUTLIST_STATUS_PIECE_TOO_LONG,   // A piece is longer than the stock
+    CUTLIST_STATUS_NEGATIVE_PIECE,   // A piece has a negative length
+    CUTLIST_STATUS_INVALID_INPUT,    // Negative piece count, stock length of 0 or less, or no piece array
+    CUTLIST_STATUS_OUT_OF_MEMORY,    // Working memory could not be allocated
+    CUTLIST_STATUS_INSUFFICIENT_STOCK // The catalogue runs out before every piece is cut, or the budget did before a packing was found
+} CutlistStatus;
+
 typedef struct {
-    int *assignments;
+    int *assignments;             // Stock index of every piece, in the caller's piece order
     int stockUsed;
-    int waste;
+    int waste;                    // Offcut left on the stocks used, not counting trim or kerf
+    int stockLowerBound;          // No packing of these pieces can use fewer stocks
+    int provenOptimal;            // 1 if no packing with less waste, or less cost with a catalogue, exists
+    double optimalityGap;         // Fraction of the cost that a better packing might still save, 0 when proven optimal
+    CutlistStatus status;
+    long long cost;               // Total cost of the stocks used, stockUsed * stockLength without a catalogue
+    int *stockTypeOfStock;        // Catalogue index of every stock used, supplied by the caller with room for pieceCount
+                                  // entries. Required for inputs with a catalogue, never touched otherwise
+    CutlistStats stats;           // Set by every solve, failed ones included
+    CutlistStopReason stopReason; // A search stopped early returns the best packing found so far, not proven optimal
 } CutlistResult;
 
+// A packing of the input known before the solve, such as the repaired packing of a changed order. It becomes the
+// incumbent if it beats the greedy packing, and the solve skips the search, and the sort before it, when it meets
+// stockLowerBound. Only for inputs without a catalogue
+typedef struct {
+    const int *assignments;       // Stock index of every piece, in the caller's piece order, all below stockCount
+    int stockCount;
+    int stockLowerBound;          // No packing of the input uses fewer stocks, proven by the caller. 0 if unknown
+} CutlistSeedPacking;
+
+// Buffers carved out of a solver arena start on their own cache line
+#define CUTLIST_ARENA_ALIGNMENT 64
+
+// Reusable solver context. Owns one arena holding every buffer the search needs; it only grows when an input has
+// more pieces than any before it, so a warmed-up solver does no heap allocation per solve or per search node
+typedef struct CutlistSolver {
+    PackingState state;
+    unsigned char *arenaBlock; // Block returned by malloc
+    unsigned char *arena;      // arenaBlock rounded up to CUTLIST_ARENA_ALIGNMENT
+    size_t arenaCapacity;
+    size_t arenaUsed;
+    struct CutlistSolver *windowSolver; // Solves the windows of a decomposed order, NULL until one is decomposed
+} CutlistSolver;
+
 void optimizeCutlist(CutlistInput input, CutlistResult *result);
+CutlistSolver *createCutlistSolver(int initialPieceCapacity);
+int solveCutlist(CutlistSolver *solver, CutlistInput input, CutlistResult *result);
+int solveCutlistFromSeed(CutlistSolver *solver, CutlistInput input, const CutlistSeedPacking *seed, CutlistResult *result);
+void resetCutlistSolver(CutlistSolver *solver);
+void destroyCutlistSolver(CutlistSolver *solver);
 void findBestPacking(PackingState *state, int currentPieceIndex);
+int getFirstCandidateStock(PackingState *state, int currentPieceIndex);
+int isEquivalentStockTried(PackingState *state, int firstStock, int stockIndex);
 char* getStockAssignmentsAsString(PackingState *state);
+int computeStockLowerBound(const int *sortedPieces, int pieceCount, int stockLength);
+int computeL2Bound(const int *runSizes, const int *runCounts, int runCount, int firstRunCount,
+                   const int *openStockSpace, int openStockCount, int smallestPiece, int stockLength);
+int isSearchBudgetExhausted(PackingState *state);
+void recordCutlistImprovement(PackingState *state, long long nodes, int stockUsed, int waste, long long cost);
+void resetCutlistStats(CutlistStats *stats);
+double getCutlistWallSeconds(void);
 
 #endif // CUTLIST_OPTIMIZER_H
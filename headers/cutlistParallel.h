@@ -0,0 +1,62 @@
+#ifndef CUTLIST_PARALLEL_H
+#define CUTLIST_PARALLEL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "cutlistOptimizer.h"
+#include "cutlistTransposition.h"
+
+// Tasks generated per worker thread. More tasks balance better, fewer tasks replay shorter prefixes
+#define CUTLIST_TASKS_PER_THREAD 32
+
+// Best packing found by any worker of a parallel solve, and the search budget they share. key packs
+// (waste << 32 | task index) so workers prune against it with a single atomic load; ties on waste go to the earliest
+// task, which is what the serial search keeps
+typedef struct SharedIncumbent {
+    _Atomic uint64_t key;
+    pthread_mutex_t lock;      // Guards assignments, stockCount and stats while a worker publishes
+    int *assignments;
+    int stockCount;
+    _Atomic long long nodeCount;   // Nodes charged by all workers, in CUTLIST_BUDGET_CHECK_INTERVAL steps
+    atomic_int budgetExhausted;    // Set by the first worker to run out of budget, stops every worker
+    PackingState *rootState;       // The caller's state, improvements are recorded in its stats while publishing
+} SharedIncumbent;
+
+// Range of task indices owned by one worker. The owner takes from the head, thieves take from the tail
+typedef struct {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} TaskQueue;
+
+typedef struct ParallelSearch ParallelSearch;
+
+typedef struct {
+    ParallelSearch *search;
+    PackingState state;        // Private copy of the search state, sharing the read-only piece data
+    TaskQueue queue;
+    int workerIndex;
+    TranspositionTable transpositions; // Private table, so probes and stores need no locking
+} SearchWorker;
+
+struct ParallelSearch {
+    PackingState *rootState;
+    SharedIncumbent incumbent;
+    SearchWorker *workers;
+    int workerCount;
+    int *taskPrefixes;         // taskDepth stock indices per task, tasks in serial search order
+    int taskCount;
+    int taskDepth;
+};
+
+int beatsSharedIncumbent(SharedIncumbent *incumbent, long long waste, int taskIndex);
+long long getSharedIncumbentWaste(SharedIncumbent *incumbent);
+void publishIncumbent(SharedIncumbent *incumbent, long long waste, int taskIndex, const int *assignments,
+                      int stockCount, int pieceCount);
+int chargeSharedSearchBudget(SharedIncumbent *incumbent, long long nodes, long long nodeLimit, double deadline,
+                             const atomic_int *cancelRequested);
+int findBestPackingParallel(PackingState *state, int threadCount);
+
+#endif // CUTLIST_PARALLEL_H
@@ -0,0 +1,48 @@
+#ifndef CUTLIST_PATTERNS_H
+#define CUTLIST_PATTERNS_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+
+// The pattern engine works on piece classes, and only takes inputs it can hold in a small dense simplex and a
+// knapsack table over the stock length
+#define CUTLIST_PATTERN_MAX_CLASSES 64
+#define CUTLIST_PATTERN_MAX_STOCK_LENGTH 100000
+
+// Below this many pieces the branch-and-bound search finishes in microseconds, so the automatic choice keeps it
+#define CUTLIST_PATTERN_MIN_PIECES 32
+
+// Nodes the search from the rounded-down LP solution may use before the search from the root takes over
+#define CUTLIST_PATTERN_DIVE_NODES 100000
+
+// Cap on simplex pivots for the root bound. The bound is valid whenever the simplex stops, only weaker
+#define CUTLIST_PATTERN_MAX_SIMPLEX_ITERATIONS 2000
+
+// Bytes of scratch findBestPackingByPatterns needs for any input of up to pieceCount pieces on stockLength stocks,
+// 0 if no such input is eligible
+size_t getPatternScratchSize(int pieceCount, int stockLength);
+
+// Returns 1 if the pattern engine can take the classes in state
+int isPatternEngineEligible(const PackingState *state);
+
+// Returns 1 if the pattern engine's estimated cost is below the branch-and-bound search's for state
+int isPatternEngineCheaper(const PackingState *state);
+
+// Exact engine over cutting patterns. Strengthens state->rootLowerBound with the Gilmore-Gomory LP bound from column
+// generation, then searches one stock at a time over maximal patterns for a packing with fewer stocks than the
+// incumbent. state must be prepared as for findBestPacking(state, 0), with an incumbent packing. Leaves the best
+// packing in state, with stocks numbered in the order they were cut
+void findBestPackingByPatterns(PackingState *state, void *scratch);
+
+// Bytes of scratch computePatternLpSolution needs for these classes
+size_t getPatternLpScratchSize(const int *classSizes, const int *classCounts, int classCount, int stockLength);
+
+// Solves the LP findBestPackingByPatterns bounds its search with, for classCount classes by descending size that are
+// eligible for the pattern engine, and returns its bound on stocks. Leaves the LP's basis in patterns, classCount rows
+// of one count per class, and the stocks the LP cuts to each row in stockCounts, 0 for a row that is not a pattern.
+// Costs O(classCount^2 * chunks * stockLength), whatever the counts, as chunks grow with their logarithm
+int computePatternLpSolution(const int *classSizes, const int *classCounts, int classCount, int stockLength,
+                             void *scratch, int *patterns, double *stockCounts);
+
+#endif // CUTLIST_PATTERNS_H
@@ -0,0 +1,67 @@
+#ifndef CUTLIST_READER_H
+#define CUTLIST_READER_H
+
+#include <stddef.h>
+
+#include "cutlistOptimizer.h"
+#include "cutlistFormat.h"
+
+// Orders readCutlistOrders returns at most per call when asked for 0
+#define CUTLIST_ORDER_CHUNK_DEFAULT 1024
+
+// Layout of an order file. Both run-length encode their pieces, so 5000 pieces of one length take one row or record
+typedef enum {
+    CUTLIST_ORDER_CSV = 0,        // "order,stock_length,length,quantity" rows, quantity optional and 1 if left out. An
+                                  // order is a run of rows with the same order number. A first row that does not start
+                                  // with a number is a header and skipped, as are blank lines
+    CUTLIST_ORDER_BINARY          // File header, then one record per order, see writeCutlistOrder
+} CutlistOrderFormat;
+
+typedef enum {
+    CUTLIST_READ_OK = 0,          // Orders left to read, or all read
+    CUTLIST_READ_MALFORMED,       // A row or record cannot be read, getCutlistOrderReaderStatus says where
+    CUTLIST_READ_OUT_OF_MEMORY,
+    CUTLIST_READ_OPEN_FAILED      // The file is missing or cannot be mapped
+} CutlistReadStatus;
+
+// One order as read. input is a copy of the reader's defaults with the order's pieces, stock length and, from a
+// binary file, kerf and trim. requiredPieces points into the mapped file when the order is stored one length per
+// piece, and into the reader otherwise; either way it stays valid until the next readCutlistOrders call
+typedef struct {
+    long long orderId;
+    CutlistInput input;
+} CutlistOrder;
+
+// Reads orders from a file of one format, a chunk at a time. The file is memory-mapped and parsed in place, so
+// reading costs one pass over its bytes and memory for the pieces of one chunk, whatever the file's size
+typedef struct CutlistOrderReader CutlistOrderReader;
+
+// Opens a reader over the file at path. defaults gives the fields orders do not carry, like strategy, options and
+// thread count, and for CSV the kerf and trim; NULL for zeroes. Returns NULL only if the reader cannot be allocated; a
+// file that cannot be opened leaves it in CUTLIST_READ_OPEN_FAILED
+CutlistOrderReader *openCutlistOrderReader(const char *path, CutlistOrderFormat format, const CutlistInput *defaults);
+
+// Opens a reader over size bytes at data, which must outlive it and, for binary, be 8-byte aligned like malloc's
+CutlistOrderReader *openCutlistOrderReaderFromMemory(const void *data, size_t size, CutlistOrderFormat format,
+                                                     const CutlistInput *defaults);
+
+void closeCutlistOrderReader(CutlistOrderReader *reader);
+
+// Reads up to capacity orders, CUTLIST_ORDER_CHUNK_DEFAULT for 0, into orders. Returns how many were read; fewer
+// than asked means the file is done or a read failed, which getCutlistOrderReaderStatus tells apart. The orders of
+// the previous call are no longer valid
+size_t readCutlistOrders(CutlistOrderReader *reader, CutlistOrder *orders, size_t capacity);
+
+// Returns the reader's status. On CUTLIST_READ_MALFORMED, position is the CSV line, from 1, or the byte offset of
+// the binary record that failed; position may be NULL
+CutlistReadStatus getCutlistOrderReaderStatus(const CutlistOrderReader *reader, long long *position);
+
+// Writes what comes before the first order: the CSV header row, or the binary file header
+CutlistSinkError writeCutlistOrderHeader(CutlistSink *sink, CutlistOrderFormat format);
+
+// Writes one order, its stock length and pieces, and for binary its kerf and trim. Equal lengths next to each other
+// become one row or run, and a CSV order without pieces one row of quantity 0. A binary record stores the pieces one
+// length each when that is no bigger than as runs, so they can be read without a copy. Catalogues are not written
+CutlistSinkError writeCutlistOrder(CutlistSink *sink, CutlistOrderFormat format, long long orderId, const CutlistInput *input);
+
+#endif // CUTLIST_READER_H
@@ -0,0 +1,58 @@
+#ifndef CUTLIST_TRANSPOSITION_H
+#define CUTLIST_TRANSPOSITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Entries per bucket. A state can only be stored in its own bucket, and a full bucket gives up its least valuable entry
+#define CUTLIST_TRANSPOSITION_BUCKET_SIZE 4
+
+// Table size when CutlistSolveOptions does not set one: 64k entries, 1 MB
+#define CUTLIST_DEFAULT_TRANSPOSITION_ENTRIES (1 << 16)
+
+// One fully searched state. Key 0 marks an empty entry
+typedef struct {
+    uint64_t key;
+    int stockBound;   // Every completion of the state uses at least this many stocks, with a catalogue costs at least this much more
+    int pieceIndex;   // Pieces already placed in the state; fewer means a bigger subtree, worth keeping longer
+} TranspositionEntry;
+
+// Bounded map from search states to what searching them proved. A state is the next piece to place and the multiset of
+// open stocks' remaining space, hashed Zobrist-style by adding one random key per stock so the order stocks were
+// opened in does not matter. Keys are mixed from the space value when needed, so they cost nothing per unit of length
+typedef struct TranspositionTable {
+    TranspositionEntry *entries;
+    size_t bucketCount;           // A power of two
+    long long hits;               // Probes that found the state
+    long long misses;             // Probes that did not
+    long long stores;             // States written to an empty entry or over their own older entry
+    long long replacements;       // States written over another state's entry
+} TranspositionTable;
+
+// Bytes of entries for a table of about entryCount entries
+size_t getTranspositionEntryBytes(long long entryCount);
+
+// Empties a table over entryMemory (getTranspositionEntryBytes(entryCount) bytes) and zeroes its counters. Every table
+// hashes with the same keys, so tables agree on every hash
+void initTranspositionTable(TranspositionTable *table, void *entryMemory, long long entryCount);
+
+// Hash of the search state where pieceIndex is next to place. Stocks before firstStock are ruled out for the piece, and
+// stocks with less than deadSpace left can take no piece at all, so how much less does not matter
+uint64_t hashSearchState(const int *remainingSpace, int stockCount, int firstStock, int deadSpace, int pieceIndex);
+
+// Hash of a search state over a stock catalogue: the state as for hashSearchState, and how many stocks of each of the
+// typeCount kinds are still on hand
+uint64_t hashCatalogueSearchState(const int *remainingSpace, int stockCount, int firstStock, int deadSpace, int pieceIndex,
+                                  const int *stockTypeOnHand, int typeCount);
+
+// Hash of the pieces still to cut, classCount counts of the classes sized classSizes. Adds a piece's key per piece, the
+// same multiset hash as for stocks
+uint64_t hashRemainingDemand(const int *classSizes, const int *classCounts, int classCount);
+
+// Returns 1 and sets stockBound if the state has been searched before
+int probeTransposition(TranspositionTable *table, uint64_t key, int *stockBound);
+
+// Records that every completion of a fully searched state uses at least stockBound stocks
+void storeTransposition(TranspositionTable *table, uint64_t key, int pieceIndex, int stockBound);
+
+#endif // CUTLIST_TRANSPOSITION_H
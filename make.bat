@@ -1,3 +1,4 @@
-gcc -I headers -I src -I Unity/src -o test_cutlist tests/test_cutlistOptimizer.c src/cutlistOptimizer.c Unity/src/unity.c
-
-
+gcc -pthread -I headers -I src -I Unity/src -o test_cutlist tests/test_cutlistOptimizer.c src/cutlistOptimizer.c src/cutlistParallel.c src/cutlistHeuristics.c src/cutlistKernels.c src/cutlistTransposition.c src/cutlistPatterns.c src/cutlistBatch.c src/cutlistFormat.c src/cutlistIncremental.c src/cutlistCache.c src/cutlistDecompose.c src/cutlistReader.c src/cutlistDemand.c src/cutlistLocalSearch.c Unity/src/unity.c
+gcc -O2 -pthread -I headers -I src -o bench_cutlist_parallel benchmarks/bench_cutlistParallel.c src/cutlistOptimizer.c src/cutlistParallel.c src/cutlistHeuristics.c src/cutlistKernels.c src/cutlistTransposition.c src/cutlistPatterns.c src/cutlistBatch.c src/cutlistFormat.c src/cutlistIncremental.c src/cutlistCache.c src/cutlistDecompose.c src/cutlistReader.c src/cutlistDemand.c src/cutlistLocalSearch.c
+gcc -O2 -pthread -I headers -I src -o bench_cutlist_batch benchmarks/bench_cutlistBatch.c src/cutlistOptimizer.c src/cutlistParallel.c src/cutlistHeuristics.c src/cutlistKernels.c src/cutlistTransposition.c src/cutlistPatterns.c src/cutlistBatch.c src/cutlistFormat.c src/cutlistIncremental.c src/cutlistCache.c src/cutlistDecompose.c src/cutlistReader.c src/cutlistDemand.c src/cutlistLocalSearch.c
+gcc -O2 -pthread -I headers -I src -o bench_cutlist_suite benchmarks/bench_cutlistSuite.c src/cutlistOptimizer.c src/cutlistParallel.c src/cutlistHeuristics.c src/cutlistKernels.c src/cutlistTransposition.c src/cutlistPatterns.c src/cutlistBatch.c src/cutlistFormat.c src/cutlistIncremental.c src/cutlistCache.c src/cutlistDecompose.c src/cutlistReader.c src/cutlistDemand.c src/cutlistLocalSearch.c -lpsapi
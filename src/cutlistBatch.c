@@ -0,0 +1,348 @@
+#include "cutlistBatch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+// No order in the batch has an identical one before it
+#define CUTLIST_BATCH_UNIQUE ((size_t)-1)
+
+typedef struct {
+    const CutlistInput *inputs;
+    CutlistResult *results;
+    const size_t *solveOrder;  // Orders to solve, duplicates of earlier orders left out
+    size_t solveCount;
+    atomic_size_t nextOrder;   // Next position in solveOrder for a thread to take
+} BatchRun;
+
+// FNV-1a over everything that decides a result, so identical orders always land in the same slot
+static uint64_t hashCutlistInput(const CutlistInput *input)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const unsigned char *bytes = (const unsigned char *)input->requiredPieces;
+    for (size_t byte_index = 0; byte_index < (size_t)input->pieceCount * sizeof(int); byte_index++)
+    {
+        hash = (hash ^ bytes[byte_index]) * 0x100000001B3ull;
+    }
+
+    int fields[] = {input->pieceCount, input->stockLength, (int)input->strategy, input->stockTypeCount, input->kerfWidth, input->trimLength};
+    for (int field_index = 0; field_index < 6; field_index++)
+    {
+        hash = (hash ^ (uint64_t)(unsigned int)fields[field_index]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static int areOptionsIdentical(const CutlistSolveOptions *first, const CutlistSolveOptions *second)
+{
+    if (!first || !second)
+    {
+        return first == second;
+    }
+
+    // Orders reporting to different callbacks or cancelled separately are solved separately
+    return (first->timeLimitSeconds == second->timeLimitSeconds) && (first->nodeLimit == second->nodeLimit) &&
+           (first->transpositionEntries == second->transpositionEntries) && (first->cancelRequested == second->cancelRequested) &&
+           (first->onImprovement == second->onImprovement) && (first->userData == second->userData);
+}
+
+static int areCataloguesIdentical(const CutlistInput *first, const CutlistInput *second)
+{
+    if (first->stockTypeCount != second->stockTypeCount)
+    {
+        return 0;
+    }
+
+    for (int type_index = 0; type_index < first->stockTypeCount; type_index++)
+    {
+        const CutlistStockType *first_type = &first->stockTypes[type_index];
+        const CutlistStockType *second_type = &second->stockTypes[type_index];
+        if ((first_type->length != second_type->length) || (first_type->count != second_type->count) ||
+            (first_type->cost != second_type->cost))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Returns 1 if the two orders would get the same result. Thread counts never change a result, so they are not compared
+static int areInputsIdentical(const CutlistInput *first, const CutlistInput *second)
+{
+    return (first->pieceCount == second->pieceCount) && (first->stockLength == second->stockLength) &&
+           (first->kerfWidth == second->kerfWidth) && (first->trimLength == second->trimLength) &&
+           (first->strategy == second->strategy) && areOptionsIdentical(first->options, second->options) &&
+           areCataloguesIdentical(first, second) &&
+           ((first->pieceCount <= 0) ||
+            (memcmp(first->requiredPieces, second->requiredPieces, (size_t)first->pieceCount * sizeof(int)) == 0));
+}
+
+// Points every order at the first identical order before it, or CUTLIST_BATCH_UNIQUE. Open addressing over a table
+// of twice the batch size keeps probes short. Traced orders are never matched, their output is the point of them.
+// Returns -1 if the table cannot be allocated
+static int findIdenticalInputs(const CutlistInput *inputs, size_t count, size_t *firstIdentical)
+{
+    size_t slot_count = 1;
+    while (slot_count < 2 * count)
+    {
+        slot_count *= 2;
+    }
+
+    size_t *slots = (size_t *)malloc(slot_count * sizeof(size_t));
+    if (!slots)
+    {
+        return -1;
+    }
+    for (size_t slot = 0; slot < slot_count; slot++)
+    {
+        slots[slot] = CUTLIST_BATCH_UNIQUE;
+    }
+
+    for (size_t order = 0; order < count; order++)
+    {
+        firstIdentical[order] = CUTLIST_BATCH_UNIQUE;
+        const CutlistInput *input = &inputs[order];
+        if ((input->traceLevel != CUTLIST_TRACE_OFF) || (input->pieceCount < 0) || ((input->pieceCount > 0) && !input->requiredPieces) ||
+            ((input->stockTypeCount > 0) && !input->stockTypes))
+        {
+            continue;
+        }
+
+        size_t slot = (size_t)hashCutlistInput(input) & (slot_count - 1);
+        while ((slots[slot] != CUTLIST_BATCH_UNIQUE) && !areInputsIdentical(&inputs[slots[slot]], input))
+        {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+
+        if (slots[slot] == CUTLIST_BATCH_UNIQUE)
+        {
+            slots[slot] = order;
+        }
+        else
+        {
+            firstIdentical[order] = slots[slot];
+        }
+    }
+
+    free(slots);
+    return 0;
+}
+
+static void *runBatchWorker(void *argument)
+{
+    BatchRun *run = (BatchRun *)argument;
+    CutlistSolver *solver = createCutlistSolver(0);
+
+    size_t position;
+    while ((position = atomic_fetch_add_explicit(&run->nextOrder, 1, memory_order_relaxed)) < run->solveCount)
+    {
+        size_t order = run->solveOrder[position];
+        if (solver)
+        {
+            solveCutlist(solver, run->inputs[order], &run->results[order]);
+        }
+        else
+        {
+            run->results[order].status = CUTLIST_STATUS_OUT_OF_MEMORY;
+            run->results[order].stockUsed = -1;
+            run->results[order].waste = -1;
+        }
+    }
+
+    destroyCutlistSolver(solver);
+    return NULL;
+}
+
+size_t optimizeCutlistBatch(const CutlistInput *inputs, CutlistResult *results, size_t count, const CutlistBatchOptions *options)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int thread_count = ((options != NULL) && (options->threadCount > 1)) ? options->threadCount : 1;
+    if ((size_t)thread_count > count)
+    {
+        thread_count = (int)count;
+    }
+
+    // Work out which orders need solving. Without reuse, or if the lookup table cannot be allocated, that is all of them
+    size_t *first_identical = (size_t *)malloc(count * sizeof(size_t));
+    size_t *solve_order = (size_t *)malloc(count * sizeof(size_t));
+    pthread_t *threads = (pthread_t *)malloc((size_t)thread_count * sizeof(pthread_t));
+    int *started = (int *)malloc((size_t)thread_count * sizeof(int));
+    if (!first_identical || !solve_order || !threads || !started)
+    {
+        free(first_identical);
+        free(solve_order);
+        free(threads);
+        free(started);
+        for (size_t order = 0; order < count; order++)
+        {
+            results[order].status = CUTLIST_STATUS_OUT_OF_MEMORY;
+            results[order].stockUsed = -1;
+            results[order].waste = -1;
+        }
+        return count;
+    }
+
+    if (!options || !options->reuseIdenticalInputs || (findIdenticalInputs(inputs, count, first_identical) != 0))
+    {
+        for (size_t order = 0; order < count; order++)
+        {
+            first_identical[order] = CUTLIST_BATCH_UNIQUE;
+        }
+    }
+
+    BatchRun run;
+    run.inputs = inputs;
+    run.results = results;
+    run.solveOrder = solve_order;
+    run.solveCount = 0;
+    for (size_t order = 0; order < count; order++)
+    {
+        if (first_identical[order] == CUTLIST_BATCH_UNIQUE)
+        {
+            solve_order[run.solveCount++] = order;
+        }
+    }
+    atomic_init(&run.nextOrder, 0);
+
+    // The calling thread works too. Threads that fail to start leave their share to the others
+    for (int thread_index = 1; thread_index < thread_count; thread_index++)
+    {
+        started[thread_index] = (pthread_create(&threads[thread_index], NULL, runBatchWorker, &run) == 0);
+    }
+    runBatchWorker(&run);
+    for (int thread_index = 1; thread_index < thread_count; thread_index++)
+    {
+        if (started[thread_index])
+        {
+            pthread_join(threads[thread_index], NULL);
+        }
+    }
+
+    // Hand every duplicate the result of the order it matched, keeping its own assignments and stock kind buffers
+    size_t failed_count = 0;
+    for (size_t order = 0; order < count; order++)
+    {
+        size_t source = first_identical[order];
+        if (source != CUTLIST_BATCH_UNIQUE)
+        {
+            int *assignments = results[order].assignments;
+            int *stock_types = results[order].stockTypeOfStock;
+            results[order] = results[source];
+            results[order].assignments = assignments;
+            results[order].stockTypeOfStock = stock_types;
+            if ((inputs[order].stockTypeCount > 0) && !stock_types)
+            {
+                results[order].status = CUTLIST_STATUS_INVALID_INPUT;
+                results[order].stockUsed = -1;
+                results[order].waste = -1;
+            }
+            else if ((results[source].status == CUTLIST_STATUS_OK) && (inputs[order].pieceCount > 0))
+            {
+                memcpy(assignments, results[source].assignments, (size_t)inputs[order].pieceCount * sizeof(int));
+                if (inputs[order].stockTypeCount > 0)
+                {
+                    memcpy(stock_types, results[source].stockTypeOfStock, (size_t)results[source].stockUsed * sizeof(int));
+                }
+            }
+        }
+
+        if (results[order].status != CUTLIST_STATUS_OK)
+        {
+            failed_count++;
+        }
+    }
+
+    free(first_identical);
+    free(solve_order);
+    free(threads);
+    free(started);
+    return failed_count;
+}
+
+size_t optimizeCutlistOrderStream(CutlistOrderReader *reader, size_t chunkOrders, const CutlistBatchOptions *options,
+                                  CutlistOrderResultCallback onResult, void *userData)
+{
+    size_t chunk_orders = (chunkOrders > 0) ? chunkOrders : CUTLIST_ORDER_CHUNK_DEFAULT;
+    CutlistOrder *orders = (CutlistOrder *)malloc(chunk_orders * sizeof(CutlistOrder));
+    CutlistInput *inputs = (CutlistInput *)malloc(chunk_orders * sizeof(CutlistInput));
+    CutlistResult *results = (CutlistResult *)malloc(chunk_orders * sizeof(CutlistResult));
+    if (!orders || !inputs || !results)
+    {
+        free(orders);
+        free(inputs);
+        free(results);
+        return SIZE_MAX;
+    }
+
+    // Assignments of a whole chunk, and the kind of every stock for orders with a catalogue, grown to the largest chunk
+    int *assignments = NULL;
+    int *stock_types = NULL;
+    size_t assignment_capacity = 0;
+    size_t failed_count = 0;
+    for (;;)
+    {
+        size_t count = readCutlistOrders(reader, orders, chunk_orders);
+        if (count == 0)
+        {
+            break;
+        }
+
+        size_t piece_total = 0;
+        for (size_t order = 0; order < count; order++)
+        {
+            piece_total += (size_t)orders[order].input.pieceCount;
+        }
+        if (piece_total > assignment_capacity)
+        {
+            free(assignments);
+            free(stock_types);
+            assignments = (int *)malloc(piece_total * sizeof(int));
+            stock_types = (int *)malloc(piece_total * sizeof(int));
+            assignment_capacity = (assignments && stock_types) ? piece_total : 0;
+        }
+
+        size_t piece_offset = 0;
+        for (size_t order = 0; order < count; order++)
+        {
+            inputs[order] = orders[order].input;
+            results[order].assignments = (assignment_capacity > 0) ? &assignments[piece_offset] : NULL;
+            results[order].stockTypeOfStock = (assignment_capacity > 0) ? &stock_types[piece_offset] : NULL;
+            piece_offset += (size_t)orders[order].input.pieceCount;
+        }
+        if ((assignment_capacity == 0) && (piece_total > 0))
+        {
+            memset(results, 0, count * sizeof(CutlistResult));
+            for (size_t order = 0; order < count; order++)
+            {
+                results[order].status = CUTLIST_STATUS_OUT_OF_MEMORY;
+                results[order].stockUsed = -1;
+                results[order].waste = -1;
+            }
+            failed_count += count;
+        }
+        else
+        {
+            failed_count += optimizeCutlistBatch(inputs, results, count, options);
+        }
+
+        for (size_t order = 0; onResult && (order < count); order++)
+        {
+            onResult(&orders[order], &results[order], userData);
+        }
+        if (count < chunk_orders)
+        {
+            break;
+        }
+    }
+
+    free(assignments);
+    free(stock_types);
+    free(orders);
+    free(inputs);
+    free(results);
+    return failed_count;
+}
@@ -0,0 +1,637 @@
+#include "cutlistCache.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Start of every store file. The byte order marker rejects a store written on a machine of the other endianness
+#define CUTLIST_CACHE_MAGIC 0x314C4C43u // "CLL1"
+#define CUTLIST_CACHE_BYTE_ORDER 0x01020304u
+
+#define CUTLIST_CACHE_INITIAL_BUCKETS 64
+
+typedef struct {
+    uint32_t magic;
+    uint32_t byteOrder;
+} CacheFileHeader;
+
+// One stored result, laid out the same in memory and in the store file. recordBytes is a multiple of 8, so records
+// follow each other in the file without losing alignment
+typedef struct {
+    uint64_t hash;
+    int32_t recordBytes;
+    int32_t pieceCount;
+    int32_t stockLength;
+    int32_t kerfWidth;
+    int32_t trimLength;
+    int32_t strategy;
+    int64_t nodeLimit;
+    int64_t transpositionEntries;
+    int32_t stockUsed;
+    int32_t waste;
+    int32_t stockLowerBound;
+    int32_t provenOptimal;
+    int64_t cost;
+    double optimalityGap;
+    int32_t data[];               // pieceCount lengths in ascending order, then the stock of each of them
+} CacheRecord;
+
+typedef struct CacheEntry {
+    const CacheRecord *record;
+    int ownsRecord;               // Allocated by a store, otherwise inside the mapped store file
+    struct CacheEntry *nextInBucket;
+    struct CacheEntry *newer;
+    struct CacheEntry *older;
+} CacheEntry;
+
+struct CutlistCache {
+    pthread_mutex_t lock;         // Guards everything below
+    CacheEntry **buckets;
+    size_t bucketCount;           // A power of two
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    size_t entryCount;
+    size_t bytes;
+    size_t capacityBytes;
+    long long hits;
+    long long misses;
+    long long stores;
+    long long evictions;
+    long long loadedEntries;
+    char *path;                   // NULL for a cache in memory only
+    FILE *appendFile;             // New records go here as they are stored, NULL if the store cannot be appended to
+    size_t fileBytes;             // Bytes the store holds, valid records only
+    int fileDamaged;              // The store has bytes that are not valid records, so it is rewritten on close
+    const unsigned char *mapping;
+    size_t mappingBytes;
+#ifdef _WIN32
+    HANDLE mappedFile;
+    HANDLE mappingHandle;
+#endif
+};
+
+// Canonical form of an input: its piece indices in ascending length order, ties by index, and the hash of the key
+typedef struct {
+    int *sortedIndex;
+    int *sortedLengths;
+    long long *sortKeys;
+    uint64_t hash;
+} CanonicalOrder;
+
+static size_t getRecordBytes(int pieceCount)
+{
+    return (sizeof(CacheRecord) + 2 * (size_t)pieceCount * sizeof(int32_t) + 7) & ~(size_t)7;
+}
+
+static int compareSortKeys(const void *first, const void *second)
+{
+    long long first_key = *(const long long *)first;
+    long long second_key = *(const long long *)second;
+    return (first_key > second_key) - (first_key < second_key);
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t byte_index = 0; byte_index < length; byte_index++)
+    {
+        hash = (hash ^ bytes[byte_index]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Scalars of the key as a record stores them, so inputs and records hash and compare the same way. The five int32
+// fields from pieceCount to strategy, and the two int64 ones after them, are the key
+static void setRecordKey(CacheRecord *record, const CutlistInput *input)
+{
+    memset(record, 0, sizeof(*record));
+    record->pieceCount = input->pieceCount;
+    record->stockLength = input->stockLength;
+    record->kerfWidth = input->kerfWidth;
+    record->trimLength = input->trimLength;
+    record->strategy = (int32_t)input->strategy;
+    record->nodeLimit = (input->options != NULL) ? input->options->nodeLimit : 0;
+    record->transpositionEntries = (input->options != NULL) ? input->options->transpositionEntries : 0;
+}
+
+static uint64_t hashRecordKey(const CacheRecord *key, const int32_t *sortedLengths)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hashBytes(hash, &key->pieceCount, 5 * sizeof(int32_t));
+    hash = hashBytes(hash, &key->nodeLimit, 2 * sizeof(int64_t));
+    return hashBytes(hash, sortedLengths, (size_t)key->pieceCount * sizeof(int32_t));
+}
+
+static int isSameKey(const CacheRecord *record, const CacheRecord *key, uint64_t hash, const int32_t *sortedLengths)
+{
+    return (record->hash == hash) && (memcmp(&record->pieceCount, &key->pieceCount, 5 * sizeof(int32_t)) == 0) &&
+           (record->nodeLimit == key->nodeLimit) && (record->transpositionEntries == key->transpositionEntries) &&
+           (memcmp(record->data, sortedLengths, (size_t)key->pieceCount * sizeof(int32_t)) == 0);
+}
+
+// Sorts the input's pieces into their canonical order, O(n log n). Returns -1 if out of memory
+static int buildCanonicalOrder(const CutlistInput *input, CacheRecord *key, CanonicalOrder *order)
+{
+    size_t piece_count = (size_t)input->pieceCount;
+    order->sortKeys = (long long *)malloc(piece_count * (sizeof(long long) + 2 * sizeof(int)));
+    if (!order->sortKeys)
+    {
+        return -1;
+    }
+    order->sortedIndex = (int *)&order->sortKeys[piece_count];
+    order->sortedLengths = &order->sortedIndex[piece_count];
+
+    // Lengths are offset so negative ones, which the solve then rejects, still sort below the rest
+    for (size_t piece_index = 0; piece_index < piece_count; piece_index++)
+    {
+        order->sortKeys[piece_index] = (((long long)input->requiredPieces[piece_index] - INT32_MIN) << 31) | (long long)piece_index;
+    }
+    qsort(order->sortKeys, piece_count, sizeof(long long), compareSortKeys);
+    for (size_t slot = 0; slot < piece_count; slot++)
+    {
+        order->sortedIndex[slot] = (int)(order->sortKeys[slot] & 0x7FFFFFFF);
+        order->sortedLengths[slot] = input->requiredPieces[order->sortedIndex[slot]];
+    }
+
+    setRecordKey(key, input);
+    order->hash = hashRecordKey(key, order->sortedLengths);
+    return 0;
+}
+
+static CacheEntry *findEntry(CutlistCache *cache, const CacheRecord *key, uint64_t hash, const int32_t *sortedLengths)
+{
+    for (CacheEntry *entry = cache->buckets[hash & (cache->bucketCount - 1)]; entry; entry = entry->nextInBucket)
+    {
+        if (isSameKey(entry->record, key, hash, sortedLengths))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void unlinkEntry(CutlistCache *cache, CacheEntry *entry)
+{
+    if (entry->newer) entry->newer->older = entry->older; else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer; else cache->oldest = entry->newer;
+}
+
+static void linkNewest(CutlistCache *cache, CacheEntry *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry; else cache->oldest = entry;
+    cache->newest = entry;
+}
+
+static void freeEntry(CacheEntry *entry)
+{
+    if (entry->ownsRecord)
+    {
+        free((void *)entry->record);
+    }
+    free(entry);
+}
+
+static void evictOldest(CutlistCache *cache)
+{
+    CacheEntry *entry = cache->oldest;
+    CacheEntry **link = &cache->buckets[entry->record->hash & (cache->bucketCount - 1)];
+    while (*link != entry)
+    {
+        link = &(*link)->nextInBucket;
+    }
+    *link = entry->nextInBucket;
+    unlinkEntry(cache, entry);
+
+    cache->bytes -= (size_t)entry->record->recordBytes;
+    cache->entryCount--;
+    cache->evictions++;
+    freeEntry(entry);
+}
+
+// Doubles the buckets once there are more entries than buckets, keeping chains short
+static void growBuckets(CutlistCache *cache)
+{
+    size_t bucket_count = cache->bucketCount * 2;
+    CacheEntry **buckets = (CacheEntry **)calloc(bucket_count, sizeof(CacheEntry *));
+    if (!buckets)
+    {
+        return;
+    }
+    for (CacheEntry *entry = cache->newest; entry; entry = entry->older)
+    {
+        CacheEntry **bucket = &buckets[entry->record->hash & (bucket_count - 1)];
+        entry->nextInBucket = *bucket;
+        *bucket = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucketCount = bucket_count;
+}
+
+// Makes a record the newest entry, evicting the oldest ones past the capacity. A record whose key is already cached
+// only refreshes that entry. Returns 1 if the record was added, 0 if it was not and the caller still owns it
+static int insertRecord(CutlistCache *cache, const CacheRecord *record, int ownsRecord)
+{
+    CacheEntry *existing = findEntry(cache, record, record->hash, record->data);
+    if (existing)
+    {
+        unlinkEntry(cache, existing);
+        linkNewest(cache, existing);
+        return 0;
+    }
+    if ((size_t)record->recordBytes > cache->capacityBytes)
+    {
+        return 0;
+    }
+
+    CacheEntry *entry = (CacheEntry *)malloc(sizeof(CacheEntry));
+    if (!entry)
+    {
+        return 0;
+    }
+    entry->record = record;
+    entry->ownsRecord = ownsRecord;
+    CacheEntry **bucket = &cache->buckets[record->hash & (cache->bucketCount - 1)];
+    entry->nextInBucket = *bucket;
+    *bucket = entry;
+    linkNewest(cache, entry);
+    cache->bytes += (size_t)record->recordBytes;
+    cache->entryCount++;
+
+    while (cache->bytes > cache->capacityBytes)
+    {
+        evictOldest(cache);
+    }
+    if (cache->entryCount > cache->bucketCount)
+    {
+        growBuckets(cache);
+    }
+    return 1;
+}
+
+// Maps the whole store file read-only. Returns 0, or -1 if it is missing or cannot be mapped
+static int mapStoreFile(CutlistCache *cache)
+{
+#ifdef _WIN32
+    cache->mappedFile = CreateFileA(cache->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (cache->mappedFile == INVALID_HANDLE_VALUE)
+    {
+        return -1;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(cache->mappedFile, &size) || (size.QuadPart <= 0))
+    {
+        CloseHandle(cache->mappedFile);
+        return -1;
+    }
+    cache->mappingHandle = CreateFileMappingA(cache->mappedFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    cache->mapping = cache->mappingHandle ? (const unsigned char *)MapViewOfFile(cache->mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!cache->mapping)
+    {
+        if (cache->mappingHandle) CloseHandle(cache->mappingHandle);
+        CloseHandle(cache->mappedFile);
+        return -1;
+    }
+    cache->mappingBytes = (size_t)size.QuadPart;
+#else
+    int descriptor = open(cache->path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        return -1;
+    }
+    struct stat file_status;
+    if ((fstat(descriptor, &file_status) != 0) || (file_status.st_size <= 0))
+    {
+        close(descriptor);
+        return -1;
+    }
+    void *mapping = mmap(NULL, (size_t)file_status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        return -1;
+    }
+    cache->mapping = (const unsigned char *)mapping;
+    cache->mappingBytes = (size_t)file_status.st_size;
+#endif
+    return 0;
+}
+
+static void unmapStoreFile(CutlistCache *cache)
+{
+    if (!cache->mapping)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(cache->mapping);
+    CloseHandle(cache->mappingHandle);
+    CloseHandle(cache->mappedFile);
+#else
+    munmap((void *)cache->mapping, cache->mappingBytes);
+#endif
+    cache->mapping = NULL;
+    cache->mappingBytes = 0;
+}
+
+// Indexes the records of the mapped store, oldest first, stopping at the first that is not whole. Returns the bytes of
+// valid records, header included, or 0 if the file is not a store
+static size_t loadStoreRecords(CutlistCache *cache)
+{
+    const CacheFileHeader *header = (const CacheFileHeader *)cache->mapping;
+    if ((cache->mappingBytes < sizeof(CacheFileHeader)) || (header->magic != CUTLIST_CACHE_MAGIC) ||
+        (header->byteOrder != CUTLIST_CACHE_BYTE_ORDER))
+    {
+        return 0;
+    }
+
+    size_t offset = sizeof(CacheFileHeader);
+    while (offset + sizeof(CacheRecord) <= cache->mappingBytes)
+    {
+        const CacheRecord *record = (const CacheRecord *)(cache->mapping + offset);
+        if ((record->pieceCount < 0) || ((size_t)record->recordBytes != getRecordBytes(record->pieceCount)) ||
+            ((size_t)record->recordBytes > cache->mappingBytes - offset) ||
+            (record->hash != hashRecordKey(record, record->data)))
+        {
+            break;
+        }
+        cache->loadedEntries += insertRecord(cache, record, 0);
+        offset += (size_t)record->recordBytes;
+    }
+    return offset;
+}
+
+CutlistCache *openCutlistCache(const char *path, size_t capacityBytes)
+{
+    CutlistCache *cache = (CutlistCache *)calloc(1, sizeof(CutlistCache));
+    if (!cache)
+    {
+        return NULL;
+    }
+    cache->capacityBytes = (capacityBytes > 0) ? capacityBytes : CUTLIST_CACHE_DEFAULT_CAPACITY;
+    cache->bucketCount = CUTLIST_CACHE_INITIAL_BUCKETS;
+    cache->buckets = (CacheEntry **)calloc(cache->bucketCount, sizeof(CacheEntry *));
+    if (path)
+    {
+        cache->path = (char *)malloc(strlen(path) + 1);
+    }
+    if (!cache->buckets || (path && !cache->path) || (pthread_mutex_init(&cache->lock, NULL) != 0))
+    {
+        free(cache->buckets);
+        free(cache->path);
+        free(cache);
+        return NULL;
+    }
+    if (!path)
+    {
+        return cache;
+    }
+    strcpy(cache->path, path);
+
+    // Records already stored are used straight from the mapping. Appending after a damaged tail would bury the new
+    // records behind it, so such a store is only rewritten on close
+    if (mapStoreFile(cache) == 0)
+    {
+        cache->fileBytes = loadStoreRecords(cache);
+        cache->fileDamaged = (cache->fileBytes != cache->mappingBytes);
+    }
+    if (cache->fileBytes > 0)
+    {
+        cache->appendFile = cache->fileDamaged ? NULL : fopen(path, "ab");
+    }
+    else if (!cache->mapping)
+    {
+        // A new store: nothing maps it, so it can be created here
+        CacheFileHeader header = {CUTLIST_CACHE_MAGIC, CUTLIST_CACHE_BYTE_ORDER};
+        cache->appendFile = fopen(path, "wb");
+        if (cache->appendFile && (fwrite(&header, sizeof(header), 1, cache->appendFile) == 1) && (fflush(cache->appendFile) == 0))
+        {
+            cache->fileBytes = sizeof(header);
+        }
+        else if (cache->appendFile)
+        {
+            fclose(cache->appendFile);
+            cache->appendFile = NULL;
+        }
+    }
+    return cache;
+}
+
+// Writes the live records, oldest first, to a new store and puts it in place of the old one. Mapped records are
+// written before the mapping goes, which it has to before the old store can be replaced
+static int rewriteStoreFile(CutlistCache *cache)
+{
+    size_t temporary_length = strlen(cache->path) + 5;
+    char *temporary_path = (char *)malloc(temporary_length);
+    if (!temporary_path)
+    {
+        return -1;
+    }
+    snprintf(temporary_path, temporary_length, "%s.tmp", cache->path);
+
+    FILE *file = fopen(temporary_path, "wb");
+    int failed = (file == NULL);
+    CacheFileHeader header = {CUTLIST_CACHE_MAGIC, CUTLIST_CACHE_BYTE_ORDER};
+    failed = failed || (fwrite(&header, sizeof(header), 1, file) != 1);
+    for (CacheEntry *entry = cache->oldest; entry && !failed; entry = entry->newer)
+    {
+        failed = (fwrite(entry->record, (size_t)entry->record->recordBytes, 1, file) != 1);
+    }
+    if (file && (fclose(file) != 0))
+    {
+        failed = 1;
+    }
+
+    if (cache->appendFile)
+    {
+        fclose(cache->appendFile);
+        cache->appendFile = NULL;
+    }
+    unmapStoreFile(cache);
+    if (!failed)
+    {
+#ifdef _WIN32
+        remove(cache->path);
+#endif
+        failed = (rename(temporary_path, cache->path) != 0);
+    }
+    if (failed)
+    {
+        remove(temporary_path);
+    }
+    free(temporary_path);
+    return failed ? -1 : 0;
+}
+
+int closeCutlistCache(CutlistCache *cache)
+{
+    if (!cache)
+    {
+        return 0;
+    }
+
+    // The store holds every record stored this session, so anything evicted or damaged makes it bigger than the cache
+    int status = 0;
+    if (cache->path && (cache->fileDamaged || (cache->fileBytes != sizeof(CacheFileHeader) + cache->bytes)))
+    {
+        status = rewriteStoreFile(cache);
+    }
+
+    // Entries may point into the mapping, so they go before it does
+    while (cache->oldest)
+    {
+        CacheEntry *entry = cache->oldest;
+        unlinkEntry(cache, entry);
+        freeEntry(entry);
+    }
+    if (cache->appendFile)
+    {
+        fclose(cache->appendFile);
+    }
+    unmapStoreFile(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->path);
+    free(cache);
+    return status;
+}
+
+// Appends a new record to the store, so it survives a restart. A failed write stops appending, and the store is
+// rewritten on close instead
+static void appendRecord(CutlistCache *cache, const CacheRecord *record)
+{
+    if (!cache->appendFile)
+    {
+        return;
+    }
+    if ((fwrite(record, (size_t)record->recordBytes, 1, cache->appendFile) == 1) && (fflush(cache->appendFile) == 0))
+    {
+        cache->fileBytes += (size_t)record->recordBytes;
+        return;
+    }
+    fclose(cache->appendFile);
+    cache->appendFile = NULL;
+    cache->fileDamaged = 1;
+}
+
+// Copies a cached packing back to the caller, mapping each canonical position to the piece it stands for
+static void copyCachedResult(const CacheRecord *record, const CanonicalOrder *order, CutlistResult *result)
+{
+    const int32_t *stocks = &record->data[record->pieceCount];
+    for (int slot = 0; slot < record->pieceCount; slot++)
+    {
+        result->assignments[order->sortedIndex[slot]] = stocks[slot];
+    }
+    result->status = CUTLIST_STATUS_OK;
+    result->stockUsed = record->stockUsed;
+    result->waste = record->waste;
+    result->stockLowerBound = record->stockLowerBound;
+    result->provenOptimal = record->provenOptimal;
+    result->optimalityGap = record->optimalityGap;
+    result->cost = record->cost;
+    result->stopReason = CUTLIST_STOP_COMPLETED;
+}
+
+int solveCutlistCached(CutlistCache *cache, CutlistSolver *solver, CutlistInput input, CutlistResult *result)
+{
+    if (!cache || (input.stockTypeCount > 0) || (input.pieceCount <= 0) || !input.requiredPieces)
+    {
+        return solveCutlist(solver, input, result);
+    }
+
+    double start_time = getCutlistWallSeconds();
+    CacheRecord key;
+    CanonicalOrder order;
+    if (buildCanonicalOrder(&input, &key, &order) != 0)
+    {
+        return solveCutlist(solver, input, result);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry *entry = findEntry(cache, &key, order.hash, order.sortedLengths);
+    if (entry)
+    {
+        unlinkEntry(cache, entry);
+        linkNewest(cache, entry);
+        cache->hits++;
+        copyCachedResult(entry->record, &order, result);
+        pthread_mutex_unlock(&cache->lock);
+
+        resetCutlistStats(&result->stats);
+        result->stats.totalSeconds = getCutlistWallSeconds() - start_time;
+        free(order.sortKeys);
+        return 0;
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    // Solved outside the lock, so other threads keep using the cache meanwhile
+    int status = solveCutlist(solver, input, result);
+    if ((status == 0) && (result->status == CUTLIST_STATUS_OK) && (result->stopReason == CUTLIST_STOP_COMPLETED))
+    {
+        size_t record_bytes = getRecordBytes(input.pieceCount);
+        CacheRecord *record = (CacheRecord *)calloc(1, record_bytes);
+        if (record)
+        {
+            *record = key;
+            record->hash = order.hash;
+            record->recordBytes = (int32_t)record_bytes;
+            record->stockUsed = result->stockUsed;
+            record->waste = result->waste;
+            record->stockLowerBound = result->stockLowerBound;
+            record->provenOptimal = result->provenOptimal;
+            record->cost = result->cost;
+            record->optimalityGap = result->optimalityGap;
+            for (int slot = 0; slot < input.pieceCount; slot++)
+            {
+                record->data[slot] = order.sortedLengths[slot];
+                record->data[input.pieceCount + slot] = result->assignments[order.sortedIndex[slot]];
+            }
+
+            pthread_mutex_lock(&cache->lock);
+            if (insertRecord(cache, record, 1))
+            {
+                cache->stores++;
+                appendRecord(cache, record);
+            }
+            else
+            {
+                free(record);
+            }
+            pthread_mutex_unlock(&cache->lock);
+        }
+    }
+
+    free(order.sortKeys);
+    return status;
+}
+
+void getCutlistCacheStats(CutlistCache *cache, CutlistCacheStats *stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->stores = cache->stores;
+    stats->evictions = cache->evictions;
+    stats->loadedEntries = cache->loadedEntries;
+    stats->entryCount = cache->entryCount;
+    stats->bytes = cache->bytes;
+    stats->capacityBytes = cache->capacityBytes;
+    long long lookups = cache->hits + cache->misses;
+    stats->hitRate = (lookups > 0) ? (double)cache->hits / lookups : 0.0;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,209 @@
+#include "cutlistDecompose.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+size_t getDecompositionScratchSize(int pieceCount)
+{
+    // Fill order, load, first piece and number of every stock, at most one per piece, the pieces by stock, then the
+    // stocks of a window and its pieces with their sizes and stocks
+    return (size_t)pieceCount * (sizeof(long long) + 4 * sizeof(int)) + sizeof(int) +
+           4 * (size_t)CUTLIST_DECOMPOSE_WINDOW_PIECES * sizeof(int);
+}
+
+static int compareFillKeys(const void *first, const void *second)
+{
+    long long first_key = *(const long long *)first;
+    long long second_key = *(const long long *)second;
+    return (first_key > second_key) - (first_key < second_key);
+}
+
+int findBestPackingByDecomposition(PackingState *state, CutlistSolver **windowSolver, void *scratch)
+{
+    if (!*windowSolver)
+    {
+        *windowSolver = createCutlistSolver(CUTLIST_DECOMPOSE_WINDOW_PIECES);
+        if (!*windowSolver)
+        {
+            return -1;
+        }
+    }
+
+    int piece_count = state->totalPieces;
+    long long *fill_order = (long long *)scratch;   // (load << 32 | stock), least filled first
+    int *stock_load = (int *)&fill_order[piece_count];
+    int *stock_number = &stock_load[piece_count];
+    int *stock_first = &stock_number[piece_count];  // Pieces of stock s are stock_pieces[stock_first[s]..stock_first[s + 1])
+    int *stock_pieces = &stock_first[piece_count + 1];
+    int *window_stocks = &stock_pieces[piece_count];
+    int *window_pieces = &window_stocks[CUTLIST_DECOMPOSE_WINDOW_PIECES];
+    int *window_sizes = &window_pieces[CUTLIST_DECOMPOSE_WINDOW_PIECES];
+    int *window_assignments = &window_sizes[CUTLIST_DECOMPOSE_WINDOW_PIECES];
+
+    // Each window is the least-filled stocks, with up to half its pieces, and a run of fuller stocks after them in the
+    // fill order. The run moves on every round, so a pass takes each stock into a window once; passes go on while
+    // they save a stock
+    int fuller_start = 0;
+    int pass_saved = 0;
+    int packing_changed = 1;
+    while (state->optimalStockCount > state->rootLowerBound)
+    {
+        if (isSearchBudgetExhausted(state))
+        {
+            state->budgetExhausted = 1;
+            break;
+        }
+
+        // Loads and the pieces of every stock only change when a window saves a stock
+        int stock_count = state->optimalStockCount;
+        if (packing_changed)
+        {
+            memset(stock_load, 0, (size_t)stock_count * sizeof(int));
+            memset(stock_first, 0, (size_t)(stock_count + 1) * sizeof(int));
+            for (int piece_index = 0; piece_index < piece_count; piece_index++)
+            {
+                stock_load[state->optimalAssignments[piece_index]] += state->pieceSizes[piece_index];
+                stock_first[state->optimalAssignments[piece_index] + 1]++;
+            }
+            for (int stock_index = 0; stock_index < stock_count; stock_index++)
+            {
+                stock_first[stock_index + 1] += stock_first[stock_index];
+                stock_number[stock_index] = stock_first[stock_index];
+                fill_order[stock_index] = ((long long)stock_load[stock_index] << 32) | stock_index;
+            }
+            for (int piece_index = 0; piece_index < piece_count; piece_index++)
+            {
+                stock_pieces[stock_number[state->optimalAssignments[piece_index]]++] = piece_index;
+            }
+            qsort(fill_order, (size_t)stock_count, sizeof(long long), compareFillKeys);
+            packing_changed = 0;
+        }
+        if (fuller_start >= stock_count)
+        {
+            if (!pass_saved)
+            {
+                CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Decomposition: a pass over the packing saved no stock.\n\n");
+                break;
+            }
+            fuller_start = 0;
+            pass_saved = 0;
+        }
+
+        // The least-filled part, then the run from where the last window left off
+        int window_stock_count = 0;
+        int window_count = 0;
+        long long free_length = 0;
+        int order_index = 0;
+        for (int part = 0; part < 2; part++)
+        {
+            int part_limit = CUTLIST_DECOMPOSE_WINDOW_PIECES / 2;
+            if (part == 1)
+            {
+                order_index = (fuller_start > order_index) ? fuller_start : order_index;
+                fuller_start = order_index;
+                part_limit = CUTLIST_DECOMPOSE_WINDOW_PIECES;
+            }
+            while (order_index < stock_count)
+            {
+                int stock_index = (int)(fill_order[order_index] & 0xFFFFFFFF);
+                int first_piece = stock_first[stock_index];
+                int end_piece = stock_first[stock_index + 1];
+                if (window_count + end_piece - first_piece > part_limit)
+                {
+                    break;
+                }
+                for (int list_index = first_piece; list_index < end_piece; list_index++)
+                {
+                    window_pieces[window_count] = stock_pieces[list_index];
+                    window_sizes[window_count] = state->pieceSizes[stock_pieces[list_index]];
+                    window_assignments[window_count++] = window_stock_count;
+                }
+                window_stocks[window_stock_count++] = stock_index;
+                free_length += state->stockLength - stock_load[stock_index];
+                order_index++;
+            }
+        }
+        fuller_start = (order_index > fuller_start) ? order_index : fuller_start + 1;
+
+        // Only a window with a whole stock's length free between its stocks can do without one of them
+        if ((window_stock_count < 2) || (free_length < state->stockLength))
+        {
+            continue;
+        }
+
+        // The window's pieces already carry the kerf, and stockLength the trim, so the window is solved without either.
+        // It goes to the pattern engine, whose LP bound settles most windows, rather than to the cost estimate of the
+        // exact strategy. It keeps to what is left of the caller's budget, and does without a transposition table, which
+        // would cost more to clear than such a short search saves
+        CutlistSolveOptions window_options = {0};
+        window_options.nodeLimit = CUTLIST_DECOMPOSE_WINDOW_NODES;
+        if ((state->nodeLimit > 0) && (state->nodeLimit - state->nodeCount < window_options.nodeLimit))
+        {
+            window_options.nodeLimit = state->nodeLimit - state->nodeCount;
+        }
+        if (state->deadline > 0)
+        {
+            // A limit of 0 means none, so a deadline just passed still leaves the window a token one
+            double seconds_left = state->deadline - getCutlistWallSeconds();
+            window_options.timeLimitSeconds = (seconds_left > 1e-6) ? seconds_left : 1e-6;
+        }
+        window_options.transpositionEntries = -1;
+        window_options.cancelRequested = state->cancelRequested;
+        CutlistInput window_input;
+        memset(&window_input, 0, sizeof(window_input));
+        window_input.requiredPieces = window_sizes;
+        window_input.pieceCount = window_count;
+        window_input.stockLength = state->stockLength;
+        window_input.traceLevel = CUTLIST_TRACE_OFF;
+        window_input.threadCount = 1;
+        window_input.strategy = CUTLIST_STRATEGY_PATTERNS;
+        window_input.options = &window_options;
+        CutlistResult window_result;
+        window_result.assignments = window_assignments;
+        int status = solveCutlist(*windowSolver, window_input, &window_result);
+        state->nodeCount += window_result.stats.nodesExpanded;
+        if (status != 0)
+        {
+            break;
+        }
+        if (window_result.stockUsed >= window_stock_count)
+        {
+            continue;
+        }
+
+        // Window stock j goes on the window's j-th stock, its other stocks are dropped, and the stocks left are
+        // numbered in their previous order
+        for (int stock_index = 0; stock_index < stock_count; stock_index++)
+        {
+            stock_number[stock_index] = 0;
+        }
+        for (int window_index = window_result.stockUsed; window_index < window_stock_count; window_index++)
+        {
+            stock_number[window_stocks[window_index]] = -1;
+        }
+        for (int window_index = 0; window_index < window_count; window_index++)
+        {
+            state->optimalAssignments[window_pieces[window_index]] = window_stocks[window_assignments[window_index]];
+        }
+        int next_number = 0;
+        for (int stock_index = 0; stock_index < stock_count; stock_index++)
+        {
+            stock_number[stock_index] = (stock_number[stock_index] < 0) ? -1 : next_number++;
+        }
+        for (int piece_index = 0; piece_index < piece_count; piece_index++)
+        {
+            state->optimalAssignments[piece_index] = stock_number[state->optimalAssignments[piece_index]];
+        }
+        packing_changed = 1;
+        pass_saved = 1;
+
+        state->optimalStockCount = next_number;
+        state->optimalWaste = next_number * state->stockLength - state->remainingPieceLength[0];
+        state->optimalTask = CUTLIST_NO_TASK;
+        recordCutlistImprovement(state, state->nodeCount, state->optimalStockCount, state->optimalWaste, 0);
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "New Best Found: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
+    }
+
+    state->stats.memoryBytes += sizeof(CutlistSolver) + (*windowSolver)->arenaCapacity;
+    return 0;
+}
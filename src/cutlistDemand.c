@@ -0,0 +1,882 @@
+#include "cutlistDemand.h"
+#include "cutlistPatterns.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Patterns as they are found, growing as needed. Until they are handed out to the demands, a cut's demandIndex holds
+// the index of a class
+typedef struct {
+    CutlistPattern *patterns;
+    int patternCount;
+    int patternCapacity;
+    CutlistPatternCut *cuts;
+    int cutCount;
+    int cutCapacity;
+    int failed;                   // An allocation failed, later additions are dropped
+} PatternList;
+
+// The order grouped into classes of one packed size, by descending size. Kerf is included, as in PackingState
+typedef struct {
+    int classCount;
+    int *classSizes;
+    int *classCounts;
+    int *classFirstDemand;        // Demands of class k are demandOrder[classFirstDemand[k], classFirstDemand[k + 1])
+    int *demandOrder;             // Demands with pieces, by descending length, then in the caller's order
+    int stockLength;              // Length packed into a stock, as PackingState.stockLength
+    long long totalLength;
+    int totalPieces;
+} DemandClasses;
+
+// Marks a result as failed, with no patterns and the -1 stock and waste sentinels. Returns -1
+static int failDemandSolve(CutlistDemandResult *result, CutlistStatus status)
+{
+    result->patterns = NULL;
+    result->patternCount = 0;
+    result->cuts = NULL;
+    result->cutCount = 0;
+    result->status = status;
+    result->stockUsed = -1;
+    result->waste = -1;
+    return -1;
+}
+
+void freeCutlistDemandResult(CutlistDemandResult *result)
+{
+    free(result->patterns);
+    free(result->cuts);
+    result->patterns = NULL;
+    result->patternCount = 0;
+    result->cuts = NULL;
+    result->cutCount = 0;
+}
+
+static void freePatternList(PatternList *list)
+{
+    free(list->patterns);
+    free(list->cuts);
+    memset(list, 0, sizeof(*list));
+}
+
+// Starts a pattern cut repeat times. Its cuts are the ones added until the next pattern
+static void addPattern(PatternList *list, int repeat)
+{
+    if (!list->failed && (list->patternCount == list->patternCapacity))
+    {
+        int capacity = (list->patternCapacity > 0) ? (list->patternCapacity * 2) : 16;
+        CutlistPattern *patterns = (CutlistPattern *)realloc(list->patterns, (size_t)capacity * sizeof(CutlistPattern));
+        list->failed = !patterns;
+        list->patterns = patterns ? patterns : list->patterns;
+        list->patternCapacity = patterns ? capacity : list->patternCapacity;
+    }
+    if (!list->failed)
+    {
+        CutlistPattern *pattern = &list->patterns[list->patternCount++];
+        pattern->repeat = repeat;
+        pattern->firstCut = list->cutCount;
+        pattern->cutCount = 0;
+        pattern->waste = 0;
+    }
+}
+
+static void addCut(PatternList *list, int index, int quantity)
+{
+    if (!list->failed && (list->cutCount == list->cutCapacity))
+    {
+        int capacity = (list->cutCapacity > 0) ? (list->cutCapacity * 2) : 64;
+        CutlistPatternCut *cuts = (CutlistPatternCut *)realloc(list->cuts, (size_t)capacity * sizeof(CutlistPatternCut));
+        list->failed = !cuts;
+        list->cuts = cuts ? cuts : list->cuts;
+        list->cutCapacity = cuts ? capacity : list->cutCapacity;
+    }
+    if (!list->failed)
+    {
+        list->cuts[list->cutCount].demandIndex = index;
+        list->cuts[list->cutCount].quantity = quantity;
+        list->cutCount++;
+        list->patterns[list->patternCount - 1].cutCount++;
+    }
+}
+
+static int compareDemandKeys(const void *first, const void *second)
+{
+    long long first_key = *(const long long *)first;
+    long long second_key = *(const long long *)second;
+    return (first_key > second_key) - (first_key < second_key);
+}
+
+// Groups the demands with pieces into classes. Returns 0, or -1 if memory runs out
+static int buildDemandClasses(const CutlistDemandInput *input, int stockLength, DemandClasses *classes)
+{
+    int demand_count = input->demandCount;
+    size_t block_ints = 4 * (size_t)demand_count + 1;
+    long long *keys = (long long *)malloc((size_t)demand_count * sizeof(long long) + 1);
+    int *block = (int *)malloc(block_ints * sizeof(int));
+    if (!keys || !block)
+    {
+        free(keys);
+        free(block);
+        return -1;
+    }
+    classes->classSizes = block;
+    classes->classCounts = &block[demand_count];
+    classes->classFirstDemand = &block[2 * (size_t)demand_count];
+    classes->demandOrder = classes->classFirstDemand + demand_count + 1;
+    classes->stockLength = stockLength;
+    classes->totalLength = 0;
+    classes->totalPieces = 0;
+
+    // Longest first, equal lengths in the caller's order
+    int key_count = 0;
+    for (int demand_index = 0; demand_index < demand_count; demand_index++)
+    {
+        if (input->demands[demand_index].quantity > 0)
+        {
+            keys[key_count++] = ((long long)(INT_MAX - input->demands[demand_index].length) << 32) | demand_index;
+        }
+    }
+    qsort(keys, (size_t)key_count, sizeof(long long), compareDemandKeys);
+
+    classes->classCount = 0;
+    for (int key_index = 0; key_index < key_count; key_index++)
+    {
+        int demand_index = (int)(keys[key_index] & 0xFFFFFFFF);
+        const CutlistDemand *demand = &input->demands[demand_index];
+        int size = demand->length + input->kerfWidth;
+        if ((classes->classCount == 0) || (classes->classSizes[classes->classCount - 1] != size))
+        {
+            classes->classSizes[classes->classCount] = size;
+            classes->classCounts[classes->classCount] = 0;
+            classes->classFirstDemand[classes->classCount] = key_index;
+            classes->classCount++;
+        }
+        classes->classCounts[classes->classCount - 1] += demand->quantity;
+        classes->demandOrder[key_index] = demand_index;
+        classes->totalLength += (long long)demand->quantity * size;
+        classes->totalPieces += demand->quantity;
+    }
+    classes->classFirstDemand[classes->classCount] = key_count;
+
+    free(keys);
+    return 0;
+}
+
+static void freeDemandClasses(DemandClasses *classes)
+{
+    free(classes->classSizes);
+}
+
+// First-fit decreasing one stock at a time: a stock takes as many pieces of every class as fit, largest first, which
+// is what first-fit decreasing puts on the first stock it opens, and as many stocks as the remaining counts allow are
+// cut to that pattern at once. remaining is the count of every class, used up as patterns are added. alive is scratch
+// for one int per class. Returns the stocks cut
+static int packGreedyPatterns(const DemandClasses *classes, int *remaining, int *alive, PatternList *list)
+{
+    int alive_count = 0;
+    for (int class_index = 0; class_index < classes->classCount; class_index++)
+    {
+        if (remaining[class_index] > 0)
+        {
+            alive[alive_count++] = class_index;
+        }
+    }
+
+    int stock_count = 0;
+    while ((alive_count > 0) && !list->failed)
+    {
+        // The cuts of the pattern go straight into the list, the repeat is set once they are known
+        addPattern(list, 0);
+        int first_cut = list->cutCount;
+        int space = classes->stockLength;
+        int smallest_size = classes->classSizes[alive[alive_count - 1]];
+        for (int alive_index = 0; (alive_index < alive_count) && (space >= smallest_size); alive_index++)
+        {
+            int class_index = alive[alive_index];
+            int size = classes->classSizes[class_index];
+            int count = (size > 0) ? (space / size) : remaining[class_index];
+            count = (count < remaining[class_index]) ? count : remaining[class_index];
+            if (count > 0)
+            {
+                addCut(list, class_index, count);
+                space -= count * size;
+            }
+        }
+        if (list->failed)
+        {
+            break;
+        }
+
+        int repeat = INT_MAX;
+        for (int cut_index = first_cut; cut_index < list->cutCount; cut_index++)
+        {
+            const CutlistPatternCut *cut = &list->cuts[cut_index];
+            int copies = remaining[cut->demandIndex] / cut->quantity;
+            repeat = (copies < repeat) ? copies : repeat;
+        }
+        list->patterns[list->patternCount - 1].repeat = repeat;
+        stock_count += repeat;
+
+        int kept = 0;
+        for (int cut_index = first_cut; cut_index < list->cutCount; cut_index++)
+        {
+            remaining[list->cuts[cut_index].demandIndex] -= repeat * list->cuts[cut_index].quantity;
+        }
+        for (int alive_index = 0; alive_index < alive_count; alive_index++)
+        {
+            if (remaining[alive[alive_index]] > 0)
+            {
+                alive[kept++] = alive[alive_index];
+            }
+        }
+        alive_count = kept;
+    }
+    return stock_count;
+}
+
+typedef struct {
+    uint64_t hash;
+    int stock;
+} StockKey;
+
+static int compareStockKeys(const void *first, const void *second)
+{
+    const StockKey *first_key = (const StockKey *)first;
+    const StockKey *second_key = (const StockKey *)second;
+    if (first_key->hash != second_key->hash)
+    {
+        return (first_key->hash > second_key->hash) ? 1 : -1;
+    }
+    return (first_key->stock > second_key->stock) - (first_key->stock < second_key->stock);
+}
+
+// Groups the stocks of a packing, piece by piece, into patterns of classes, each pattern where its first stock was.
+// pieceClasses gives the class of every piece. Stocks of equal cuts are found by sorting them on a hash of their
+// cuts, and only stocks of equal hash are compared. Returns 0, or -1 if memory runs out
+static int groupStocksIntoPatterns(const int *pieceClasses, const int *assignments, int pieceCount, int stockCount,
+                                   int classCount, PatternList *list)
+{
+    // Counting sorts, by class and then stably by stock, leave every stock's pieces in runs of one class
+    size_t stock_ints = (size_t)stockCount + 1;
+    int *block = (int *)malloc(((size_t)classCount + 1 + 2 * (size_t)pieceCount + 3 * stock_ints) * sizeof(int));
+    StockKey *keys = (StockKey *)malloc((stock_ints) * sizeof(StockKey));
+    if (!block || !keys)
+    {
+        free(block);
+        free(keys);
+        return -1;
+    }
+    int *class_start = block;
+    int *pieces_by_class = &class_start[classCount + 1];
+    int *pieces_by_stock = &pieces_by_class[pieceCount];
+    int *stock_start = &pieces_by_stock[pieceCount];
+    int *representative = &stock_start[stock_ints];
+    int *pattern_of_stock = &representative[stock_ints];
+
+    memset(class_start, 0, ((size_t)classCount + 1) * sizeof(int));
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        class_start[pieceClasses[piece_index] + 1]++;
+    }
+    for (int class_index = 0; class_index < classCount; class_index++)
+    {
+        class_start[class_index + 1] += class_start[class_index];
+    }
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        pieces_by_class[class_start[pieceClasses[piece_index]]++] = piece_index;
+    }
+
+    memset(stock_start, 0, stock_ints * sizeof(int));
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        stock_start[assignments[piece_index] + 1]++;
+    }
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        stock_start[stock_index + 1] += stock_start[stock_index];
+    }
+    for (int slot = 0; slot < pieceCount; slot++)
+    {
+        int piece_index = pieces_by_class[slot];
+        pieces_by_stock[stock_start[assignments[piece_index]]++] = pieceClasses[piece_index];
+    }
+    // After the deal stock_start[s] is the end of stock s, shift it back to its start
+    for (int stock_index = stockCount; stock_index > 0; stock_index--)
+    {
+        stock_start[stock_index] = stock_start[stock_index - 1];
+    }
+    stock_start[0] = 0;
+
+    // FNV-1a over the classes of a stock's pieces, which already says how many of each it has
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (int slot = stock_start[stock_index]; slot < stock_start[stock_index + 1]; slot++)
+        {
+            hash = (hash ^ (uint32_t)pieces_by_stock[slot]) * 1099511628211ull;
+        }
+        keys[stock_index].hash = hash;
+        keys[stock_index].stock = stock_index;
+    }
+    qsort(keys, (size_t)stockCount, sizeof(StockKey), compareStockKeys);
+
+    // Every stock is represented by the first stock with the same pieces. Within a run of equal hashes the stocks are
+    // in ascending order, so the first match is the first such stock
+    int run_start = 0;
+    for (int key_index = 0; key_index < stockCount; key_index++)
+    {
+        if ((key_index > 0) && (keys[key_index].hash != keys[key_index - 1].hash))
+        {
+            run_start = key_index;
+        }
+        int stock_index = keys[key_index].stock;
+        int length = stock_start[stock_index + 1] - stock_start[stock_index];
+        representative[stock_index] = stock_index;
+        for (int earlier = run_start; earlier < key_index; earlier++)
+        {
+            int other = keys[earlier].stock;
+            if ((representative[other] == other) && (stock_start[other + 1] - stock_start[other] == length) &&
+                (memcmp(&pieces_by_stock[stock_start[other]], &pieces_by_stock[stock_start[stock_index]], (size_t)length * sizeof(int)) == 0))
+            {
+                representative[stock_index] = other;
+                break;
+            }
+        }
+    }
+
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        pattern_of_stock[stock_index] = -1;
+    }
+    for (int stock_index = 0; (stock_index < stockCount) && !list->failed; stock_index++)
+    {
+        int first_stock = representative[stock_index];
+        if (pattern_of_stock[first_stock] < 0)
+        {
+            pattern_of_stock[first_stock] = list->patternCount;
+            addPattern(list, 0);
+            for (int slot = stock_start[stock_index]; slot < stock_start[stock_index + 1]; slot++)
+            {
+                int class_index = pieces_by_stock[slot];
+                if ((slot == stock_start[stock_index]) || (class_index != pieces_by_stock[slot - 1]))
+                {
+                    addCut(list, class_index, 0);
+                }
+                if (!list->failed)
+                {
+                    list->cuts[list->cutCount - 1].quantity++;
+                }
+            }
+        }
+        if (!list->failed)
+        {
+            list->patterns[pattern_of_stock[first_stock]].repeat++;
+        }
+    }
+
+    free(block);
+    free(keys);
+    return list->failed ? -1 : 0;
+}
+
+// Solves pieces of the classes, count of each in counts, with solveCutlist and adds its stocks to list as patterns.
+// Returns the stocks used, or -1 with result->status set if the solve fails
+static int solveClassPieces(CutlistSolver *solver, const CutlistDemandInput *input, const DemandClasses *classes,
+                            const int *counts, const CutlistSolveOptions *options, PatternList *list, CutlistResult *result)
+{
+    int piece_count = 0;
+    for (int class_index = 0; class_index < classes->classCount; class_index++)
+    {
+        piece_count += counts[class_index];
+    }
+
+    int *block = (int *)malloc(3 * ((size_t)piece_count + 1) * sizeof(int));
+    if (!block)
+    {
+        result->status = CUTLIST_STATUS_OUT_OF_MEMORY;
+        return -1;
+    }
+    int *pieces = block;
+    int *piece_classes = &pieces[piece_count + 1];
+    result->assignments = &piece_classes[piece_count + 1];
+
+    int piece_index = 0;
+    for (int class_index = 0; class_index < classes->classCount; class_index++)
+    {
+        for (int count = 0; count < counts[class_index]; count++, piece_index++)
+        {
+            pieces[piece_index] = classes->classSizes[class_index] - input->kerfWidth;
+            piece_classes[piece_index] = class_index;
+        }
+    }
+
+    CutlistInput piece_input = {pieces, piece_count, input->stockLength, input->traceLevel, input->threadCount, input->strategy, options,
+                                NULL, 0, input->kerfWidth, input->trimLength};
+    int stock_count = -1;
+    if ((solveCutlist(solver, piece_input, result) == 0) &&
+        (groupStocksIntoPatterns(piece_classes, result->assignments, piece_count, result->stockUsed, classes->classCount, list) == 0))
+    {
+        stock_count = result->stockUsed;
+    }
+    else if (result->status == CUTLIST_STATUS_OK)
+    {
+        result->status = CUTLIST_STATUS_OUT_OF_MEMORY;
+    }
+    result->assignments = NULL;
+    free(block);
+    return stock_count;
+}
+
+// Hands the pieces of every class out to its demands in order, pattern by pattern, into the result. Stocks whose cuts
+// all stay within one demand per class keep their pattern; a stock where a demand runs out takes the rest of that cut
+// from the next, in a pattern of its own. That adds at most two patterns per demand. Returns 0, or -1 if memory runs out
+static int emitDemandPatterns(const DemandClasses *classes, const PatternList *classPatterns, const CutlistDemandInput *input,
+                              CutlistDemandResult *result)
+{
+    PatternList list = {0};
+    int *order_index = (int *)malloc(2 * ((size_t)classes->classCount + 1) * sizeof(int));
+    if (!order_index)
+    {
+        return -1;
+    }
+    int *left = &order_index[classes->classCount + 1];
+    for (int class_index = 0; class_index < classes->classCount; class_index++)
+    {
+        order_index[class_index] = classes->classFirstDemand[class_index];
+        left[class_index] = input->demands[classes->demandOrder[order_index[class_index]]].quantity;
+    }
+
+    for (int pattern_index = 0; (pattern_index < classPatterns->patternCount) && !list.failed; pattern_index++)
+    {
+        const CutlistPattern *pattern = &classPatterns->patterns[pattern_index];
+        const CutlistPatternCut *cuts = &classPatterns->cuts[pattern->firstCut];
+        int repeat = pattern->repeat;
+        while ((repeat > 0) && !list.failed)
+        {
+            int copies = repeat;
+            for (int cut_index = 0; cut_index < pattern->cutCount; cut_index++)
+            {
+                int fitting = left[cuts[cut_index].demandIndex] / cuts[cut_index].quantity;
+                copies = (fitting < copies) ? fitting : copies;
+            }
+            copies = (copies > 0) ? copies : 1;
+
+            addPattern(&list, copies);
+            long long packed_length = 0;
+            for (int cut_index = 0; cut_index < pattern->cutCount; cut_index++)
+            {
+                int class_index = cuts[cut_index].demandIndex;
+                int quantity = cuts[cut_index].quantity;
+                packed_length += (long long)quantity * classes->classSizes[class_index];
+
+                // Only a single copy can spill over into the next demand
+                while (quantity > 0)
+                {
+                    int taken = (copies == 1) ? ((quantity < left[class_index]) ? quantity : left[class_index]) : quantity;
+                    addCut(&list, classes->demandOrder[order_index[class_index]], taken);
+                    left[class_index] -= taken * copies;
+                    quantity -= taken;
+                    if ((left[class_index] == 0) && (order_index[class_index] + 1 < classes->classFirstDemand[class_index + 1]))
+                    {
+                        order_index[class_index]++;
+                        left[class_index] = input->demands[classes->demandOrder[order_index[class_index]]].quantity;
+                    }
+                }
+            }
+            if (!list.failed)
+            {
+                list.patterns[list.patternCount - 1].waste = (int)(classes->stockLength - packed_length);
+            }
+            repeat -= copies;
+        }
+    }
+
+    free(order_index);
+    if (list.failed)
+    {
+        freePatternList(&list);
+        return -1;
+    }
+    result->patterns = list.patterns;
+    result->patternCount = list.patternCount;
+    result->cuts = list.cuts;
+    result->cutCount = list.cutCount;
+    return 0;
+}
+
+// Returns 1 if the Gilmore-Gomory LP takes the classes: few enough lengths, a short enough stock and no zero sizes
+static int isLpRoundingPossible(const DemandClasses *classes)
+{
+    int class_count = classes->classCount;
+    return (class_count > 0) && (class_count <= CUTLIST_PATTERN_MAX_CLASSES) &&
+           (classes->stockLength <= CUTLIST_PATTERN_MAX_STOCK_LENGTH) && (classes->classSizes[class_count - 1] > 0);
+}
+
+// LP rounding: every pattern of the LP solution is cut as many whole times as the LP uses it, as far as the counts
+// allow, and what is left, usually a few stocks' worth, is solved piece by piece, or packed greedily if it is too big
+// for that. Raises lowerBound to the LP bound. Returns the stocks used, or -1 if the classes do not suit the LP or
+// memory runs out
+static int packByLpRounding(CutlistSolver *solver, const CutlistDemandInput *input, const DemandClasses *classes,
+                            PackingState *progress, PatternList *list, int *lowerBound, CutlistResult *residualResult)
+{
+    int class_count = classes->classCount;
+    if (!isLpRoundingPossible(classes))
+    {
+        return -1;
+    }
+
+    size_t scratch_size = getPatternLpScratchSize(classes->classSizes, classes->classCounts, class_count, classes->stockLength);
+    void *scratch = malloc(scratch_size);
+    int *patterns = (int *)malloc(((size_t)class_count * class_count + 2 * (size_t)class_count) * sizeof(int));
+    double *stock_counts = (double *)malloc((size_t)class_count * sizeof(double));
+    if (!scratch || !patterns || !stock_counts)
+    {
+        free(scratch);
+        free(patterns);
+        free(stock_counts);
+        return -1;
+    }
+    int *remaining = &patterns[(size_t)class_count * class_count];
+    int *alive = &remaining[class_count];
+    progress->stats.memoryBytes += scratch_size;
+
+    int lp_bound = computePatternLpSolution(classes->classSizes, classes->classCounts, class_count, classes->stockLength,
+                                            scratch, patterns, stock_counts);
+    CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "Pattern LP bound on stock used: %d\n\n", lp_bound);
+    *lowerBound = (lp_bound > *lowerBound) ? lp_bound : *lowerBound;
+    free(scratch);
+
+    memcpy(remaining, classes->classCounts, (size_t)class_count * sizeof(int));
+    int stock_count = 0;
+    for (int row = 0; row < class_count; row++)
+    {
+        const int *pattern = &patterns[(size_t)row * class_count];
+        int copies = (int)(stock_counts[row] + 1e-6);
+        for (int class_index = 0; class_index < class_count; class_index++)
+        {
+            if ((pattern[class_index] > 0) && (remaining[class_index] / pattern[class_index] < copies))
+            {
+                copies = remaining[class_index] / pattern[class_index];
+            }
+        }
+        if (copies <= 0)
+        {
+            continue;
+        }
+
+        addPattern(list, copies);
+        for (int class_index = 0; class_index < class_count; class_index++)
+        {
+            if (pattern[class_index] > 0)
+            {
+                addCut(list, class_index, pattern[class_index]);
+                remaining[class_index] -= copies * pattern[class_index];
+            }
+        }
+        stock_count += copies;
+    }
+
+    // What the LP leaves goes to the exact search, within what is left of the budget, or failing that to the greedy
+    int residual_pieces = 0;
+    for (int class_index = 0; class_index < class_count; class_index++)
+    {
+        residual_pieces += remaining[class_index];
+    }
+    int residual_stocks = 0;
+    if ((residual_pieces > 0) && (residual_pieces <= CUTLIST_DEMAND_EXPAND_MAX_PIECES))
+    {
+        CutlistSolveOptions residual_options = {0};
+        if (input->options)
+        {
+            residual_options = *input->options;
+        }
+        residual_options.onImprovement = NULL;
+        if (progress->deadline > 0)
+        {
+            // A limit of 0 means none, so a deadline just passed still leaves the search a token one
+            double seconds_left = progress->deadline - getCutlistWallSeconds();
+            residual_options.timeLimitSeconds = (seconds_left > 1e-6) ? seconds_left : 1e-6;
+        }
+        residual_stocks = solveClassPieces(solver, input, classes, remaining, &residual_options, list, residualResult);
+        CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "LP rounding: %d stocks, %d more for the %d pieces left\n\n",
+                      stock_count, residual_stocks, residual_pieces);
+    }
+    else if (residual_pieces > 0)
+    {
+        residual_stocks = packGreedyPatterns(classes, remaining, alive, list);
+    }
+
+    free(patterns);
+    free(stock_counts);
+    return ((residual_stocks < 0) || list->failed) ? -1 : (stock_count + residual_stocks);
+}
+
+// Packs an order too large to expand without ever expanding it
+static int solveDemandByPatterns(CutlistSolver *solver, const CutlistDemandInput *input, const DemandClasses *classes,
+                                 CutlistDemandResult *result)
+{
+    double start_time = getCutlistWallSeconds();
+    const CutlistSolveOptions *options = input->options;
+
+    // A state for the budget and the improvements only, as the search has none of its own
+    PackingState progress;
+    memset(&progress, 0, sizeof(progress));
+    resetCutlistStats(&progress.stats);
+    progress.traceLevel = input->traceLevel;
+    progress.stockLength = classes->stockLength;
+    progress.stockCost = input->stockLength;
+    progress.startTime = start_time;
+    progress.nodeLimit = options ? options->nodeLimit : 0;
+    progress.deadline = (options && (options->timeLimitSeconds > 0)) ? (start_time + options->timeLimitSeconds) : 0;
+    progress.cancelRequested = options ? options->cancelRequested : NULL;
+    progress.onImprovement = options ? options->onImprovement : NULL;
+    progress.userData = options ? options->userData : NULL;
+
+    int class_count = classes->classCount;
+    int lower_bound = computeL2Bound(classes->classSizes, classes->classCounts, class_count, classes->classCounts[0], NULL, 0,
+                                     classes->classSizes[class_count - 1], classes->stockLength);
+    CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "Demand: %d pieces of %d lengths, lower bound on stock used: %d\n\n",
+                  classes->totalPieces, class_count, lower_bound);
+
+    PatternList best = {0};
+    int *remaining = (int *)malloc(2 * (size_t)class_count * sizeof(int));
+    if (!remaining)
+    {
+        return failDemandSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+    }
+    memcpy(remaining, classes->classCounts, (size_t)class_count * sizeof(int));
+    int best_stocks = packGreedyPatterns(classes, remaining, &remaining[class_count], &best);
+    free(remaining);
+    if (best.failed)
+    {
+        freePatternList(&best);
+        return failDemandSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+    }
+    long long waste = (long long)best_stocks * classes->stockLength - classes->totalLength;
+    recordCutlistImprovement(&progress, 0, best_stocks, (waste < INT_MAX) ? (int)waste : INT_MAX, 0);
+    CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "Greedy patterns: Stock Used = %d in %d patterns\n\n", best_stocks, best.patternCount);
+
+    // The search stops where a piece-by-piece solve of the same order would, once the greedy meets the bound
+    CutlistStopReason stop_reason = CUTLIST_STOP_COMPLETED;
+    if ((input->strategy != CUTLIST_STRATEGY_FIRST_FIT_DECREASING) && (input->strategy != CUTLIST_STRATEGY_BEST_FIT_DECREASING) &&
+        (best_stocks > lower_bound))
+    {
+        if (isSearchBudgetExhausted(&progress))
+        {
+            stop_reason = (options->cancelRequested && atomic_load_explicit(options->cancelRequested, memory_order_relaxed)) ? CUTLIST_STOP_CANCELLED :
+                          (progress.deadline > 0) ? CUTLIST_STOP_TIME_LIMIT : CUTLIST_STOP_NODE_LIMIT;
+        }
+        else if (!isLpRoundingPossible(classes))
+        {
+            // Expanding the order instead would cost the very memory and time the patterns are here to save
+            stop_reason = CUTLIST_STOP_SEARCH_SKIPPED;
+            CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "Too many lengths or too long a stock for the pattern LP, "
+                          "keeping the greedy patterns\n\n");
+        }
+        else
+        {
+            PatternList rounded = {0};
+            CutlistResult residual_result;
+            memset(&residual_result, 0, sizeof(residual_result));
+            residual_result.stopReason = CUTLIST_STOP_COMPLETED;
+            int rounded_stocks = packByLpRounding(solver, input, classes, &progress, &rounded, &lower_bound, &residual_result);
+            progress.nodeCount = residual_result.stats.nodesExpanded;
+            for (int reason = 0; reason < CUTLIST_PRUNE_REASON_COUNT; reason++)
+            {
+                progress.stats.prunes[reason] += residual_result.stats.prunes[reason];
+            }
+            progress.stats.transpositionHits = residual_result.stats.transpositionHits;
+            progress.stats.transpositionMisses = residual_result.stats.transpositionMisses;
+            progress.stats.transpositionStores = residual_result.stats.transpositionStores;
+            progress.stats.memoryBytes += residual_result.stats.memoryBytes;
+            stop_reason = residual_result.stopReason;
+
+            if ((rounded_stocks >= 0) && (rounded_stocks < best_stocks))
+            {
+                freePatternList(&best);
+                best = rounded;
+                best_stocks = rounded_stocks;
+                waste = (long long)best_stocks * classes->stockLength - classes->totalLength;
+                recordCutlistImprovement(&progress, progress.nodeCount, best_stocks, (waste < INT_MAX) ? (int)waste : INT_MAX, 0);
+                CUTLIST_TRACE(input->traceLevel, CUTLIST_TRACE_SUMMARY, "New Best Found: Stock Used = %d in %d patterns\n\n", best_stocks, best.patternCount);
+            }
+            else
+            {
+                freePatternList(&rounded);
+            }
+        }
+    }
+
+    int emitted = emitDemandPatterns(classes, &best, input, result);
+    freePatternList(&best);
+    if (emitted != 0)
+    {
+        return failDemandSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+    }
+
+    int proven_optimal = (best_stocks <= lower_bound);
+    long long cost = (long long)best_stocks * input->stockLength;
+    result->status = CUTLIST_STATUS_OK;
+    result->stockUsed = best_stocks;
+    result->waste = waste;
+    result->cost = cost;
+    result->stockLowerBound = lower_bound;
+    result->provenOptimal = proven_optimal;
+    result->optimalityGap = (!proven_optimal && (cost > 0)) ? ((double)(cost - (long long)lower_bound * input->stockLength) / cost) : 0.0;
+    result->stopReason = stop_reason;
+
+    result->stats = progress.stats;
+    result->stats.nodesExpanded = progress.nodeCount;
+    result->stats.secondsToFirstSolution = result->stats.improvements[0].seconds;
+    result->stats.totalSeconds = getCutlistWallSeconds() - start_time;
+    result->stats.secondsToOptimum = proven_optimal ? result->stats.totalSeconds : -1.0;
+    result->stats.memoryBytes += ((size_t)result->patternCount * sizeof(CutlistPattern) + (size_t)result->cutCount * sizeof(CutlistPatternCut));
+    return 0;
+}
+
+int solveCutlistDemand(CutlistSolver *solver, CutlistDemandInput input, CutlistDemandResult *result)
+{
+    resetCutlistStats(&result->stats);
+    result->stopReason = CUTLIST_STOP_COMPLETED;
+
+    // The same checks as solveCutlist's, on the demands' pieces
+    long long capacity = (long long)input.stockLength - input.trimLength + input.kerfWidth;
+    long long total_pieces = 0;
+    int invalid = (input.demandCount < 0) || ((input.demandCount > 0) && !input.demands) || (input.kerfWidth < 0) ||
+                  (input.trimLength < 0) || (input.stockLength <= input.trimLength) || (capacity > INT_MAX);
+    for (int demand_index = 0; !invalid && (demand_index < input.demandCount); demand_index++)
+    {
+        invalid = (input.demands[demand_index].quantity < 0);
+        total_pieces += input.demands[demand_index].quantity;
+    }
+    if (invalid || (total_pieces > INT_MAX))
+    {
+        CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nInvalid demand, stock length, kerf or trim!\n\n");
+        return failDemandSolve(result, CUTLIST_STATUS_INVALID_INPUT);
+    }
+    for (int demand_index = 0; demand_index < input.demandCount; demand_index++)
+    {
+        const CutlistDemand *demand = &input.demands[demand_index];
+        if (demand->quantity == 0)
+        {
+            continue;
+        }
+        if ((long long)demand->length + input.kerfWidth > capacity)
+        {
+            CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nRequested piece is longer than stock length!\n\n");
+            return failDemandSolve(result, CUTLIST_STATUS_PIECE_TOO_LONG);
+        }
+        if (demand->length < 0)
+        {
+            CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nRequested piece has a negative length!\n\n");
+            return failDemandSolve(result, CUTLIST_STATUS_NEGATIVE_PIECE);
+        }
+    }
+
+    DemandClasses classes;
+    if (buildDemandClasses(&input, (int)capacity, &classes) != 0)
+    {
+        return failDemandSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+    }
+
+    // A small order gets every engine of the piece-by-piece solve, on the same stocks it would use
+    int status = 0;
+    if (classes.totalPieces <= CUTLIST_DEMAND_EXPAND_MAX_PIECES)
+    {
+        PatternList list = {0};
+        CutlistResult piece_result;
+        memset(&piece_result, 0, sizeof(piece_result));
+        if ((solveClassPieces(solver, &input, &classes, classes.classCounts, input.options, &list, &piece_result) < 0) ||
+            (emitDemandPatterns(&classes, &list, &input, result) != 0))
+        {
+            status = failDemandSolve(result, (piece_result.status != CUTLIST_STATUS_OK) ? piece_result.status : CUTLIST_STATUS_OUT_OF_MEMORY);
+        }
+        else
+        {
+            result->status = CUTLIST_STATUS_OK;
+            result->stockUsed = piece_result.stockUsed;
+            result->waste = piece_result.waste;
+            result->cost = piece_result.cost;
+            result->stockLowerBound = piece_result.stockLowerBound;
+            result->provenOptimal = piece_result.provenOptimal;
+            result->optimalityGap = piece_result.optimalityGap;
+            result->stopReason = piece_result.stopReason;
+        }
+        result->stats = piece_result.stats;
+        freePatternList(&list);
+    }
+    else
+    {
+        status = solveDemandByPatterns(solver, &input, &classes, result);
+    }
+
+    freeDemandClasses(&classes);
+    return status;
+}
+
+// Convenience wrapper for a one-off solve
+void optimizeCutlistDemand(CutlistDemandInput input, CutlistDemandResult *result)
+{
+    CutlistSolver *solver = createCutlistSolver(0);
+    if (!solver)
+    {
+        resetCutlistStats(&result->stats);
+        result->stopReason = CUTLIST_STOP_COMPLETED;
+        failDemandSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+        return;
+    }
+
+    solveCutlistDemand(solver, input, result);
+    destroyCutlistSolver(solver);
+}
+
+int expandCutlistDemand(const CutlistDemand *demands, int demandCount, int *pieces)
+{
+    int piece_count = 0;
+    for (int demand_index = 0; demand_index < demandCount; demand_index++)
+    {
+        for (int count = 0; count < demands[demand_index].quantity; count++)
+        {
+            pieces[piece_count++] = demands[demand_index].length;
+        }
+    }
+    return piece_count;
+}
+
+int expandCutlistPatterns(const CutlistDemand *demands, int demandCount, const CutlistDemandResult *result, int *assignments)
+{
+    // Where the next piece of every demand goes in assignments
+    int *next_piece = (int *)malloc(((size_t)demandCount + 1) * sizeof(int));
+    if (!next_piece)
+    {
+        return -1;
+    }
+    int piece_count = 0;
+    for (int demand_index = 0; demand_index < demandCount; demand_index++)
+    {
+        next_piece[demand_index] = piece_count;
+        piece_count += (demands[demand_index].quantity > 0) ? demands[demand_index].quantity : 0;
+    }
+
+    int stock_index = 0;
+    for (int pattern_index = 0; pattern_index < result->patternCount; pattern_index++)
+    {
+        const CutlistPattern *pattern = &result->patterns[pattern_index];
+        for (int copy = 0; copy < pattern->repeat; copy++, stock_index++)
+        {
+            for (int cut_index = pattern->firstCut; cut_index < pattern->firstCut + pattern->cutCount; cut_index++)
+            {
+                const CutlistPatternCut *cut = &result->cuts[cut_index];
+                for (int count = 0; count < cut->quantity; count++)
+                {
+                    assignments[next_piece[cut->demandIndex]++] = stock_index;
+                }
+            }
+        }
+    }
+
+    free(next_piece);
+    return 0;
+}
@@ -0,0 +1,423 @@
+#include "cutlistFormat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Output staged on the stack and handed to the sink a chunk at a time, so a FILE sink sees few large writes and the
+// other sinks copy in large runs
+typedef struct {
+    CutlistSink *sink;
+    size_t used;
+    char chunk[CUTLIST_FORMAT_CHUNK_SIZE];
+} SheetWriter;
+
+void initCutlistFileSink(CutlistSink *sink, FILE *file)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->kind = CUTLIST_SINK_FILE;
+    sink->file = file;
+}
+
+void initCutlistBufferSink(CutlistSink *sink, char *buffer, size_t capacity)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->kind = CUTLIST_SINK_BUFFER;
+    sink->buffer = buffer;
+    sink->capacity = capacity;
+    if (capacity > 0)
+    {
+        buffer[0] = '\0';
+    }
+}
+
+void initCutlistGrowableSink(CutlistSink *sink)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->kind = CUTLIST_SINK_GROWABLE;
+}
+
+// Frees the buffer of a growable sink and leaves it empty, ready for reuse. Other sinks own nothing
+void freeCutlistSink(CutlistSink *sink)
+{
+    if (sink->kind == CUTLIST_SINK_GROWABLE)
+    {
+        free(sink->buffer);
+        sink->buffer = NULL;
+        sink->capacity = 0;
+        sink->length = 0;
+        sink->error = CUTLIST_SINK_OK;
+    }
+}
+
+CutlistSinkError appendToCutlistSink(CutlistSink *sink, const char *data, size_t length)
+{
+    switch (sink->kind)
+    {
+    case CUTLIST_SINK_FILE:
+        if ((sink->error == CUTLIST_SINK_OK) && (fwrite(data, 1, length, sink->file) != length))
+        {
+            sink->error = CUTLIST_SINK_WRITE_FAILED;
+        }
+        if (sink->error == CUTLIST_SINK_OK)
+        {
+            sink->length += length;
+        }
+        break;
+
+    case CUTLIST_SINK_BUFFER:
+    {
+        // Keep counting past the end, like snprintf, so the caller learns the size to retry with
+        size_t stored = (sink->length < sink->capacity) ? sink->length : sink->capacity;
+        size_t room = (sink->capacity > stored + 1) ? (sink->capacity - stored - 1) : 0;
+        size_t copied = (length < room) ? length : room;
+        // A sink of capacity 0 only sizes the output, and may have no buffer at all
+        if (sink->capacity > 0)
+        {
+            memcpy(sink->buffer + stored, data, copied);
+            sink->buffer[stored + copied] = '\0';
+        }
+        if ((copied < length) && (sink->error == CUTLIST_SINK_OK))
+        {
+            sink->error = CUTLIST_SINK_TRUNCATED;
+        }
+        sink->length += length;
+        break;
+    }
+
+    case CUTLIST_SINK_GROWABLE:
+        if (sink->error != CUTLIST_SINK_OK)
+        {
+            break;
+        }
+        if (sink->length + length + 1 > sink->capacity)
+        {
+            // Doubling keeps appends amortized O(1) however the output is split
+            size_t capacity = (sink->capacity > 0) ? sink->capacity : CUTLIST_FORMAT_CHUNK_SIZE;
+            while (sink->length + length + 1 > capacity)
+            {
+                capacity *= 2;
+            }
+            char *buffer = (char *)realloc(sink->buffer, capacity);
+            if (!buffer)
+            {
+                sink->error = CUTLIST_SINK_OUT_OF_MEMORY;
+                break;
+            }
+            sink->buffer = buffer;
+            sink->capacity = capacity;
+        }
+        memcpy(sink->buffer + sink->length, data, length);
+        sink->length += length;
+        sink->buffer[sink->length] = '\0';
+        break;
+    }
+
+    return sink->error;
+}
+
+static void flushSheetWriter(SheetWriter *writer)
+{
+    if (writer->used > 0)
+    {
+        appendToCutlistSink(writer->sink, writer->chunk, writer->used);
+        writer->used = 0;
+    }
+}
+
+static void writeSheetText(SheetWriter *writer, const char *text)
+{
+    size_t length = strlen(text);
+    if (writer->used + length > sizeof(writer->chunk))
+    {
+        flushSheetWriter(writer);
+        if (length > sizeof(writer->chunk))
+        {
+            appendToCutlistSink(writer->sink, text, length);
+            return;
+        }
+    }
+    memcpy(writer->chunk + writer->used, text, length);
+    writer->used += length;
+}
+
+// Writes the decimal digits of value, without going through printf for every number of a large sheet
+static void writeSheetInt(SheetWriter *writer, int value)
+{
+    char digits[16];
+    int digit_count = 0;
+    // Negated as unsigned so INT_MIN has a magnitude too
+    unsigned int magnitude = (value < 0) ? (0u - (unsigned int)value) : (unsigned int)value;
+    do
+    {
+        digits[sizeof(digits) - 1 - digit_count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0)
+    {
+        digits[sizeof(digits) - 1 - digit_count++] = '-';
+    }
+
+    if (writer->used + (size_t)digit_count > sizeof(writer->chunk))
+    {
+        flushSheetWriter(writer);
+    }
+    memcpy(writer->chunk + writer->used, &digits[sizeof(digits) - digit_count], (size_t)digit_count);
+    writer->used += (size_t)digit_count;
+}
+
+CutlistSinkError writeCutlistAssignments(CutlistSink *sink, CutlistFormat format, const int *pieceSizes,
+                                         const int *assignments, int pieceCount, int stockCount)
+{
+    if (pieceCount < 0)
+    {
+        pieceCount = 0;
+    }
+    if (stockCount < 0)
+    {
+        stockCount = 0;
+    }
+
+    // Counting sort of the pieces by stock: stock_start[s] is where stock s's pieces begin in pieces_by_stock, and the
+    // pieces of a stock stay in ascending index because they are dealt out in that order
+    int *stock_start = (int *)malloc(((size_t)stockCount + 1 + (size_t)pieceCount) * sizeof(int));
+    if (!stock_start)
+    {
+        if (sink->error == CUTLIST_SINK_OK)
+        {
+            sink->error = CUTLIST_SINK_OUT_OF_MEMORY;
+        }
+        return sink->error;
+    }
+    int *pieces_by_stock = stock_start + stockCount + 1;
+
+    memset(stock_start, 0, ((size_t)stockCount + 1) * sizeof(int));
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        int stock_index = assignments[piece_index];
+        if ((stock_index >= 0) && (stock_index < stockCount))
+        {
+            stock_start[stock_index + 1]++;
+        }
+    }
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        stock_start[stock_index + 1] += stock_start[stock_index];
+    }
+    // Deal out by advancing each stock's start, which then holds where the next stock begins
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        int stock_index = assignments[piece_index];
+        if ((stock_index >= 0) && (stock_index < stockCount))
+        {
+            pieces_by_stock[stock_start[stock_index]++] = piece_index;
+        }
+    }
+
+    SheetWriter sheet_writer;
+    SheetWriter *writer = &sheet_writer;
+    writer->sink = sink;
+    writer->used = 0;
+
+    if (format == CUTLIST_FORMAT_CSV)
+    {
+        writeSheetText(writer, "stock,piece,length\n");
+    }
+    else if (format == CUTLIST_FORMAT_JSON)
+    {
+        writeSheetText(writer, "{\"stockCount\":");
+        writeSheetInt(writer, stockCount);
+        writeSheetText(writer, ",\"stocks\":[");
+    }
+    else
+    {
+        writeSheetText(writer, "Stock assignments:\n");
+    }
+
+    int first_piece = 0;
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        // After the deal stock_start[s] is the end of stock s, so it runs from the previous stock's end
+        int end_piece = stock_start[stock_index];
+
+        if (format == CUTLIST_FORMAT_JSON)
+        {
+            writeSheetText(writer, (stock_index > 0) ? ",{\"stock\":" : "{\"stock\":");
+            writeSheetInt(writer, stock_index);
+            writeSheetText(writer, ",\"pieces\":[");
+        }
+        else if (format == CUTLIST_FORMAT_TEXT)
+        {
+            writeSheetText(writer, "Stock #");
+            writeSheetInt(writer, stock_index + 1);
+            writeSheetText(writer, ": ");
+        }
+
+        for (int slot = first_piece; slot < end_piece; slot++)
+        {
+            int piece_index = pieces_by_stock[slot];
+            if (format == CUTLIST_FORMAT_CSV)
+            {
+                writeSheetInt(writer, stock_index);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, piece_index);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, pieceSizes[piece_index]);
+                writeSheetText(writer, "\n");
+            }
+            else if (format == CUTLIST_FORMAT_JSON)
+            {
+                writeSheetText(writer, (slot > first_piece) ? ",{\"piece\":" : "{\"piece\":");
+                writeSheetInt(writer, piece_index);
+                writeSheetText(writer, ",\"length\":");
+                writeSheetInt(writer, pieceSizes[piece_index]);
+                writeSheetText(writer, "}");
+            }
+            else
+            {
+                if (slot > first_piece)
+                {
+                    writeSheetText(writer, ", ");
+                }
+                writeSheetInt(writer, pieceSizes[piece_index]);
+            }
+        }
+
+        if (format == CUTLIST_FORMAT_JSON)
+        {
+            writeSheetText(writer, "]}");
+        }
+        else if (format == CUTLIST_FORMAT_TEXT)
+        {
+            writeSheetText(writer, "\n");
+        }
+        first_piece = end_piece;
+    }
+
+    if (format == CUTLIST_FORMAT_JSON)
+    {
+        writeSheetText(writer, "]}\n");
+    }
+    else if (format == CUTLIST_FORMAT_TEXT)
+    {
+        writeSheetText(writer, "\n");
+    }
+    flushSheetWriter(writer);
+
+    free(stock_start);
+    return sink->error;
+}
+
+CutlistSinkError writeCutlistResult(CutlistSink *sink, CutlistFormat format, const CutlistInput *input,
+                                    const CutlistResult *result)
+{
+    // A failed solve has no packing, so its sheet lists no stocks
+    if (result->status != CUTLIST_STATUS_OK)
+    {
+        return writeCutlistAssignments(sink, format, NULL, NULL, 0, 0);
+    }
+    return writeCutlistAssignments(sink, format, input->requiredPieces, result->assignments, input->pieceCount, result->stockUsed);
+}
+
+CutlistSinkError writeCutlistPatterns(CutlistSink *sink, CutlistFormat format, const CutlistDemandInput *input,
+                                      const CutlistDemandResult *result)
+{
+    SheetWriter sheet_writer;
+    SheetWriter *writer = &sheet_writer;
+    writer->sink = sink;
+    writer->used = 0;
+
+    // A failed solve has no packing, so its sheet lists no patterns
+    int ok = (result->status == CUTLIST_STATUS_OK);
+    int pattern_count = ok ? result->patternCount : 0;
+    if (format == CUTLIST_FORMAT_CSV)
+    {
+        writeSheetText(writer, "pattern,stocks,demand,length,quantity\n");
+    }
+    else if (format == CUTLIST_FORMAT_JSON)
+    {
+        writeSheetText(writer, "{\"stockCount\":");
+        writeSheetInt(writer, ok ? result->stockUsed : 0);
+        writeSheetText(writer, ",\"patterns\":[");
+    }
+    else
+    {
+        writeSheetText(writer, "Cutting patterns:\n");
+    }
+
+    for (int pattern_index = 0; pattern_index < pattern_count; pattern_index++)
+    {
+        const CutlistPattern *pattern = &result->patterns[pattern_index];
+        if (format == CUTLIST_FORMAT_JSON)
+        {
+            writeSheetText(writer, (pattern_index > 0) ? ",{\"pattern\":" : "{\"pattern\":");
+            writeSheetInt(writer, pattern_index);
+            writeSheetText(writer, ",\"stocks\":");
+            writeSheetInt(writer, pattern->repeat);
+            writeSheetText(writer, ",\"cuts\":[");
+        }
+        else if (format == CUTLIST_FORMAT_TEXT)
+        {
+            writeSheetInt(writer, pattern->repeat);
+            writeSheetText(writer, " x Stock: ");
+        }
+
+        for (int cut_index = 0; cut_index < pattern->cutCount; cut_index++)
+        {
+            const CutlistPatternCut *cut = &result->cuts[pattern->firstCut + cut_index];
+            int length = input->demands[cut->demandIndex].length;
+            if (format == CUTLIST_FORMAT_CSV)
+            {
+                writeSheetInt(writer, pattern_index);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, pattern->repeat);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, cut->demandIndex);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, length);
+                writeSheetText(writer, ",");
+                writeSheetInt(writer, cut->quantity);
+                writeSheetText(writer, "\n");
+            }
+            else if (format == CUTLIST_FORMAT_JSON)
+            {
+                writeSheetText(writer, (cut_index > 0) ? ",{\"demand\":" : "{\"demand\":");
+                writeSheetInt(writer, cut->demandIndex);
+                writeSheetText(writer, ",\"length\":");
+                writeSheetInt(writer, length);
+                writeSheetText(writer, ",\"quantity\":");
+                writeSheetInt(writer, cut->quantity);
+                writeSheetText(writer, "}");
+            }
+            else
+            {
+                if (cut_index > 0)
+                {
+                    writeSheetText(writer, ", ");
+                }
+                writeSheetInt(writer, length);
+                writeSheetText(writer, " x ");
+                writeSheetInt(writer, cut->quantity);
+            }
+        }
+
+        if (format == CUTLIST_FORMAT_JSON)
+        {
+            writeSheetText(writer, "]}");
+        }
+        else if (format == CUTLIST_FORMAT_TEXT)
+        {
+            writeSheetText(writer, "\n");
+        }
+    }
+
+    if (format == CUTLIST_FORMAT_JSON)
+    {
+        writeSheetText(writer, "]}\n");
+    }
+    else if (format == CUTLIST_FORMAT_TEXT)
+    {
+        writeSheetText(writer, "\n");
+    }
+    flushSheetWriter(writer);
+    return sink->error;
+}
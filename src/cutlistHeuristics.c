@@ -0,0 +1,305 @@
+#include "cutlistHeuristics.h"
+#include "cutlistKernels.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Number of leaves in a segment tree covering count slots, rounded up to a power of two
+static size_t getTreeLeafCount(int count)
+{
+    size_t leaf_count = 1;
+    while (leaf_count < (size_t)count)
+    {
+        leaf_count *= 2;
+    }
+    return leaf_count;
+}
+
+size_t getHeuristicScratchSize(int pieceCount)
+{
+    // First fit: max tree over stock indices. Best fit: a treap node of five ints per stock. Both run from the same
+    // scratch, so the larger of the two is needed. Neither depends on the stock length
+    size_t first_fit_size = 2 * getTreeLeafCount(pieceCount);
+    size_t best_fit_size = 5 * (size_t)pieceCount;
+    return (first_fit_size > best_fit_size) ? first_fit_size : best_fit_size;
+}
+
+// First-Fit-Decreasing: every piece goes into the lowest-numbered stock with room for it. A max tree over the
+// remaining space of every stock finds that stock in O(log n); stocks not opened yet count as a full stock length
+int packFirstFitDecreasing(const int *sortedPieces, int pieceCount, int stockLength, int *assignments, int *scratch)
+{
+    size_t leaf_count = getTreeLeafCount(pieceCount);
+    int *max_space = scratch; // Node i covers children 2i and 2i+1, leaves start at leaf_count
+
+    for (size_t node = 1; node < 2 * leaf_count; node++)
+    {
+        max_space[node] = stockLength;
+    }
+
+    int stock_count = 0;
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        int piece_size = sortedPieces[piece_index];
+
+        // Walk down to the leftmost stock with room; there is always one, since no piece is longer than a stock
+        size_t node = 1;
+        while (node < leaf_count)
+        {
+            node = (max_space[2 * node] >= piece_size) ? (2 * node) : (2 * node + 1);
+        }
+
+        int stock_index = (int)(node - leaf_count);
+        assignments[piece_index] = stock_index;
+        if (stock_index == stock_count)
+        {
+            stock_count++;
+        }
+
+        // Update the leaf and every maximum above it
+        max_space[node] -= piece_size;
+        for (node /= 2; node >= 1; node /= 2)
+        {
+            int left = max_space[2 * node];
+            int right = max_space[2 * node + 1];
+            max_space[node] = (left > right) ? left : right;
+        }
+    }
+
+    return stock_count;
+}
+
+// Open stocks of the best fit, as a treap ordered by remaining space, and among equal spaces by when they were last
+// filled, latest first. Node i is stock i; priorities are fixed by the stock index, so the shape, and with it every
+// packing, is the same on every run
+typedef struct {
+    int *left;
+    int *right;
+    int *priority;
+    int *space;
+    int *filledAt;
+} OpenStockTreap;
+
+// Returns 1 if stock first comes before stock second
+static int isBeforeInTreap(const OpenStockTreap *treap, int first, int second)
+{
+    return (treap->space[first] < treap->space[second]) ||
+           ((treap->space[first] == treap->space[second]) && (treap->filledAt[first] > treap->filledAt[second]));
+}
+
+// Joins two treaps, every stock of first before every stock of second
+static int mergeOpenStocks(OpenStockTreap *treap, int first, int second)
+{
+    int root = -1;
+    int *slot = &root;
+    while ((first >= 0) && (second >= 0))
+    {
+        if (treap->priority[first] > treap->priority[second])
+        {
+            *slot = first;
+            slot = &treap->right[first];
+            first = treap->right[first];
+        }
+        else
+        {
+            *slot = second;
+            slot = &treap->left[second];
+            second = treap->left[second];
+        }
+    }
+    *slot = (first >= 0) ? first : second;
+    return root;
+}
+
+// Adds a stock whose space and filledAt are set, going down only as far as its priority allows
+static void insertOpenStock(OpenStockTreap *treap, int *root, int stock)
+{
+    int *slot = root;
+    while ((*slot >= 0) && (treap->priority[*slot] > treap->priority[stock]))
+    {
+        slot = isBeforeInTreap(treap, stock, *slot) ? &treap->left[*slot] : &treap->right[*slot];
+    }
+
+    // Split what hangs below into the stock's two children
+    int rest = *slot;
+    int *left_slot = &treap->left[stock];
+    int *right_slot = &treap->right[stock];
+    while (rest >= 0)
+    {
+        if (isBeforeInTreap(treap, rest, stock))
+        {
+            *left_slot = rest;
+            left_slot = &treap->right[rest];
+            rest = treap->right[rest];
+        }
+        else
+        {
+            *right_slot = rest;
+            right_slot = &treap->left[rest];
+            rest = treap->left[rest];
+        }
+    }
+    *left_slot = -1;
+    *right_slot = -1;
+    *slot = stock;
+}
+
+// Takes out the first stock with at least minimumSpace left and returns it, or -1 if no open stock has that much
+static int takeBestFitStock(OpenStockTreap *treap, int *root, int minimumSpace)
+{
+    int *best_slot = NULL;
+    int *slot = root;
+    while (*slot >= 0)
+    {
+        if (treap->space[*slot] >= minimumSpace)
+        {
+            best_slot = slot;
+            slot = &treap->left[*slot];
+        }
+        else
+        {
+            slot = &treap->right[*slot];
+        }
+    }
+    if (!best_slot)
+    {
+        return -1;
+    }
+
+    int stock = *best_slot;
+    *best_slot = mergeOpenStocks(treap, treap->left[stock], treap->right[stock]);
+    return stock;
+}
+
+// Best-Fit-Decreasing: every piece goes into the open stock it leaves the least space on, or a new stock if none has
+// room. A treap of the open stocks by remaining space finds that stock in O(log stocks), from scratch that grows with
+// the stocks, not the stock length. Ties go to the most recently filled stock
+int packBestFitDecreasing(const int *sortedPieces, int pieceCount, int stockLength, int *assignments, int *scratch)
+{
+    OpenStockTreap treap;
+    treap.left = scratch;
+    treap.right = &scratch[pieceCount];
+    treap.priority = &scratch[2 * (size_t)pieceCount];
+    treap.space = &scratch[3 * (size_t)pieceCount];
+    treap.filledAt = &scratch[4 * (size_t)pieceCount];
+    int root = -1;
+
+    int stock_count = 0;
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        int piece_size = sortedPieces[piece_index];
+        int stock_index = takeBestFitStock(&treap, &root, piece_size);
+        if (stock_index < 0)
+        {
+            // Nothing open has room, start a new stock. Its priority is a fixed mix of its index
+            stock_index = stock_count++;
+            uint32_t mixed = (uint32_t)stock_index * 0x9E3779B9u;
+            mixed = (mixed ^ (mixed >> 16)) * 0x85EBCA6Bu;
+            treap.priority[stock_index] = (int)((mixed ^ (mixed >> 13)) & 0x7FFFFFFF);
+            treap.space[stock_index] = stockLength;
+        }
+
+        // Put it back for its new remaining space
+        treap.space[stock_index] -= piece_size;
+        treap.filledAt[stock_index] = piece_index;
+        insertOpenStock(&treap, &root, stock_index);
+
+        assignments[piece_index] = stock_index;
+    }
+
+    return stock_count;
+}
+
+// Kind of stock still on hand, fitting pieceSize, with the lowest cost per unit length. Ties go to the longer kind,
+// which leaves more room for the pieces that follow. Returns -1 if no kind fits
+static int chooseCatalogueStock(const int *typeLengths, const int *typeCosts, const int *typeOnHand, int typeCount, int pieceSize)
+{
+    int best_type = -1;
+    for (int type_index = 0; (type_index < typeCount) && (typeLengths[type_index] >= pieceSize); type_index++)
+    {
+        if ((typeOnHand[type_index] > 0) &&
+            ((best_type < 0) ||
+             ((long long)typeCosts[type_index] * typeLengths[best_type] < (long long)typeCosts[best_type] * typeLengths[type_index])))
+        {
+            best_type = type_index;
+        }
+    }
+    return best_type;
+}
+
+int packCatalogueDecreasing(const int *sortedPieces, int pieceCount, const int *typeLengths, const int *typeCosts,
+                            const int *typeOnHand, int typeCount, int bestFit, int *assignments, int *stockTypes, int *scratch)
+{
+    int *remaining_space = scratch;
+    int *on_hand = &scratch[pieceCount];
+    memcpy(on_hand, typeOnHand, (size_t)typeCount * sizeof(int));
+
+    int stock_count = 0;
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        int piece_size = sortedPieces[piece_index];
+        int stock_index = -1;
+
+        if (bestFit)
+        {
+            for (int candidate = 0; candidate < stock_count; candidate++)
+            {
+                if ((remaining_space[candidate] >= piece_size) &&
+                    ((stock_index < 0) || (remaining_space[candidate] < remaining_space[stock_index])))
+                {
+                    stock_index = candidate;
+                }
+            }
+        }
+        else
+        {
+            for (int block_start = 0; (stock_index < 0) && (block_start < stock_count); block_start += CUTLIST_STOCK_MASK_WIDTH)
+            {
+                uint64_t fitting_stocks = getFittingStockMask(remaining_space, block_start, stock_count, piece_size);
+                if (fitting_stocks != 0)
+                {
+                    stock_index = block_start + getLowestSetBit(fitting_stocks);
+                }
+            }
+        }
+
+        // Nothing open has room, start a new stock
+        if (stock_index < 0)
+        {
+            int type_index = chooseCatalogueStock(typeLengths, typeCosts, on_hand, typeCount, piece_size);
+            if (type_index < 0)
+            {
+                return -1;
+            }
+
+            on_hand[type_index]--;
+            stock_index = stock_count++;
+            stockTypes[stock_index] = type_index;
+            remaining_space[stock_index] = typeLengths[type_index];
+        }
+
+        remaining_space[stock_index] -= piece_size;
+        assignments[piece_index] = stock_index;
+    }
+
+    // Stocks were picked for their first piece, so a cheaper kind may still hold everything cut from one
+    for (int stock_index = 0; stock_index < stock_count; stock_index++)
+    {
+        int type_index = stockTypes[stock_index];
+        int used_length = typeLengths[type_index] - remaining_space[stock_index];
+        on_hand[type_index]++;
+
+        for (int candidate = 0; (candidate < typeCount) && (typeLengths[candidate] >= used_length); candidate++)
+        {
+            if ((on_hand[candidate] > 0) && (typeCosts[candidate] < typeCosts[type_index]))
+            {
+                type_index = candidate;
+            }
+        }
+
+        on_hand[type_index]--;
+        stockTypes[stock_index] = type_index;
+        remaining_space[stock_index] = typeLengths[type_index] - used_length;
+    }
+
+    return stock_count;
+}
@@ -0,0 +1,190 @@
+#include "cutlistIncremental.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The previous packing does not fit the changed order, so it is solved from scratch
+#define CUTLIST_REPAIR_FAILED -1
+// The change names pieces the previous order does not have
+#define CUTLIST_REPAIR_INVALID -2
+
+// Fails a change that does not fit the previous order, leaving nothing to repair or solve
+static int failReoptimize(CutlistResult *result)
+{
+    resetCutlistStats(&result->stats);
+    result->stopReason = CUTLIST_STOP_COMPLETED;
+    result->status = CUTLIST_STATUS_INVALID_INPUT;
+    result->stockUsed = -1;
+    result->waste = -1;
+    return -1;
+}
+
+static int compareAddedPieceKeys(const void *first, const void *second)
+{
+    long long first_key = *(const long long *)first;
+    long long second_key = *(const long long *)second;
+    return (first_key > second_key) - (first_key < second_key);
+}
+
+// Repairs the previous packing for the changed order, writing each piece's stock into assignments. Returns the stock
+// count with lowerBound set, CUTLIST_REPAIR_FAILED if a kept piece no longer fits its stock or an added piece fits no
+// stock, or CUTLIST_REPAIR_INVALID
+static int repairPacking(const CutlistInput *input, const CutlistResult *previous, const CutlistOrderChange *change,
+                         int stockCapacity, int *assignments, void *scratch, int *lowerBound)
+{
+    int previous_count = input->pieceCount - change->addedCount + change->removedCount;
+    int previous_stock_count = previous->stockUsed;
+    long long *added_keys = (long long *)scratch;
+    int *stock_load = (int *)&added_keys[change->addedCount]; // By previous stock, then by repaired stock
+    int *stock_number = &stock_load[previous_stock_count + change->addedCount];
+    int *held_removed = &stock_number[previous_stock_count];
+    int *removed_mark = &held_removed[previous_stock_count];
+
+    memset(stock_load, 0, (size_t)previous_stock_count * sizeof(int));
+    memset(stock_number, 0, (size_t)previous_stock_count * sizeof(int));
+    memset(held_removed, 0, (size_t)previous_stock_count * sizeof(int));
+    memset(removed_mark, 0, (size_t)previous_count * sizeof(int));
+    for (int removed_index = 0; removed_index < change->removedCount; removed_index++)
+    {
+        int piece_index = change->removedPieces[removed_index];
+        if ((piece_index < 0) || (piece_index >= previous_count) || removed_mark[piece_index])
+        {
+            return CUTLIST_REPAIR_INVALID;
+        }
+        removed_mark[piece_index] = 1;
+    }
+
+    // Kept pieces move down to their index in the changed order, never past their previous one, so previous's
+    // assignments can be rewritten in place
+    int kept_count = 0;
+    for (int piece_index = 0; piece_index < previous_count; piece_index++)
+    {
+        int stock_index = previous->assignments[piece_index];
+        if ((stock_index < 0) || (stock_index >= previous_stock_count))
+        {
+            return CUTLIST_REPAIR_FAILED;
+        }
+        if (removed_mark[piece_index])
+        {
+            held_removed[stock_index] = 1;
+            continue;
+        }
+
+        long long piece_size = (long long)input->requiredPieces[kept_count] + input->kerfWidth;
+        if ((input->requiredPieces[kept_count] < 0) || (stock_load[stock_index] + piece_size > stockCapacity))
+        {
+            return CUTLIST_REPAIR_FAILED;
+        }
+        stock_load[stock_index] += (int)piece_size;
+        stock_number[stock_index]++;
+        assignments[kept_count++] = stock_index;
+    }
+
+    // Drop the stocks left without pieces, keeping the others in their order. A stock of zero-length pieces has no load
+    // but is kept, so stock_number counts each stock's kept pieces until it is renumbered. The removed pieces fit on the
+    // stocks that held them, so the previous bound less those stocks still holds
+    int stock_count = 0;
+    int held_removed_count = 0;
+    for (int stock_index = 0; stock_index < previous_stock_count; stock_index++)
+    {
+        held_removed_count += held_removed[stock_index];
+        if (stock_number[stock_index] > 0)
+        {
+            stock_number[stock_index] = stock_count;
+            stock_load[stock_count++] = stock_load[stock_index];
+        }
+    }
+    for (int piece_index = 0; piece_index < kept_count; piece_index++)
+    {
+        assignments[piece_index] = stock_number[assignments[piece_index]];
+    }
+    int previous_bound = previous->provenOptimal ? previous->stockUsed : previous->stockLowerBound;
+    *lowerBound = (previous_bound > held_removed_count) ? (previous_bound - held_removed_count) : 0;
+
+    // Added pieces longest first, ties by index, each onto the stock it leaves the least space on. The scan over the
+    // stocks is the cost of the repair, and grows with the change rather than with a search
+    for (int added_index = 0; added_index < change->addedCount; added_index++)
+    {
+        long long piece_size = (long long)input->requiredPieces[kept_count + added_index] + input->kerfWidth;
+        if ((input->requiredPieces[kept_count + added_index] < 0) || (piece_size > stockCapacity))
+        {
+            return CUTLIST_REPAIR_FAILED;
+        }
+        added_keys[added_index] = ((long long)(INT_MAX - (int)piece_size) << 32) | added_index;
+    }
+    qsort(added_keys, (size_t)change->addedCount, sizeof(long long), compareAddedPieceKeys);
+
+    for (int key_index = 0; key_index < change->addedCount; key_index++)
+    {
+        int piece_index = kept_count + (int)(added_keys[key_index] & 0xFFFFFFFF);
+        int piece_size = input->requiredPieces[piece_index] + input->kerfWidth;
+        int best_stock = stock_count;
+        int best_space = INT_MAX;
+        for (int stock_index = 0; stock_index < stock_count; stock_index++)
+        {
+            int space = stockCapacity - stock_load[stock_index];
+            if ((space >= piece_size) && (space < best_space))
+            {
+                best_stock = stock_index;
+                best_space = space;
+            }
+        }
+
+        if (best_stock == stock_count)
+        {
+            stock_load[stock_count++] = 0;
+        }
+        stock_load[best_stock] += piece_size;
+        assignments[piece_index] = best_stock;
+    }
+
+    return stock_count;
+}
+
+int reoptimizeCutlist(CutlistSolver *solver, CutlistInput input, const CutlistResult *previous,
+                      const CutlistOrderChange *change, CutlistResult *result)
+{
+    // Anything the repair cannot start from is solved from scratch, which also reports an input it cannot cut
+    long long stock_capacity = (long long)input.stockLength - input.trimLength + input.kerfWidth;
+    if (!previous || !change || (previous->status != CUTLIST_STATUS_OK) || (input.stockTypeCount > 0) ||
+        (input.pieceCount < 0) || ((input.pieceCount > 0) && !input.requiredPieces) || (input.kerfWidth < 0) ||
+        (input.trimLength < 0) || (input.stockLength <= input.trimLength) || (stock_capacity > INT_MAX))
+    {
+        return solveCutlist(solver, input, result);
+    }
+
+    if ((change->removedCount < 0) || (change->addedCount < 0) || (change->addedCount > input.pieceCount) ||
+        ((change->removedCount > 0) && !change->removedPieces))
+    {
+        return failReoptimize(result);
+    }
+
+    int previous_count = input.pieceCount - change->addedCount + change->removedCount;
+    if ((previous->stockUsed < 0) || ((previous_count > 0) && !previous->assignments))
+    {
+        return solveCutlist(solver, input, result);
+    }
+
+    size_t scratch_size = (size_t)change->addedCount * sizeof(long long) +
+                          ((size_t)3 * previous->stockUsed + change->addedCount + previous_count) * sizeof(int);
+    void *scratch = malloc(scratch_size > 0 ? scratch_size : 1);
+    if (!scratch)
+    {
+        return solveCutlist(solver, input, result);
+    }
+
+    CutlistSeedPacking seed = {result->assignments, 0, 0};
+    seed.stockCount = repairPacking(&input, previous, change, (int)stock_capacity, result->assignments, scratch, &seed.stockLowerBound);
+    free(scratch);
+
+    if (seed.stockCount == CUTLIST_REPAIR_INVALID)
+    {
+        return failReoptimize(result);
+    }
+    if (seed.stockCount == CUTLIST_REPAIR_FAILED)
+    {
+        return solveCutlist(solver, input, result);
+    }
+    return solveCutlistFromSeed(solver, input, &seed, result);
+}
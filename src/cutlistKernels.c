@@ -0,0 +1,155 @@
+#include "cutlistKernels.h"
+
+// The stock scans run at SIMD width when the compiler targets AVX2 or SSE2 (every x86-64 build), one stock at a time
+// otherwise. Loads are unaligned: scans start at any stock index, and worker buffers of a parallel solve are not
+// carved from the arena
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CUTLIST_SIMD_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CUTLIST_SIMD_LANES 4
+#else
+#define CUTLIST_SIMD_LANES 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+int getLowestSetBit(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long bit_index;
+    _BitScanForward64(&bit_index, mask);
+    return (int)bit_index;
+#else
+    int bit_index = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        bit_index++;
+    }
+    return bit_index;
+#endif
+}
+
+uint64_t getFittingStockMask(const int *remainingSpace, int firstStock, int stockCount, int pieceSize)
+{
+    int lane_count = stockCount - firstStock;
+    if (lane_count > CUTLIST_STOCK_MASK_WIDTH)
+    {
+        lane_count = CUTLIST_STOCK_MASK_WIDTH;
+    }
+
+    const int *space = &remainingSpace[firstStock];
+    uint64_t mask = 0;
+    int lane = 0;
+
+    // space >= pieceSize is space > pieceSize - 1; every lane compares at once and movemask packs the sign bits
+#if CUTLIST_SIMD_LANES == 8
+    __m256i threshold = _mm256_set1_epi32(pieceSize - 1);
+    for (; lane + 8 <= lane_count; lane += 8)
+    {
+        __m256i fits = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)&space[lane]), threshold);
+        mask |= (uint64_t)(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(fits)) << lane;
+    }
+#elif CUTLIST_SIMD_LANES == 4
+    __m128i threshold = _mm_set1_epi32(pieceSize - 1);
+    for (; lane + 4 <= lane_count; lane += 4)
+    {
+        __m128i fits = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)&space[lane]), threshold);
+        mask |= (uint64_t)(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(fits)) << lane;
+    }
+#endif
+
+    for (; lane < lane_count; lane++)
+    {
+        mask |= (uint64_t)(space[lane] >= pieceSize) << lane;
+    }
+
+    return mask;
+}
+
+int containsStockSpace(const int *remainingSpace, int firstStock, int lastStock, int space)
+{
+    int stock_index = firstStock;
+
+#if CUTLIST_SIMD_LANES == 8
+    __m256i target = _mm256_set1_epi32(space);
+    for (; stock_index + 8 <= lastStock; stock_index += 8)
+    {
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&remainingSpace[stock_index]), target);
+        if (!_mm256_testz_si256(equal, equal))
+        {
+            return 1;
+        }
+    }
+#elif CUTLIST_SIMD_LANES == 4
+    __m128i target = _mm_set1_epi32(space);
+    for (; stock_index + 4 <= lastStock; stock_index += 4)
+    {
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&remainingSpace[stock_index]), target);
+        if (_mm_movemask_epi8(equal))
+        {
+            return 1;
+        }
+    }
+#endif
+
+    for (; stock_index < lastStock; stock_index++)
+    {
+        if (remainingSpace[stock_index] == space)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+long long sumFittingStockSpace(const int *remainingSpace, int stockCount, int minimumSpace)
+{
+    long long total_space = 0;
+    int stock_index = 0;
+
+    // Lanes are summed in 64 bits: a stock's space fits in 32, but hundreds of them may not
+#if CUTLIST_SIMD_LANES == 8
+    __m256i threshold = _mm256_set1_epi32(minimumSpace - 1);
+    __m256i lane_totals = _mm256_setzero_si256();
+    for (; stock_index + 8 <= stockCount; stock_index += 8)
+    {
+        __m256i space = _mm256_loadu_si256((const __m256i *)&remainingSpace[stock_index]);
+        __m256i usable = _mm256_and_si256(space, _mm256_cmpgt_epi32(space, threshold));
+        lane_totals = _mm256_add_epi64(lane_totals, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(usable)));
+        lane_totals = _mm256_add_epi64(lane_totals, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(usable, 1)));
+    }
+    long long lane_values[4];
+    _mm256_storeu_si256((__m256i *)lane_values, lane_totals);
+    total_space = lane_values[0] + lane_values[1] + lane_values[2] + lane_values[3];
+#elif CUTLIST_SIMD_LANES == 4
+    __m128i threshold = _mm_set1_epi32(minimumSpace - 1);
+    __m128i zero = _mm_setzero_si128();
+    __m128i lane_totals = zero;
+    for (; stock_index + 4 <= stockCount; stock_index += 4)
+    {
+        __m128i space = _mm_loadu_si128((const __m128i *)&remainingSpace[stock_index]);
+        __m128i usable = _mm_and_si128(space, _mm_cmpgt_epi32(space, threshold));
+        lane_totals = _mm_add_epi64(lane_totals, _mm_unpacklo_epi32(usable, zero));
+        lane_totals = _mm_add_epi64(lane_totals, _mm_unpackhi_epi32(usable, zero));
+    }
+    long long lane_values[2];
+    _mm_storeu_si128((__m128i *)lane_values, lane_totals);
+    total_space = lane_values[0] + lane_values[1];
+#endif
+
+    for (; stock_index < stockCount; stock_index++)
+    {
+        if (remainingSpace[stock_index] >= minimumSpace)
+        {
+            total_space += remainingSpace[stock_index];
+        }
+    }
+    return total_space;
+}
@@ -0,0 +1,519 @@
+#include "cutlistLocalSearch.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Least-filled stocks a round picks its target from at random
+#define CUTLIST_LOCAL_SEARCH_TARGETS 4
+
+// Random fill moves tried after a round fails to empty its stock
+#define CUTLIST_LOCAL_SEARCH_FILL_MOVES 64
+
+// Pieces looked at for one ejection, from a random start, so a chain costs the same however large the order
+#define CUTLIST_LOCAL_SEARCH_EJECTION_SCAN 4096
+
+// Moves a round records for undoing: every target piece leaves its stock once, and each link of its chain moves two
+#define CUTLIST_LOCAL_SEARCH_UNDO_CAPACITY (CUTLIST_LOCAL_SEARCH_MAX_TARGET_PIECES * (2 * CUTLIST_LOCAL_SEARCH_CHAIN_DEPTH + 3))
+
+// One search thread's copy of the packing. Pieces of a stock form a doubly linked list, so a move is O(1)
+typedef struct {
+    const int *pieceSizes;        // Packed sizes, kerf included, shared by every thread
+    int pieceCount;
+    int stockCount;               // Stocks of the starting packing. An emptied stock stays empty and numbered
+    int stockLength;              // Length packed into a stock, as PackingState.stockLength
+    int *stockOf;                 // Stock of every piece, -1 while a chain has pushed it out
+    int *nextPiece;
+    int *previousPiece;
+    int *firstPiece;              // Of every stock, -1 when empty
+    int *load;
+    int *stockPieces;             // Pieces on every stock
+    int openCount;                // Stocks with a piece on them
+    long long fillScore;          // Sum of the squared loads: higher is fewer, longer offcuts for the same stocks
+    int *undoPiece;
+    int *undoStock;
+    int undoCount;
+    long long *targetKeys;        // The pieces of the stock being emptied, largest first
+    uint64_t random;
+    long long moves;
+    long long moveLimit;
+    double deadline;
+    const atomic_int *cancelRequested;
+    int lowerBound;
+    int stopped;
+} LocalSearch;
+
+// splitmix64, to spread the caller's seed and the thread index over the whole state
+static uint64_t mixSeed(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// xorshift64*, the same sequence on every platform
+static uint32_t nextSearchRandom(LocalSearch *search)
+{
+    search->random ^= search->random >> 12;
+    search->random ^= search->random << 25;
+    search->random ^= search->random >> 27;
+    return (uint32_t)((search->random * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// Moves piece to stock, -1 to take it out of every stock, keeping the loads and the fill score up to date. Recorded
+// moves can be undone
+static void moveSearchPiece(LocalSearch *search, int piece, int stock, int record)
+{
+    int from = search->stockOf[piece];
+    long long size = search->pieceSizes[piece];
+    if (record)
+    {
+        search->undoPiece[search->undoCount] = piece;
+        search->undoStock[search->undoCount] = from;
+        search->undoCount++;
+    }
+
+    if (from >= 0)
+    {
+        int next = search->nextPiece[piece];
+        int previous = search->previousPiece[piece];
+        if (previous >= 0)
+        {
+            search->nextPiece[previous] = next;
+        }
+        else
+        {
+            search->firstPiece[from] = next;
+        }
+        if (next >= 0)
+        {
+            search->previousPiece[next] = previous;
+        }
+
+        long long load = search->load[from];
+        search->fillScore += (load - size) * (load - size) - load * load;
+        search->load[from] -= (int)size;
+        if (--search->stockPieces[from] == 0)
+        {
+            search->openCount--;
+        }
+    }
+
+    search->stockOf[piece] = stock;
+    if (stock >= 0)
+    {
+        search->previousPiece[piece] = -1;
+        search->nextPiece[piece] = search->firstPiece[stock];
+        if (search->firstPiece[stock] >= 0)
+        {
+            search->previousPiece[search->firstPiece[stock]] = piece;
+        }
+        search->firstPiece[stock] = piece;
+
+        long long load = search->load[stock];
+        search->fillScore += (load + size) * (load + size) - load * load;
+        search->load[stock] += (int)size;
+        if (search->stockPieces[stock]++ == 0)
+        {
+            search->openCount++;
+        }
+    }
+}
+
+static void undoSearchMoves(LocalSearch *search, int mark)
+{
+    while (search->undoCount > mark)
+    {
+        search->undoCount--;
+        moveSearchPiece(search, search->undoPiece[search->undoCount], search->undoStock[search->undoCount], 0);
+    }
+}
+
+// Counts a move, and every CUTLIST_BUDGET_CHECK_INTERVAL moves checks the clock and the cancel flag
+static int isLocalSearchStopped(LocalSearch *search)
+{
+    search->moves++;
+    if ((search->moveLimit > 0) && (search->moves >= search->moveLimit))
+    {
+        search->stopped = 1;
+    }
+    if ((search->moves & (CUTLIST_BUDGET_CHECK_INTERVAL - 1)) == 0)
+    {
+        if ((search->deadline > 0) && (getCutlistWallSeconds() >= search->deadline))
+        {
+            search->stopped = 1;
+        }
+        if (search->cancelRequested && atomic_load_explicit(search->cancelRequested, memory_order_relaxed))
+        {
+            search->stopped = 1;
+        }
+    }
+    return search->stopped;
+}
+
+// Places a piece that is out of every stock on any stock but target: best fit if it fits somewhere, else in place of
+// the smaller piece whose stock it then fills best, which is placed in turn. Returns 1 once every piece is placed
+static int placeSearchPiece(LocalSearch *search, int piece, int target, int depth)
+{
+    isLocalSearchStopped(search);
+    int size = search->pieceSizes[piece];
+    int best_stock = -1;
+    for (int stock = 0; stock < search->stockCount; stock++)
+    {
+        if ((stock != target) && (search->stockPieces[stock] > 0) && (search->load[stock] + size <= search->stockLength) &&
+            ((best_stock < 0) || (search->load[stock] > search->load[best_stock])))
+        {
+            best_stock = stock;
+        }
+    }
+    if (best_stock >= 0)
+    {
+        moveSearchPiece(search, piece, best_stock, 1);
+        return 1;
+    }
+    if ((depth == CUTLIST_LOCAL_SEARCH_CHAIN_DEPTH) || (search->pieceCount == 0))
+    {
+        return 0;
+    }
+
+    // Ejection: the smaller piece that leaves its stock fullest once this one takes its place
+    int scan = (search->pieceCount < CUTLIST_LOCAL_SEARCH_EJECTION_SCAN) ? search->pieceCount : CUTLIST_LOCAL_SEARCH_EJECTION_SCAN;
+    int start = (int)(nextSearchRandom(search) % (uint32_t)search->pieceCount);
+    int ejected = -1;
+    int best_load = -1;
+    for (int step = 0; step < scan; step++)
+    {
+        int other = (start + step) % search->pieceCount;
+        int stock = search->stockOf[other];
+        int other_size = search->pieceSizes[other];
+        if ((stock < 0) || (stock == target) || (other_size >= size))
+        {
+            continue;
+        }
+        int load = search->load[stock] - other_size + size;
+        if ((load <= search->stockLength) && (load > best_load))
+        {
+            ejected = other;
+            best_load = load;
+        }
+    }
+    if (ejected < 0)
+    {
+        return 0;
+    }
+
+    int stock = search->stockOf[ejected];
+    moveSearchPiece(search, ejected, -1, 1);
+    moveSearchPiece(search, piece, stock, 1);
+    return placeSearchPiece(search, ejected, target, depth + 1);
+}
+
+static int compareTargetKeys(const void *first, const void *second)
+{
+    long long first_key = *(const long long *)first;
+    long long second_key = *(const long long *)second;
+    return (first_key < second_key) - (first_key > second_key);
+}
+
+// Moves every piece of target elsewhere, largest first. Returns 1 if the stock was emptied, else undoes every move
+static int emptySearchStock(LocalSearch *search, int target)
+{
+    int key_count = 0;
+    for (int piece = search->firstPiece[target]; piece >= 0; piece = search->nextPiece[piece])
+    {
+        search->targetKeys[key_count++] = ((long long)search->pieceSizes[piece] << 32) | piece;
+    }
+    qsort(search->targetKeys, (size_t)key_count, sizeof(long long), compareTargetKeys);
+
+    search->undoCount = 0;
+    for (int key_index = 0; key_index < key_count; key_index++)
+    {
+        int piece = (int)(search->targetKeys[key_index] & 0xFFFFFFFF);
+        moveSearchPiece(search, piece, -1, 1);
+        if (!placeSearchPiece(search, piece, target, 0))
+        {
+            undoSearchMoves(search, 0);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// A random one of the CUTLIST_LOCAL_SEARCH_TARGETS least-filled stocks small enough to empty piece by piece, -1 if none
+static int pickSearchTarget(LocalSearch *search)
+{
+    int candidates[CUTLIST_LOCAL_SEARCH_TARGETS];
+    int candidate_count = 0;
+    for (int stock = 0; stock < search->stockCount; stock++)
+    {
+        if ((search->stockPieces[stock] == 0) || (search->stockPieces[stock] > CUTLIST_LOCAL_SEARCH_MAX_TARGET_PIECES))
+        {
+            continue;
+        }
+
+        // Insertion into the candidates, least load first
+        int slot = candidate_count;
+        while ((slot > 0) && (search->load[candidates[slot - 1]] > search->load[stock]))
+        {
+            if (slot < CUTLIST_LOCAL_SEARCH_TARGETS)
+            {
+                candidates[slot] = candidates[slot - 1];
+            }
+            slot--;
+        }
+        if (slot < CUTLIST_LOCAL_SEARCH_TARGETS)
+        {
+            candidates[slot] = stock;
+            candidate_count += (candidate_count < CUTLIST_LOCAL_SEARCH_TARGETS);
+        }
+    }
+    return (candidate_count > 0) ? candidates[nextSearchRandom(search) % (uint32_t)candidate_count] : -1;
+}
+
+// Random moves and swaps between two stocks, each taken only if it leaves the fuller stock fuller. A move out of a
+// stock's last piece empties it
+static void fillSearchStocks(LocalSearch *search)
+{
+    for (int attempt = 0; (attempt < CUTLIST_LOCAL_SEARCH_FILL_MOVES) && !isLocalSearchStopped(search); attempt++)
+    {
+        int piece = (int)(nextSearchRandom(search) % (uint32_t)search->pieceCount);
+        int other = (int)(nextSearchRandom(search) % (uint32_t)search->pieceCount);
+        int from = search->stockOf[piece];
+        int to = search->stockOf[other];
+        if (from == to)
+        {
+            continue;
+        }
+
+        long long size = search->pieceSizes[piece];
+        long long other_size = search->pieceSizes[other];
+        long long from_load = search->load[from];
+        long long to_load = search->load[to];
+        if ((to_load + size <= search->stockLength) && (to_load + size > from_load))
+        {
+            // The change in the sum of squares is 2 * size * (to_load - from_load + size)
+            moveSearchPiece(search, piece, to, 0);
+            continue;
+        }
+
+        long long from_after = from_load - size + other_size;
+        long long to_after = to_load - other_size + size;
+        if ((from_after <= search->stockLength) && (to_after <= search->stockLength) &&
+            (from_after * from_after + to_after * to_after > from_load * from_load + to_load * to_load))
+        {
+            moveSearchPiece(search, piece, to, 0);
+            moveSearchPiece(search, other, from, 0);
+        }
+    }
+}
+
+static void *runLocalSearch(void *argument)
+{
+    LocalSearch *search = (LocalSearch *)argument;
+    while (!search->stopped && (search->openCount > search->lowerBound))
+    {
+        int target = pickSearchTarget(search);
+        if ((target < 0) || !emptySearchStock(search, target))
+        {
+            fillSearchStocks(search);
+        }
+    }
+    return NULL;
+}
+
+// Carves a search out of memory and loads the starting packing into it. memory holds getLocalSearchInts ints
+static size_t getLocalSearchInts(int pieceCount, int stockCount)
+{
+    return 3 * (size_t)pieceCount + 3 * (size_t)stockCount + 2 * (size_t)CUTLIST_LOCAL_SEARCH_UNDO_CAPACITY;
+}
+
+static void loadLocalSearch(LocalSearch *search, int *memory, const int *assignments)
+{
+    search->stockOf = memory;
+    search->nextPiece = &search->stockOf[search->pieceCount];
+    search->previousPiece = &search->nextPiece[search->pieceCount];
+    search->firstPiece = &search->previousPiece[search->pieceCount];
+    search->load = &search->firstPiece[search->stockCount];
+    search->stockPieces = &search->load[search->stockCount];
+    search->undoPiece = &search->stockPieces[search->stockCount];
+    search->undoStock = &search->undoPiece[CUTLIST_LOCAL_SEARCH_UNDO_CAPACITY];
+
+    for (int stock = 0; stock < search->stockCount; stock++)
+    {
+        search->firstPiece[stock] = -1;
+        search->load[stock] = 0;
+        search->stockPieces[stock] = 0;
+    }
+    search->openCount = 0;
+    search->fillScore = 0;
+    for (int piece = search->pieceCount - 1; piece >= 0; piece--)
+    {
+        search->stockOf[piece] = -1;
+        moveSearchPiece(search, piece, assignments[piece], 0);
+    }
+}
+
+int improveCutlistPacking(CutlistInput input, const CutlistLocalSearchOptions *options, CutlistResult *result)
+{
+    double start_time = getCutlistWallSeconds();
+    long long capacity = (long long)input.stockLength - input.trimLength + input.kerfWidth;
+    if ((result->status != CUTLIST_STATUS_OK) || (input.stockTypeCount > 0) || (input.pieceCount < 0) ||
+        ((input.pieceCount > 0) && (!input.requiredPieces || !result->assignments)) || (input.kerfWidth < 0) ||
+        (input.trimLength < 0) || (input.stockLength <= input.trimLength) || (capacity > INT_MAX) ||
+        (result->stockUsed < 0) || (result->stockUsed > input.pieceCount))
+    {
+        return -1;
+    }
+
+    int piece_count = input.pieceCount;
+    int stock_count = result->stockUsed;
+    int thread_count = (options && (options->threadCount > 1)) ? options->threadCount : 1;
+    size_t search_ints = getLocalSearchInts(piece_count, stock_count);
+    int *piece_sizes = (int *)malloc(((size_t)piece_count + 1) * sizeof(int));
+    int *memory = (int *)malloc((size_t)thread_count * search_ints * sizeof(int));
+    long long *target_keys = (long long *)malloc((size_t)thread_count * CUTLIST_LOCAL_SEARCH_MAX_TARGET_PIECES * sizeof(long long));
+    LocalSearch *searches = (LocalSearch *)calloc((size_t)thread_count, sizeof(LocalSearch));
+    pthread_t *threads = (pthread_t *)malloc((size_t)thread_count * sizeof(pthread_t));
+    int *started = (int *)malloc((size_t)thread_count * sizeof(int));
+    if (!piece_sizes || !memory || !target_keys || !searches || !threads || !started)
+    {
+        free(piece_sizes);
+        free(memory);
+        free(target_keys);
+        free(searches);
+        free(threads);
+        free(started);
+        return -1;
+    }
+
+    // The packing has to be one: every piece on a stock in range, no stock overfull. The first search checks the loads
+    int valid = 1;
+    long long total_length = 0;
+    for (int piece = 0; valid && (piece < piece_count); piece++)
+    {
+        piece_sizes[piece] = input.requiredPieces[piece] + input.kerfWidth;
+        total_length += piece_sizes[piece];
+        valid = (input.requiredPieces[piece] >= 0) && (piece_sizes[piece] <= capacity) &&
+                (result->assignments[piece] >= 0) && (result->assignments[piece] < stock_count);
+    }
+
+    long long move_limit = options ? options->moveLimit : 0;
+    double time_limit = options ? options->timeLimitSeconds : 0;
+    if ((move_limit <= 0) && (time_limit <= 0))
+    {
+        move_limit = CUTLIST_LOCAL_SEARCH_DEFAULT_MOVES;
+    }
+    for (int thread_index = 0; valid && (thread_index < thread_count); thread_index++)
+    {
+        LocalSearch *search = &searches[thread_index];
+        search->pieceSizes = piece_sizes;
+        search->pieceCount = piece_count;
+        search->stockCount = stock_count;
+        search->stockLength = (int)capacity;
+        search->targetKeys = &target_keys[(size_t)thread_index * CUTLIST_LOCAL_SEARCH_MAX_TARGET_PIECES];
+        search->random = mixSeed(((uint64_t)(options ? options->seed : 0) << 32) | (uint32_t)thread_index) | 1;
+        search->moveLimit = move_limit;
+        search->deadline = (time_limit > 0) ? (start_time + time_limit) : 0;
+        search->cancelRequested = options ? options->cancelRequested : NULL;
+        search->lowerBound = result->stockLowerBound;
+        loadLocalSearch(search, &memory[(size_t)thread_index * search_ints], result->assignments);
+        for (int stock = 0; (thread_index == 0) && (stock < stock_count); stock++)
+        {
+            valid = valid && (search->load[stock] <= capacity);
+        }
+    }
+    if (!valid)
+    {
+        free(piece_sizes);
+        free(memory);
+        free(target_keys);
+        free(searches);
+        free(threads);
+        free(started);
+        return -1;
+    }
+    long long start_score = searches[0].fillScore;
+    int start_open = searches[0].openCount;
+
+    // The calling thread searches too. A thread that fails to start leaves its seed unsearched
+    for (int thread_index = 1; thread_index < thread_count; thread_index++)
+    {
+        started[thread_index] = (piece_count > 0) && (pthread_create(&threads[thread_index], NULL, runLocalSearch, &searches[thread_index]) == 0);
+        if (!started[thread_index])
+        {
+            searches[thread_index].stopped = 1;
+        }
+    }
+    if (piece_count > 0)
+    {
+        runLocalSearch(&searches[0]);
+    }
+    long long moves = 0;
+    int best = 0;
+    for (int thread_index = 0; thread_index < thread_count; thread_index++)
+    {
+        if ((thread_index > 0) && started[thread_index])
+        {
+            pthread_join(threads[thread_index], NULL);
+        }
+        if ((thread_index == 0) || started[thread_index])
+        {
+            LocalSearch *search = &searches[thread_index];
+            moves += search->moves;
+            if ((search->openCount < searches[best].openCount) ||
+                ((search->openCount == searches[best].openCount) && (search->fillScore > searches[best].fillScore)))
+            {
+                best = thread_index;
+            }
+        }
+    }
+
+    // Stocks left open keep their order, numbered from 0
+    LocalSearch *winner = &searches[best];
+    if ((winner->openCount < start_open) || (winner->fillScore > start_score))
+    {
+        int next_number = 0;
+        for (int stock = 0; stock < stock_count; stock++)
+        {
+            winner->load[stock] = (winner->stockPieces[stock] > 0) ? next_number++ : -1;
+        }
+        for (int piece = 0; piece < piece_count; piece++)
+        {
+            result->assignments[piece] = winner->load[winner->stockOf[piece]];
+        }
+    }
+
+    // Stats go on from the solve the packing came from, with improvements timed from its start
+    PackingState progress;
+    memset(&progress, 0, sizeof(progress));
+    progress.stats = result->stats;
+    progress.startTime = start_time - result->stats.totalSeconds;
+    progress.stockCost = input.stockLength;
+    progress.stats.nodesExpanded += moves;
+    if (winner->openCount < start_open)
+    {
+        long long waste = (long long)winner->openCount * capacity - total_length;
+        recordCutlistImprovement(&progress, progress.stats.nodesExpanded, winner->openCount, (int)waste, 0);
+        result->stockUsed = winner->openCount;
+        result->waste = (int)waste;
+        result->cost = (long long)winner->openCount * input.stockLength;
+    }
+    result->provenOptimal = result->provenOptimal || (result->stockUsed <= result->stockLowerBound);
+    result->optimalityGap = (result->provenOptimal || (result->cost == 0)) ? 0.0 :
+                            ((double)(result->cost - (long long)result->stockLowerBound * input.stockLength) / result->cost);
+    if (result->provenOptimal && (progress.stats.secondsToOptimum < 0))
+    {
+        progress.stats.secondsToOptimum = getCutlistWallSeconds() - progress.startTime;
+    }
+    progress.stats.totalSeconds = getCutlistWallSeconds() - progress.startTime;
+    progress.stats.memoryBytes += (size_t)thread_count * (search_ints * sizeof(int) + sizeof(LocalSearch));
+    result->stats = progress.stats;
+
+    free(piece_sizes);
+    free(memory);
+    free(target_keys);
+    free(searches);
+    free(threads);
+    free(started);
+    return 0;
+}
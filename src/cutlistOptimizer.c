@@ -1,244 +1,1619 @@
 #include "cutlistOptimizer.h"
+#include "cutlistParallel.h"
+#include "cutlistHeuristics.h"
+#include "cutlistKernels.h"
+#include "cutlistTransposition.h"
+#include "cutlistPatterns.h"
+#include "cutlistFormat.h"
+#include "cutlistDecompose.h"
 
-// Function to optimize the cutlist and minimize waste
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+
+// Writes one line per stock listing the sizes of the pieces assigned to it, less the kerf the search adds to them
+static void writeStockAssignments(FILE *stream, const int *pieceSizes, int kerfWidth, const int *assignments, int pieceCount, int stockCount)
+{
+    fputs("Stock assignments:\n", stream);
+
+    for (int stock_index = 0; stock_index < stockCount; stock_index++) 
+    {
+        fprintf(stream, "Stock #%d: ", stock_index + 1);
+
+        int first = 1;
+        for (int piece_index = 0; piece_index < pieceCount; piece_index++) 
+        {
+            if (assignments[piece_index] == stock_index) 
+            {
+                fprintf(stream, first ? "%d" : ", %d", pieceSizes[piece_index] - kerfWidth);
+                first = 0;
+            }
+        }
+        fputc('\n', stream);
+    }
+
+    fputc('\n', stream);
+}
+
+// Prints the current stock assignments of the search at the given trace level. Writes straight to stdout so
+// even full tracing does no allocation per search node
+static void traceStockAssignments(PackingState *state, CutlistTraceLevel level)
+{
+    if (CUTLIST_TRACING(state->traceLevel, level))
+    {
+        writeStockAssignments(stdout, state->pieceSizes, state->kerfWidth, state->currentAssignments, state->totalPieces, state->currentStockCount);
+    }
+}
+
+// Rounds an arena offset up so every buffer starts on its own cache line
+static size_t alignArenaOffset(size_t offset)
+{
+    return (offset + CUTLIST_ARENA_ALIGNMENT - 1) & ~((size_t)CUTLIST_ARENA_ALIGNMENT - 1);
+}
+
+// Bytes of arena needed to solve an input, must match the carving in solveCutlist
+static size_t getArenaSize(int pieceCount, int stockTypeCount, int coverEntryCount,
+                           long long transpositionEntries, size_t engineScratchSize)
+{
+    size_t piece_array_size = alignArenaOffset((size_t)(pieceCount + 1) * sizeof(int));
+    size_t heuristic_scratch_size = alignArenaOffset(getHeuristicScratchSize(pieceCount) * sizeof(int));
+    size_t catalogue_size = 0;
+    if (stockTypeCount > 0)
+    {
+        // The catalogue greedy packing needs less scratch than the single-length ones, and the search two more
+        // arrays for the kind of every stock
+        heuristic_scratch_size = alignArenaOffset((size_t)(pieceCount + stockTypeCount) * sizeof(int));
+        catalogue_size = 5 * alignArenaOffset((size_t)stockTypeCount * sizeof(int)) + 2 * piece_array_size +
+                         alignArenaOffset((size_t)coverEntryCount * sizeof(long long));
+    }
+    size_t transposition_size = 0;
+    if (transpositionEntries > 0)
+    {
+        transposition_size = alignArenaOffset(sizeof(TranspositionTable)) +
+                             alignArenaOffset(getTranspositionEntryBytes(transpositionEntries));
+    }
+    return 10 * piece_array_size + alignArenaOffset((size_t)pieceCount * sizeof(SearchFrame)) + heuristic_scratch_size + catalogue_size +
+           transposition_size + alignArenaOffset(engineScratchSize);
+}
+
+// Hands out the next buffer of the arena. The arena is sized up front, so this never fails
+static void *allocateFromArena(CutlistSolver *solver, size_t bytes)
+{
+    void *buffer = solver->arena + solver->arenaUsed;
+    solver->arenaUsed = alignArenaOffset(solver->arenaUsed + bytes);
+    return buffer;
+}
+
+// Makes sure the arena can hold an input, reallocating only when it has to grow
+static int reserveArena(CutlistSolver *solver, int pieceCount, int stockTypeCount, int coverEntryCount,
+                        long long transpositionEntries, size_t engineScratchSize)
+{
+    size_t required_size = getArenaSize(pieceCount, stockTypeCount, coverEntryCount, transpositionEntries, engineScratchSize);
+    if (required_size <= solver->arenaCapacity)
+    {
+        return 0;
+    }
+
+    // Old contents are never needed across solves, so a fresh block is as good as realloc and skips the copy
+    free(solver->arenaBlock);
+    solver->arenaBlock = (unsigned char *)malloc(required_size + CUTLIST_ARENA_ALIGNMENT);
+    if (!solver->arenaBlock)
+    {
+        solver->arena = NULL;
+        solver->arenaCapacity = 0;
+        return -1;
+    }
+
+    // Start the arena on a cache line boundary
+    uintptr_t block_address = (uintptr_t)solver->arenaBlock;
+    solver->arena = solver->arenaBlock + (alignArenaOffset(block_address) - block_address);
+    solver->arenaCapacity = required_size;
+    return 0;
+}
+
+// Wall-clock time in seconds, for the search budget
+double getCutlistWallSeconds(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Marks a result as failed, with the -1 stock and waste sentinels and the reason. Returns -1
+static int failSolve(CutlistResult *result, CutlistStatus status)
+{
+    result->status = status;
+    result->stockUsed = -1;
+    result->waste = -1;
+    return -1;
+}
+
+// Empties the stats of a result, for a solve that has not searched yet
+void resetCutlistStats(CutlistStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->secondsToFirstSolution = -1.0;
+    stats->secondsToOptimum = -1.0;
+}
+
+// Adds an improvement of the best packing to the state's stats and hands it to the caller's callback. Once the list is
+// full every later one overwrites the last entry, so the list always ends with the best packing. Called on
+// improvements only, so timing them costs nothing. Without a catalogue cost is worked out here from stockUsed
+void recordCutlistImprovement(PackingState *state, long long nodes, int stockUsed, int waste, long long cost)
+{
+    CutlistStats *stats = &state->stats;
+    int slot = (stats->improvementCount < CUTLIST_STATS_MAX_IMPROVEMENTS) ? stats->improvementCount : (CUTLIST_STATS_MAX_IMPROVEMENTS - 1);
+    CutlistImprovement *improvement = &stats->improvements[slot];
+    improvement->seconds = getCutlistWallSeconds() - state->startTime;
+    improvement->nodes = nodes;
+    improvement->stockUsed = stockUsed;
+    improvement->waste = waste;
+    improvement->cost = (state->stockTypeCount > 0) ? cost : (long long)stockUsed * state->stockCost;
+    stats->improvementCount++;
+
+    if (state->onImprovement)
+    {
+        state->onImprovement(improvement, state->userData);
+    }
+}
+
+// Returns 1 for the strategies that prove their packing optimal, given the budget
+static int isExactStrategy(CutlistStrategy strategy)
+{
+    return (strategy == CUTLIST_STRATEGY_EXACT) || (strategy == CUTLIST_STRATEGY_BRANCH_AND_BOUND) ||
+           (strategy == CUTLIST_STRATEGY_PATTERNS);
+}
+
+// Returns 1 for the strategies that search past the greedy packing, exact or not
+static int isSearchStrategy(CutlistStrategy strategy)
+{
+    return isExactStrategy(strategy) || (strategy == CUTLIST_STRATEGY_DECOMPOSE);
+}
+
+// Total cost of a packing over the stock catalogue, given the kind of each of its stocks. Its waste is the length of
+// those stocks less the length of the pieces
+static long long getCataloguePackingCost(PackingState *state, const int *stockTypes, int stockCount, long long *waste)
+{
+    long long cost = 0;
+    long long stock_length = 0;
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        cost += state->stockTypeCosts[stockTypes[stock_index]];
+        stock_length += state->stockTypeLengths[stockTypes[stock_index]];
+    }
+
+    *waste = stock_length - state->remainingPieceLength[0];
+    return cost;
+}
+
+// Makes the cheaper of the first-fit and best-fit catalogue packings (or just the one the strategy asks for) the
+// incumbent. Either can run out of stock on hand that an exact search would still fit the pieces into, in which case
+// the search starts without one
+static void seedWithCatalogueGreedyPacking(PackingState *state, CutlistStrategy strategy, int *scratch)
+{
+    long long waste = 0;
+    int stock_count = packCatalogueDecreasing(state->pieceSizes, state->totalPieces, state->stockTypeLengths, state->stockTypeCosts,
+                                              state->stockTypeOnHand, state->stockTypeCount, (strategy == CUTLIST_STRATEGY_BEST_FIT_DECREASING),
+                                              state->optimalAssignments, state->optimalStockTypes, scratch);
+    long long cost = (stock_count >= 0) ? getCataloguePackingCost(state, state->optimalStockTypes, stock_count, &waste) : LLONG_MAX;
+
+    // currentAssignments and currentStockTypes are not read by the search before they are written
+    if (isSearchStrategy(strategy) && (cost > state->rootCostLowerBound))
+    {
+        long long best_fit_waste = 0;
+        int best_fit_stock_count = packCatalogueDecreasing(state->pieceSizes, state->totalPieces, state->stockTypeLengths, state->stockTypeCosts,
+                                                           state->stockTypeOnHand, state->stockTypeCount, 1,
+                                                           state->currentAssignments, state->currentStockTypes, scratch);
+        long long best_fit_cost = (best_fit_stock_count >= 0) ?
+                                  getCataloguePackingCost(state, state->currentStockTypes, best_fit_stock_count, &best_fit_waste) : LLONG_MAX;
+        if (best_fit_cost < cost)
+        {
+            stock_count = best_fit_stock_count;
+            cost = best_fit_cost;
+            waste = best_fit_waste;
+            memcpy(state->optimalAssignments, state->currentAssignments, (size_t)state->totalPieces * sizeof(int));
+            memcpy(state->optimalStockTypes, state->currentStockTypes, (size_t)stock_count * sizeof(int));
+        }
+    }
+
+    if (cost == LLONG_MAX)
+    {
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Greedy packing ran out of stock.\n\n");
+        return;
+    }
+
+    state->optimalStockCount = stock_count;
+    state->optimalCost = cost;
+    state->optimalWaste = (int)waste;
+    state->optimalTask = CUTLIST_NO_TASK;
+    recordCutlistImprovement(state, 0, stock_count, state->optimalWaste, cost);
+
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Greedy packing: Stock Used = %d, Cost = %lld, Waste = %d\n\n", state->optimalStockCount, state->optimalCost, state->optimalWaste);
+}
+
+// Makes the better of the First-Fit-Decreasing and Best-Fit-Decreasing packings (or just the one the strategy asks
+// for) the incumbent. The greedy packing keeps CUTLIST_NO_TASK, so the exact search still replaces it with the first
+// packing it finds that is just as good, and returns the same packing it would without the seed
+static void seedWithGreedyPacking(PackingState *state, CutlistStrategy strategy, int *scratch)
+{
+    if (state->stockTypeCount > 0)
+    {
+        seedWithCatalogueGreedyPacking(state, strategy, scratch);
+        return;
+    }
+
+    int stock_count;
+
+    // currentAssignments is not read by the search before it is written, so it holds the second candidate
+    if (strategy == CUTLIST_STRATEGY_BEST_FIT_DECREASING)
+    {
+        stock_count = packBestFitDecreasing(state->pieceSizes, state->totalPieces, state->stockLength, state->optimalAssignments, scratch);
+    }
+    else
+    {
+        stock_count = packFirstFitDecreasing(state->pieceSizes, state->totalPieces, state->stockLength, state->optimalAssignments, scratch);
+        if (isSearchStrategy(strategy) && (stock_count > state->rootLowerBound))
+        {
+            int best_fit_stock_count = packBestFitDecreasing(state->pieceSizes, state->totalPieces, state->stockLength,
+                                                             state->currentAssignments, scratch);
+            if (best_fit_stock_count < stock_count)
+            {
+                stock_count = best_fit_stock_count;
+                memcpy(state->optimalAssignments, state->currentAssignments, (size_t)state->totalPieces * sizeof(int));
+            }
+        }
+    }
+
+    state->optimalStockCount = stock_count;
+    state->optimalWaste = stock_count * state->stockLength - state->remainingPieceLength[0];
+    state->optimalTask = CUTLIST_NO_TASK;
+    recordCutlistImprovement(state, 0, stock_count, state->optimalWaste, 0);
+
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Greedy packing: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
+}
+
+// Stable sort of piece indices by descending length. LSD radix sort on (maxLength - length), one pass per byte
+// maxLength actually uses, so typical stock lengths take two O(n) passes. Lengths must be in [0, maxLength]
+static void sortPiecesDescending(const int *pieces, int pieceCount, int maxLength, int *sortedIndex, int *scratch)
+{
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        sortedIndex[piece_index] = piece_index;
+    }
+
+    int *source = sortedIndex;
+    int *destination = scratch;
+    for (int shift = 0; (shift < 32) && ((maxLength >> shift) != 0); shift += 8)
+    {
+        int bucket_start[257] = {0};
+        for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+        {
+            bucket_start[(((maxLength - pieces[piece_index]) >> shift) & 0xFF) + 1]++;
+        }
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            bucket_start[bucket + 1] += bucket_start[bucket];
+        }
+        for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+        {
+            int original_index = source[piece_index];
+            destination[bucket_start[((maxLength - pieces[original_index]) >> shift) & 0xFF]++] = original_index;
+        }
+
+        int *swap = source;
+        source = destination;
+        destination = swap;
+    }
+
+    // An odd number of passes leaves the result in the scratch buffer
+    if (source != sortedIndex)
+    {
+        memcpy(sortedIndex, source, (size_t)pieceCount * sizeof(int));
+    }
+}
+
+// Length the search packs into a stock: the stock less its trim, plus one kerf. Every piece is packed with the kerf of
+// the cut after it, and the extra kerf here pays for the last piece of a stock, which needs no cut after it. -1 if
+// nothing is left after the trim or the length overflows
+static int getStockCapacity(const CutlistInput *input, int stockLength)
+{
+    long long capacity = (long long)stockLength - input->trimLength + input->kerfWidth;
+    return ((stockLength > input->trimLength) && (capacity <= INT_MAX)) ? (int)capacity : -1;
+}
+
+static int getGreatestCommonDivisor(int first, int second)
+{
+    while (second != 0)
+    {
+        int remainder = first % second;
+        first = second;
+        second = remainder;
+    }
+    return first;
+}
+
+// Fills minCoverCost: the cheapest stock on hand, whole stocks only, totalling at least every multiple of
+// coverLengthUnit in the table. A bounded knapsack over the kinds, each split into power-of-two bundles of stocks
+static void fillMinCoverCost(PackingState *state)
+{
+    long long *min_cost = state->minCoverCost;
+    int last_entry = state->coverEntryCount - 1;
+    min_cost[0] = 0;
+    for (int entry = 1; entry <= last_entry; entry++)
+    {
+        min_cost[entry] = LLONG_MAX;
+    }
+
+    for (int type_index = 0; type_index < state->stockTypeCount; type_index++)
+    {
+        int length_units = state->stockTypeLengths[type_index] / state->coverLengthUnit;
+        int useful_count = (last_entry + length_units - 1) / length_units;
+        int remaining_count = (state->stockTypeOnHand[type_index] < useful_count) ? state->stockTypeOnHand[type_index] : useful_count;
+
+        for (int bundle = 1; remaining_count > 0; bundle *= 2)
+        {
+            int bundle_count = (bundle < remaining_count) ? bundle : remaining_count;
+            remaining_count -= bundle_count;
+            long long bundle_units = (long long)bundle_count * length_units;
+            long long bundle_cost = (long long)bundle_count * state->stockTypeCosts[type_index];
+
+            // Downwards, so every bundle is used at most once
+            for (int entry = last_entry; entry > 0; entry--)
+            {
+                long long rest = min_cost[(entry > bundle_units) ? (entry - bundle_units) : 0];
+                if ((rest != LLONG_MAX) && (rest + bundle_cost < min_cost[entry]))
+                {
+                    min_cost[entry] = rest + bundle_cost;
+                }
+            }
+        }
+    }
+}
+
+// Copies the kinds of stock on hand into the state, their lengths as packed, by descending length and then ascending
+// cost: the search opens
+// longer stocks first and only the cheapest kind left of every length. Also orders them by cost per unit length for
+// the cost bound. Catalogues are a handful of kinds, so insertion sorts do
+static void loadStockCatalogue(PackingState *state, const CutlistInput *input)
+{
+    state->stockTypeCount = 0;
+    for (int catalogue_index = 0; catalogue_index < input->stockTypeCount; catalogue_index++)
+    {
+        const CutlistStockType *stock_type = &input->stockTypes[catalogue_index];
+        if (stock_type->count == 0)
+        {
+            continue;
+        }
+
+        int capacity = getStockCapacity(input, stock_type->length);
+        int position = state->stockTypeCount++;
+        while ((position > 0) &&
+               ((state->stockTypeLengths[position - 1] < capacity) ||
+                ((state->stockTypeLengths[position - 1] == capacity) && (state->stockTypeCosts[position - 1] > stock_type->cost))))
+        {
+            state->stockTypeLengths[position] = state->stockTypeLengths[position - 1];
+            state->stockTypeCosts[position] = state->stockTypeCosts[position - 1];
+            state->stockTypeOnHand[position] = state->stockTypeOnHand[position - 1];
+            state->stockTypeIndex[position] = state->stockTypeIndex[position - 1];
+            position--;
+        }
+        state->stockTypeLengths[position] = capacity;
+        state->stockTypeCosts[position] = stock_type->cost;
+        state->stockTypeOnHand[position] = (stock_type->count == CUTLIST_STOCK_UNLIMITED) ? INT_MAX : stock_type->count;
+        state->stockTypeIndex[position] = catalogue_index;
+    }
+
+    for (int type_index = 0; type_index < state->stockTypeCount; type_index++)
+    {
+        int position = type_index;
+        while ((position > 0) &&
+               ((long long)state->stockTypeCosts[state->stockTypesByUnitCost[position - 1]] * state->stockTypeLengths[type_index] >
+                (long long)state->stockTypeCosts[type_index] * state->stockTypeLengths[state->stockTypesByUnitCost[position - 1]]))
+        {
+            state->stockTypesByUnitCost[position] = state->stockTypesByUnitCost[position - 1];
+            position--;
+        }
+        state->stockTypesByUnitCost[position] = type_index;
+    }
+
+    if (state->minCoverCost)
+    {
+        fillMinCoverCost(state);
+    }
+}
+
+// Lower bound on the cost of any completion of the current partial packing over a stock catalogue: the open stocks,
+// plus the cheapest way to buy the length that does not fit on them if stocks could be bought by the metre. Kinds
+// shorter than the smallest piece left cannot help. LLONG_MAX if the stock on hand is too short in total
+static long long computeNodeCostLowerBound(PackingState *state, int currentPieceIndex)
+{
+    int smallest_piece = state->pieceSizes[state->totalPieces - 1];
+    long long usable_space = sumFittingStockSpace(state->remainingStockSpace, state->currentStockCount, smallest_piece);
+    long long overflow_length = state->remainingPieceLength[currentPieceIndex] - usable_space;
+    long long cost_bound = state->currentCost;
+
+    // Whole stocks cost at least as much as the same length by the metre, so the table gives the stronger bound. It
+    // counts the stock on hand at the start, while the metre bound below knows what is left
+    long long cover_bound = cost_bound;
+    if ((overflow_length > 0) && state->minCoverCost)
+    {
+        long long cover_entry = (overflow_length + state->coverLengthUnit - 1) / state->coverLengthUnit;
+        if (state->minCoverCost[cover_entry] == LLONG_MAX)
+        {
+            return LLONG_MAX;
+        }
+        cover_bound += state->minCoverCost[cover_entry];
+    }
+
+    for (int order_index = 0; (overflow_length > 0) && (order_index < state->stockTypeCount); order_index++)
+    {
+        int type_index = state->stockTypesByUnitCost[order_index];
+        long long length = state->stockTypeLengths[type_index];
+        long long cost = state->stockTypeCosts[type_index];
+        long long on_hand = state->stockTypeOnHand[type_index];
+        if (length < smallest_piece)
+        {
+            continue;
+        }
+
+        // Whole stocks of this kind while they last, then the fraction of one that covers the rest
+        if (on_hand * length >= overflow_length)
+        {
+            cost_bound += (cost * overflow_length + length - 1) / length;
+            overflow_length = 0;
+        }
+        else
+        {
+            cost_bound += on_hand * cost;
+            overflow_length -= on_hand * length;
+        }
+    }
+
+    if (overflow_length > 0)
+    {
+        return LLONG_MAX;
+    }
+    return (cover_bound > cost_bound) ? cover_bound : cost_bound;
+}
+
+// Creates a solver whose arena is already large enough for inputs of up to initialPieceCapacity pieces
+CutlistSolver *createCutlistSolver(int initialPieceCapacity)
+{
+    CutlistSolver *solver = (CutlistSolver *)calloc(1, sizeof(CutlistSolver));
+    if (!solver) return NULL;
+
+    if (reserveArena(solver, (initialPieceCapacity > 0) ? initialPieceCapacity : 0, 0, 0, 0, 0) != 0)
+    {
+        free(solver);
+        return NULL;
+    }
+
+    resetCutlistSolver(solver);
+    return solver;
+}
+
+// Forgets the previous solve and hands the whole arena back, keeping its memory for the next solve
+void resetCutlistSolver(CutlistSolver *solver)
+{
+    unsigned char *arena_block = solver->arenaBlock;
+    unsigned char *arena = solver->arena;
+    size_t arena_capacity = solver->arenaCapacity;
+
+    memset(&solver->state, 0, sizeof(solver->state));
+    solver->arenaBlock = arena_block;
+    solver->arena = arena;
+    solver->arenaCapacity = arena_capacity;
+    solver->arenaUsed = 0;
+}
+
+void destroyCutlistSolver(CutlistSolver *solver)
+{
+    if (!solver) return;
+
+    destroyCutlistSolver(solver->windowSolver);
+    free(solver->arenaBlock);
+    free(solver);
+}
+
+// Function to optimize the cutlist and minimize waste. Convenience wrapper for a one-off solve
 void optimizeCutlist(CutlistInput input, CutlistResult *result) 
+{
+    CutlistSolver *solver = createCutlistSolver(input.pieceCount);
+    if (!solver)
+    {
+        resetCutlistStats(&result->stats);
+        result->stopReason = CUTLIST_STOP_COMPLETED;
+        failSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+        return;
+    }
+
+    solveCutlist(solver, input, result);
+    destroyCutlistSolver(solver);
+}
+
+// Hands the search's counters to the result, with what is only known once the search is over. searchSeconds is when
+// it ended, and with it the proof of an optimal packing
+static void finishCutlistStats(CutlistSolver *solver, double searchSeconds, int provenOptimal, CutlistStats *stats)
+{
+    PackingState *state = &solver->state;
+
+    *stats = state->stats;
+    stats->nodesExpanded = state->nodeCount;
+    stats->secondsToFirstSolution = (stats->improvementCount > 0) ? stats->improvements[0].seconds : -1.0;
+    stats->secondsToOptimum = provenOptimal ? searchSeconds : -1.0;
+    stats->totalSeconds = getCutlistWallSeconds() - state->startTime;
+    stats->memoryBytes += sizeof(CutlistSolver) + solver->arenaCapacity;
+    if (state->transpositions)
+    {
+        stats->transpositionHits = state->transpositions->hits;
+        stats->transpositionMisses = state->transpositions->misses;
+        stats->transpositionStores = state->transpositions->stores + state->transpositions->replacements;
+    }
+}
+
+// Why the search stopped, once it has
+static CutlistStopReason getStopReason(PackingState *state)
+{
+    if (!state->budgetExhausted)
+    {
+        return CUTLIST_STOP_COMPLETED;
+    }
+    if (state->cancelRequested && atomic_load_explicit(state->cancelRequested, memory_order_relaxed))
+    {
+        return CUTLIST_STOP_CANCELLED;
+    }
+    return ((state->deadline > 0) && (getCutlistWallSeconds() >= state->deadline)) ? CUTLIST_STOP_TIME_LIMIT : CUTLIST_STOP_NODE_LIMIT;
+}
+
+// Optimizes the cutlist using the solver's arena for all working memory. Returns 0 on success, or -1 with
+// stockUsed and waste set to -1 and result->status saying why if the input cannot be cut or the arena cannot grow
+int solveCutlist(CutlistSolver *solver, CutlistInput input, CutlistResult *result) 
+{
+    return solveCutlistFromSeed(solver, input, NULL, result);
+}
+
+// Checks a seed packing against the input, leaving its stocks' loads in remainingStockSpace and the packed length of
+// the pieces in totalLength. Returns 0 if any piece is on a stock out of range or a stock is overfull
+static int isSeedPackingValid(PackingState *state, const CutlistInput *input, const CutlistSeedPacking *seed, long long *totalLength)
+{
+    *totalLength = 0;
+    if ((seed->stockCount < 0) || (seed->stockCount > input->pieceCount))
+    {
+        return 0;
+    }
+
+    memset(state->remainingStockSpace, 0, (size_t)seed->stockCount * sizeof(int));
+    for (int piece_index = 0; piece_index < input->pieceCount; piece_index++)
+    {
+        int stock_index = seed->assignments[piece_index];
+        int piece_size = input->requiredPieces[piece_index] + input->kerfWidth;
+        if ((stock_index < 0) || (stock_index >= seed->stockCount) || (state->remainingStockSpace[stock_index] > state->stockLength - piece_size))
+        {
+            return 0;
+        }
+        state->remainingStockSpace[stock_index] += piece_size;
+        *totalLength += piece_size;
+    }
+    return 1;
+}
+
+// solveCutlist, starting from a packing the caller already has instead of only the greedy ones. seed may be NULL
+int solveCutlistFromSeed(CutlistSolver *solver, CutlistInput input, const CutlistSeedPacking *seed, CutlistResult *result)
 {    
+    double start_time = getCutlistWallSeconds();
+    resetCutlistStats(&result->stats);
+    result->stopReason = CUTLIST_STOP_COMPLETED;
+
+    // Decomposition works on a single stock length, a catalogue is searched piece by piece instead
+    if ((input.strategy == CUTLIST_STRATEGY_DECOMPOSE) && (input.stockTypeCount > 0))
+    {
+        input.strategy = CUTLIST_STRATEGY_BRANCH_AND_BOUND;
+    }
+
+    if ((input.pieceCount < 0) || ((input.pieceCount > 0) && !input.requiredPieces) || (input.stockTypeCount < 0) ||
+        (input.kerfWidth < 0) || (input.trimLength < 0) ||
+        ((seed != NULL) && ((input.stockTypeCount > 0) || ((input.pieceCount > 0) && !seed->assignments))) ||
+        ((input.stockTypeCount > 0) ? (!input.stockTypes || !result->stockTypeOfStock) : (getStockCapacity(&input, input.stockLength) < 0)))
+    {
+        CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nInvalid piece count, stock length, kerf or trim!\n\n");
+        return failSolve(result, CUTLIST_STATUS_INVALID_INPUT);
+    }
+
+    // Lengths from here on are as packed, kerf and trim included. With a catalogue, pieces have to fit the longest
+    // kind of stock on hand
+    int stock_length = getStockCapacity(&input, input.stockLength);
+    int stock_type_count = 0;
+    int cover_length_unit = 0;
+    if (input.stockTypeCount > 0)
+    {
+        stock_length = 0;
+        for (int type_index = 0; type_index < input.stockTypeCount; type_index++)
+        {
+            const CutlistStockType *stock_type = &input.stockTypes[type_index];
+            int capacity = getStockCapacity(&input, stock_type->length);
+            if ((capacity < 0) || (stock_type->cost < 0) || ((stock_type->count < 0) && (stock_type->count != CUTLIST_STOCK_UNLIMITED)))
+            {
+                CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nInvalid stock catalogue!\n\n");
+                return failSolve(result, CUTLIST_STATUS_INVALID_INPUT);
+            }
+
+            if (stock_type->count != 0)
+            {
+                stock_type_count++;
+                stock_length = (capacity > stock_length) ? capacity : stock_length;
+                cover_length_unit = getGreatestCommonDivisor(cover_length_unit, capacity);
+            }
+        }
+
+        if ((stock_type_count == 0) && (input.pieceCount > 0))
+        {
+            CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nNo stock on hand!\n\n");
+            return failSolve(result, CUTLIST_STATUS_INSUFFICIENT_STOCK);
+        }
+    }
+
     // Check if any piece is too large to fit into stock
     for (int currentPiece = 0; currentPiece < input.pieceCount; currentPiece++)
     {
-        if (input.requiredPieces[currentPiece] > input.stockLength)
+        if ((long long)input.requiredPieces[currentPiece] + input.kerfWidth > stock_length)
+        {
+            CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nRequested piece is longer than stock length!\n\n");
+            return failSolve(result, CUTLIST_STATUS_PIECE_TOO_LONG);
+        }
+
+        if (input.requiredPieces[currentPiece] < 0)
+        {
+            CUTLIST_TRACE(input.traceLevel, CUTLIST_TRACE_SUMMARY, "\nRequested piece has a negative length!\n\n");
+            return failSolve(result, CUTLIST_STATUS_NEGATIVE_PIECE);
+        }
+    }
+
+    // Any amount of stock on hand totals a multiple of the lengths' common divisor, so the cheapest way to buy a length
+    // only needs tabulating at those multiples, up to the total length of the pieces
+    int cover_entry_count = 0;
+    if (stock_type_count > 0)
+    {
+        long long total_length = 0;
+        for (int piece_index = 0; piece_index < input.pieceCount; piece_index++)
+        {
+            total_length += (long long)input.requiredPieces[piece_index] + input.kerfWidth;
+        }
+
+        long long entry_count = (total_length + cover_length_unit - 1) / cover_length_unit + 1;
+        cover_entry_count = (entry_count <= CUTLIST_COVER_TABLE_MAX_ENTRIES) ? (int)entry_count : 0;
+    }
+
+    // Only the exact searches use a transposition table, and only the pattern engine and decomposition their scratch,
+    // which share the arena as just one of them runs. Both work on a single stock length, a catalogue is searched
+    // without them
+    long long transposition_entries = 0;
+    size_t pattern_scratch_size = 0;
+    size_t decomposition_scratch_size = 0;
+    if (isExactStrategy(input.strategy))
+    {
+        transposition_entries = (input.options != NULL) ? input.options->transpositionEntries : 0;
+        if (transposition_entries == 0)
+        {
+            transposition_entries = CUTLIST_DEFAULT_TRANSPOSITION_ENTRIES;
+        }
+    }
+    if ((stock_type_count == 0) && ((input.strategy == CUTLIST_STRATEGY_PATTERNS) ||
+                                    ((input.strategy == CUTLIST_STRATEGY_EXACT) && (input.pieceCount >= CUTLIST_PATTERN_MIN_PIECES))))
+    {
+        pattern_scratch_size = getPatternScratchSize(input.pieceCount, stock_length);
+    }
+    if ((stock_type_count == 0) && ((input.strategy == CUTLIST_STRATEGY_DECOMPOSE) ||
+                                    ((input.strategy == CUTLIST_STRATEGY_EXACT) && (input.pieceCount >= CUTLIST_DECOMPOSE_MIN_PIECES))))
+    {
+        decomposition_scratch_size = getDecompositionScratchSize(input.pieceCount);
+    }
+    size_t engine_scratch_size = (pattern_scratch_size > decomposition_scratch_size) ? pattern_scratch_size : decomposition_scratch_size;
+
+    if (reserveArena(solver, input.pieceCount, stock_type_count, cover_entry_count, transposition_entries, engine_scratch_size) != 0)
+    {
+        return failSolve(result, CUTLIST_STATUS_OUT_OF_MEMORY);
+    }
+
+    resetCutlistSolver(solver);
+    PackingState *state = &solver->state;
+
+    // Initialize the state structure with input data
+    state->traceLevel = input.traceLevel;
+    state->totalPieces = input.pieceCount;
+    state->stockLength = stock_length;
+    state->kerfWidth = input.kerfWidth;
+    state->optimalWaste = INT_MAX; // Start with the worst possible waste
+    state->optimalCost = LLONG_MAX;
+    state->currentCost = 0;
+    state->optimalStockCount = input.pieceCount; // Start with an upper bound on stock usage
+    state->currentStockCount = 0; // No stock pieces used at the start
+    state->openedLength = 0;
+    state->optimalPrefixLength = 0; // optimalAssignments shares nothing with the search yet
+    state->stopSearch = 0;
+    state->optimalTask = CUTLIST_NO_TASK; // No packing found yet
+    state->taskIndex = 0; // The serial search is one task covering the whole tree
+    state->sharedIncumbent = NULL;
+    state->nodeCount = 0;
+    state->nodeLimit = (input.options != NULL) ? input.options->nodeLimit : 0;
+    state->startTime = start_time;
+    state->cancelRequested = (input.options != NULL) ? input.options->cancelRequested : NULL;
+    state->onImprovement = (input.options != NULL) ? input.options->onImprovement : NULL;
+    state->userData = (input.options != NULL) ? input.options->userData : NULL;
+    state->stockCost = input.stockLength;
+    state->deadline = ((input.options != NULL) && (input.options->timeLimitSeconds > 0)) ? (start_time + input.options->timeLimitSeconds) : 0;
+    state->budgetExhausted = 0;
+
+    // Carve the buffers for tracking assignments and stock space out of the arena
+    size_t piece_array_size = (size_t)input.pieceCount * sizeof(int);
+    state->optimalAssignments = (int *)allocateFromArena(solver, piece_array_size);
+    state->currentAssignments = (int *)allocateFromArena(solver, piece_array_size);
+    state->remainingStockSpace = (int *)allocateFromArena(solver, piece_array_size);
+    state->remainingPieceLength = (int *)allocateFromArena(solver, piece_array_size + sizeof(int));
+    state->classOfPiece = (int *)allocateFromArena(solver, piece_array_size);
+    state->classSizes = (int *)allocateFromArena(solver, piece_array_size);
+    state->classCounts = (int *)allocateFromArena(solver, piece_array_size);
+    state->classFirstPiece = (int *)allocateFromArena(solver, piece_array_size);
+    state->pieceSizes = (int *)allocateFromArena(solver, piece_array_size);
+    state->sortedToOriginal = (int *)allocateFromArena(solver, piece_array_size);
+    state->searchStack = (SearchFrame *)allocateFromArena(solver, (size_t)input.pieceCount * sizeof(SearchFrame));
+    int *heuristic_scratch;
+    if (stock_type_count > 0)
+    {
+        size_t type_array_size = (size_t)stock_type_count * sizeof(int);
+        heuristic_scratch = (int *)allocateFromArena(solver, (size_t)(input.pieceCount + stock_type_count) * sizeof(int));
+        state->stockTypeLengths = (int *)allocateFromArena(solver, type_array_size);
+        state->stockTypeCosts = (int *)allocateFromArena(solver, type_array_size);
+        state->stockTypeOnHand = (int *)allocateFromArena(solver, type_array_size);
+        state->stockTypeIndex = (int *)allocateFromArena(solver, type_array_size);
+        state->stockTypesByUnitCost = (int *)allocateFromArena(solver, type_array_size);
+        state->currentStockTypes = (int *)allocateFromArena(solver, piece_array_size);
+        state->optimalStockTypes = (int *)allocateFromArena(solver, piece_array_size);
+        state->minCoverCost = (cover_entry_count > 0) ? (long long *)allocateFromArena(solver, (size_t)cover_entry_count * sizeof(long long)) : NULL;
+        state->coverLengthUnit = cover_length_unit;
+        state->coverEntryCount = cover_entry_count;
+        loadStockCatalogue(state, &input);
+    }
+    else
+    {
+        heuristic_scratch = (int *)allocateFromArena(solver, getHeuristicScratchSize(input.pieceCount) * sizeof(int));
+    }
+    TranspositionTable *transposition_table = NULL;
+    void *transposition_entry_memory = NULL;
+    state->transpositions = NULL;
+    if (transposition_entries > 0)
+    {
+        transposition_table = (TranspositionTable *)allocateFromArena(solver, sizeof(TranspositionTable));
+        transposition_entry_memory = allocateFromArena(solver, getTranspositionEntryBytes(transposition_entries));
+    }
+    void *engine_scratch = (engine_scratch_size > 0) ? allocateFromArena(solver, engine_scratch_size) : NULL;
+
+    // A seed packing that meets its lower bound, or the length bound, is already optimal. It is returned as it is,
+    // so a small change to a large order costs a pass over its pieces rather than a sort and a search
+    int seed_lower_bound = 0;
+    if (seed != NULL)
+    {
+        long long total_length = 0;
+        if (!isSeedPackingValid(state, &input, seed, &total_length))
         {
-            // Indicate failure with special flag values
-            result->stockUsed = -1;
-            result->waste = -1;
-            printf("\nRequested piece is longer than stock length!\n\n");
-            return;
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "\nSeed packing does not fit the input!\n\n");
+            finishCutlistStats(solver, 0.0, 0, &result->stats);
+            return failSolve(result, CUTLIST_STATUS_INVALID_INPUT);
+        }
+        memset(state->remainingStockSpace, 0, piece_array_size);
+
+        long long length_bound = (total_length + stock_length - 1) / stock_length;
+        seed_lower_bound = (seed->stockLowerBound > length_bound) ? seed->stockLowerBound : (int)length_bound;
+        if (seed->stockCount <= seed_lower_bound)
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Seed packing matches the lower bound: Stock Used = %d\n\n", seed->stockCount);
+            int waste = (int)((long long)seed->stockCount * stock_length - total_length);
+            recordCutlistImprovement(state, 0, seed->stockCount, waste, 0);
+
+            result->status = CUTLIST_STATUS_OK;
+            result->stockUsed = seed->stockCount;
+            result->waste = waste;
+            result->cost = (long long)seed->stockCount * input.stockLength;
+            result->stockLowerBound = seed->stockCount;
+            result->provenOptimal = 1;
+            result->optimalityGap = 0.0;
+            if ((input.pieceCount > 0) && (result->assignments != seed->assignments))
+            {
+                memcpy(result->assignments, seed->assignments, piece_array_size);
+            }
+            finishCutlistStats(solver, getCutlistWallSeconds() - start_time, 1, &result->stats);
+            return 0;
         }
     }
 
-    PackingState state;
+    // Sort a private copy of the pieces in descending order (Largest First) to improve efficiency, remembering
+    // where each one came from so the caller's array is never touched. optimalAssignments is not written until the
+    // search runs, so it doubles as the sort's scratch buffer
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nSorting pieces in descending order:\n");
+    sortPiecesDescending(input.requiredPieces, input.pieceCount, stock_length, state->sortedToOriginal, state->optimalAssignments);
+    for (int piece_index = 0; piece_index < input.pieceCount; piece_index++)
+    {
+        state->pieceSizes[piece_index] = input.requiredPieces[state->sortedToOriginal[piece_index]] + input.kerfWidth;
+    }
 
-    // Initialize the state structure with input data
-    state.totalPieces = input.pieceCount;
-    state.stockLength = input.stockLength;
-    state.pieceSizes = input.requiredPieces;
-    state.optimalWaste = INT_MAX; // Start with the worst possible waste
-    state.optimalStockCount = input.pieceCount; // Start with an upper bound on stock usage
-    state.currentStockCount = 0; // No stock pieces used at the start
+    // Print sorted pieces
+    if (CUTLIST_TRACING(state->traceLevel, CUTLIST_TRACE_FULL))
+    {
+        for (int currentPiece = 0; currentPiece < input.pieceCount; currentPiece++)
+        {
+            printf("Piece %d: %d\n", (currentPiece + 1), state->pieceSizes[currentPiece] - state->kerfWidth);
+        }
+        printf("\n");
+    }
+
+    // Group identical lengths into (size, multiplicity) classes. Sorting makes each class a contiguous run of pieces
+    state->pieceClassCount = 0;
+    for (int piece_index = 0; piece_index < input.pieceCount; piece_index++)
+    {
+        if ((piece_index == 0) || (state->pieceSizes[piece_index] != state->pieceSizes[piece_index - 1]))
+        {
+            state->classSizes[state->pieceClassCount] = state->pieceSizes[piece_index];
+            state->classCounts[state->pieceClassCount] = 0;
+            state->classFirstPiece[state->pieceClassCount] = piece_index;
+            state->pieceClassCount++;
+        }
+        state->classOfPiece[piece_index] = state->pieceClassCount - 1;
+        state->classCounts[state->pieceClassCount - 1]++;
+    }
+
+    if (CUTLIST_TRACING(state->traceLevel, CUTLIST_TRACE_SUMMARY))
+    {
+        printf("Piece classes:\n");
+        for (int class_index = 0; class_index < state->pieceClassCount; class_index++)
+        {
+            printf("Class %d: %d x %d\n", (class_index + 1), state->classCounts[class_index], state->classSizes[class_index]);
+        }
+        printf("\n");
+    }
+
+    // Suffix sums of the sorted pieces give the length still to be placed at every depth of the search
+    state->remainingPieceLength[input.pieceCount] = 0;
+    for (int piece_index = input.pieceCount - 1; piece_index >= 0; piece_index--)
+    {
+        state->remainingPieceLength[piece_index] = state->remainingPieceLength[piece_index + 1] + state->pieceSizes[piece_index];
+    }
+
+    // No packing can use fewer stocks than the root lower bound, so the search stops as soon as it reaches it. With a
+    // catalogue the bound is on cost instead, and the stock bound only counts stocks of the longest kind
+    state->rootLowerBound = 0;
+    state->rootCostLowerBound = 0;
+    if (input.pieceCount > 0)
+    {
+        state->rootLowerBound = computeL2Bound(state->classSizes, state->classCounts, state->pieceClassCount, state->classCounts[0],
+                                               NULL, 0, state->classSizes[state->pieceClassCount - 1], stock_length);
+        state->rootCostLowerBound = (stock_type_count > 0) ? computeNodeCostLowerBound(state, 0) : (long long)state->rootLowerBound * input.stockLength;
+    }
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Lower bound on stock used: %d\n", state->rootLowerBound);
+    if (stock_type_count > 0)
+    {
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Lower bound on cost: %lld\n", state->rootCostLowerBound);
+    }
 
-    // Allocate memory for tracking assignments and stock space
-    state.optimalAssignments = (int *)malloc(input.pieceCount * sizeof(int));
-    state.currentAssignments = (int *)malloc(input.pieceCount * sizeof(int));
-    state.remainingStockSpace = (int *)malloc(input.pieceCount * sizeof(int));
+    // Greedy packings give an answer straight away: on their own for the fast strategies, or as the incumbent the
+    // exact search starts from and falls back to if its budget runs out
+    seedWithGreedyPacking(state, input.strategy, heuristic_scratch);
 
-    // Sort pieces in descending order (Largest First) to improve efficiency
-    printf("\nSorting pieces in descending order:\n");
-    for (int first_piece = 0; first_piece < input.pieceCount - 1; first_piece++) 
+    // The caller's packing, and the bound it came with, replace the greedy ones when they are better. Like the
+    // greedy packing it keeps CUTLIST_NO_TASK, so the search still replaces it with a packing just as good
+    if (seed != NULL)
     {
-        for (int second_piece = first_piece + 1; second_piece < input.pieceCount; second_piece++) 
+        if (seed_lower_bound > state->rootLowerBound)
+        {
+            state->rootLowerBound = seed_lower_bound;
+            state->rootCostLowerBound = (long long)seed_lower_bound * input.stockLength;
+        }
+        if (seed->stockCount < state->optimalStockCount)
         {
-            if (input.requiredPieces[first_piece] < input.requiredPieces[second_piece]) 
+            for (int piece_index = 0; piece_index < input.pieceCount; piece_index++)
             {
-                // Swap elements to ensure descending order
-                int temp_size = input.requiredPieces[first_piece];
-                input.requiredPieces[first_piece] = input.requiredPieces[second_piece];
-                input.requiredPieces[second_piece] = temp_size;
+                state->optimalAssignments[piece_index] = seed->assignments[state->sortedToOriginal[piece_index]];
             }
+            state->optimalStockCount = seed->stockCount;
+            state->optimalWaste = seed->stockCount * stock_length - state->remainingPieceLength[0];
+            state->optimalTask = CUTLIST_NO_TASK;
+            recordCutlistImprovement(state, 0, seed->stockCount, state->optimalWaste, 0);
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Seed packing: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
         }
     }
+    int search_finished = (stock_type_count > 0) ? (state->optimalCost <= state->rootCostLowerBound) :
+                                                   (state->optimalStockCount <= state->rootLowerBound);
 
-    // Print sorted pieces
-    for (int currentPiece = 0; currentPiece < input.pieceCount; currentPiece++)
+    // Start searching for the best packing configuration, splitting the tree across threads when asked to.
+    // The parallel search falls back to the serial one if it cannot set up its workers
+    if (isSearchStrategy(input.strategy) && !search_finished)
+    {
+        // Clearing the table costs a pass over it, so it is only done for a search that actually runs
+        if (transposition_table)
+        {
+            initTranspositionTable(transposition_table, transposition_entry_memory, transposition_entries);
+            state->transpositions = transposition_table;
+        }
+
+        // Few distinct lengths in a big order suit the pattern engine, many thousand pieces of many lengths
+        // decomposition, anything else the piece-by-piece search. The pattern engine may also raise the root lower
+        // bound, with its LP bound
+        int use_patterns = (pattern_scratch_size > 0) && isPatternEngineEligible(state) &&
+                           ((input.strategy == CUTLIST_STRATEGY_PATTERNS) || isPatternEngineCheaper(state));
+        int use_decomposition = !use_patterns && (decomposition_scratch_size > 0);
+        if (stock_type_count > 0)
+        {
+            findBestPacking(state, 0);
+        }
+        else if (use_patterns)
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Searching cutting patterns.\n\n");
+            findBestPackingByPatterns(state, engine_scratch);
+        }
+        else if (use_decomposition)
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Searching windows of the least-filled stocks.\n\n");
+            findBestPackingByDecomposition(state, &solver->windowSolver, engine_scratch);
+        }
+        else if ((input.threadCount <= 1) || (findBestPackingParallel(state, input.threadCount) != 0))
+        {
+            findBestPacking(state, 0);
+        }
+        // Decomposition only proves a packing that meets the lower bound
+        search_finished = use_decomposition ? (state->optimalStockCount <= state->rootLowerBound) : !state->budgetExhausted;
+
+        if (state->transpositions)
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Transposition table: %lld hits, %lld misses, %lld stores, %lld replacements\n\n",
+                          state->transpositions->hits, state->transpositions->misses, state->transpositions->stores,
+                          state->transpositions->replacements);
+        }
+    }
+    double search_seconds = getCutlistWallSeconds() - state->startTime;
+
+    // Neither the greedy packings nor the search fitted the pieces into the stock on hand
+    if ((stock_type_count > 0) && (state->optimalCost == LLONG_MAX))
     {
-        printf("Piece %d: %d\n", (currentPiece + 1), input.requiredPieces[currentPiece]);
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "\nNo packing fits the stock on hand!\n\n");
+        finishCutlistStats(solver, search_seconds, 0, &result->stats);
+        result->stopReason = getStopReason(state);
+        return failSolve(result, CUTLIST_STATUS_INSUFFICIENT_STOCK);
     }
-    printf("\n");
 
-    // Start searching for the best packing configuration
-    findBestPacking(&state, 0);
+    // Store the best result in the output structure. An exhausted search proves its packing optimal, otherwise only
+    // the root lower bound is known. The pattern engine may have raised the stock bound, and with it the cost bound
+    long long cost = state->optimalCost;
+    long long cost_lower_bound = state->rootCostLowerBound;
+    if (stock_type_count == 0)
+    {
+        cost = (long long)state->optimalStockCount * input.stockLength;
+        cost_lower_bound = (long long)state->rootLowerBound * input.stockLength;
+    }
 
-    // Store the best result in the output structure
-    result->stockUsed = state.optimalStockCount;
-    result->waste = state.optimalWaste;
+    result->status = CUTLIST_STATUS_OK;
+    result->stockUsed = state->optimalStockCount;
+    result->waste = state->optimalWaste;
+    result->cost = cost;
+    result->stockLowerBound = state->rootLowerBound;
+    result->provenOptimal = search_finished;
+    result->stopReason = getStopReason(state);
+    result->optimalityGap = 0.0;
+    if (!search_finished && (cost > 0))
+    {
+        result->optimalityGap = (double)(cost - cost_lower_bound) / cost;
+    }
     
-    // Copy the best piece assignments
+    // Copy the best piece assignments back into the caller's piece order, and the kind of every stock into the
+    // caller's catalogue order
     for (int piece_index = 0; piece_index < input.pieceCount; piece_index++) 
     {
-        result->assignments[piece_index] = state.optimalAssignments[piece_index];
+        result->assignments[state->sortedToOriginal[piece_index]] = state->optimalAssignments[piece_index];
+    }
+    for (int stock_index = 0; (stock_type_count > 0) && (stock_index < state->optimalStockCount); stock_index++)
+    {
+        result->stockTypeOfStock[stock_index] = state->stockTypeIndex[state->optimalStockTypes[stock_index]];
+    }
+
+    if (CUTLIST_TRACING(state->traceLevel, CUTLIST_TRACE_SUMMARY))
+    {
+        printf("\nBest Packing Found: Stock Used = %d, Waste = %d\n\n\n\n\n", result->stockUsed, result->waste);
+        writeStockAssignments(stdout, state->pieceSizes, state->kerfWidth, state->optimalAssignments, state->totalPieces, state->optimalStockCount);
     }
 
-    printf("\nBest Packing Found: Stock Used = %d, Waste = %d\n\n\n\n\n", result->stockUsed, result->waste);
-    char *output = getStockAssignmentsAsString(&state);
-    printf("%s", output);
-    free(output);
+    finishCutlistStats(solver, search_seconds, search_finished, &result->stats);
+    return 0;
+}
+
+// Martello-Toth L2 lower bound on the number of stocks needed to cut every item. Items are runs of equal pieces sorted
+// by descending size (runCounts of NULL means one piece per run, firstRunCount overrides the count of the first run),
+// plus one item per already-opened stock, sized by how much of that stock is already used up
+int computeL2Bound(const int *runSizes, const int *runCounts, int runCount, int firstRunCount,
+                   const int *openStockSpace, int openStockCount, int smallestPiece, int stockLength)
+{
+    int best_bound = 0;
+    int previous_threshold = -1;
+
+    // Every threshold k in [0, stockLength / 2] gives a valid bound; only the distinct piece sizes (and 0) can change it
+    for (int candidate_index = -1; candidate_index < runCount; candidate_index++)
+    {
+        int threshold = (candidate_index < 0) ? 0 : runSizes[candidate_index];
+        if (((long long)threshold * 2 > stockLength) || (threshold == previous_threshold))
+        {
+            continue;
+        }
+        previous_threshold = threshold;
+
+        long long large_count = 0;     // Items that cannot share a stock with any item of size >= threshold
+        long long medium_count = 0;    // Items longer than half a stock, one per stock
+        long long medium_length = 0;
+        long long small_length = 0;    // Items between threshold and half a stock
+
+        for (int item_index = 0; item_index < runCount + openStockCount; item_index++)
+        {
+            int item_size;
+            long long item_count;
+            if (item_index < runCount)
+            {
+                item_size = runSizes[item_index];
+                item_count = (item_index == 0) ? firstRunCount : ((runCounts == NULL) ? 1 : runCounts[item_index]);
+            }
+            else
+            {
+                // Space left on an open stock that no remaining piece fits into is as good as used
+                int stock_space = openStockSpace[item_index - runCount];
+                item_size = (stock_space < smallestPiece) ? stockLength : (stockLength - stock_space);
+                item_count = 1;
+            }
+
+            if (item_size > stockLength - threshold)
+            {
+                large_count += item_count;
+            }
+            else if ((long long)item_size * 2 > stockLength)
+            {
+                medium_count += item_count;
+                medium_length += item_count * item_size;
+            }
+            else if (item_size >= threshold)
+            {
+                small_length += item_count * item_size;
+            }
+        }
+
+        // Small items have to go into whatever space the medium items leave behind, or into new stocks
+        long long overflow_length = small_length - (medium_count * stockLength - medium_length);
+        long long bound = large_count + medium_count;
+        if (overflow_length > 0)
+        {
+            bound += (overflow_length + stockLength - 1) / stockLength;
+        }
+
+        if (bound > best_bound)
+        {
+            best_bound = (int)bound;
+        }
+    }
 
-    // Free dynamically allocated memory
-    free(state.optimalAssignments);
-    free(state.currentAssignments);
-    free(state.remainingStockSpace);
+    return best_bound;
 }
 
-// Depth-First Recursive Search Traversal to find best packing of pieces onto stocks. Explores all enumerations, O(n!) runtime
-void findBestPacking(PackingState *state, int currentPieceIndex) 
+// Lower bound on the number of stocks needed to cut all pieces, pieces must be sorted in descending order
+int computeStockLowerBound(const int *sortedPieces, int pieceCount, int stockLength)
+{
+    if (pieceCount <= 0)
+    {
+        return 0;
+    }
+
+    return computeL2Bound(sortedPieces, NULL, pieceCount, 1, NULL, 0, sortedPieces[pieceCount - 1], stockLength);
+}
+
+// Returns 1 if a packing with this much waste would replace the best packing found so far. Equal waste only wins
+// when found in an earlier task, so every thread count keeps the packing the serial search would find first
+static int beatsIncumbent(PackingState *state, long long waste)
 {
-    printf("\nFIND BEST PACKING RECURSIVE CALL\n");
+    if (state->sharedIncumbent)
+    {
+        return beatsSharedIncumbent(state->sharedIncumbent, waste, state->taskIndex);
+    }
 
-    // Base Case: If all pieces have been assigned to a stock, evaluate solution for amount of stock used and total waste
-    if (currentPieceIndex == state->totalPieces) 
+    return (waste < state->optimalWaste) || ((waste == state->optimalWaste) && (state->taskIndex < state->optimalTask));
+}
+
+// Returns 1 if a packing of this cost would replace the best packing found so far, for a search over a stock catalogue.
+// Ties go to the earlier task, as they do on waste
+static int beatsIncumbentCost(PackingState *state, long long cost)
+{
+    return (cost < state->optimalCost) || ((cost == state->optimalCost) && (state->taskIndex < state->optimalTask));
+}
+
+// Returns 1 if the search has used up its node or time budget, or the solve was cancelled. Only called every CUTLIST_BUDGET_CHECK_INTERVAL nodes,
+// so reading the clock stays off the hot path
+int isSearchBudgetExhausted(PackingState *state)
+{
+    if (state->sharedIncumbent)
+    {
+        return chargeSharedSearchBudget(state->sharedIncumbent, CUTLIST_BUDGET_CHECK_INTERVAL, state->nodeLimit, state->deadline,
+                                        state->cancelRequested);
+    }
+
+    return ((state->nodeLimit > 0) && (state->nodeCount >= state->nodeLimit)) ||
+           (state->cancelRequested && atomic_load_explicit(state->cancelRequested, memory_order_relaxed)) ||
+           ((state->deadline > 0) && (getCutlistWallSeconds() >= state->deadline));
+}
+
+// Waste of the best packing found so far, INT_MAX if there is none yet
+static long long getIncumbentWaste(PackingState *state)
+{
+    if (state->sharedIncumbent)
+    {
+        return getSharedIncumbentWaste(state->sharedIncumbent);
+    }
+
+    return state->optimalWaste;
+}
+
+// Returns 1 once any packing is known, before that no bound can prune anything
+static int hasIncumbent(PackingState *state)
+{
+    return getIncumbentWaste(state) != INT_MAX;
+}
+
+// Returns 1 if a packing using lowerBound stocks could still replace the best packing found so far
+static int canImproveOnBest(PackingState *state, int lowerBound)
+{
+    long long lower_bound_waste = (long long)lowerBound * state->stockLength - state->remainingPieceLength[0];
+    return beatsIncumbent(state, lower_bound_waste);
+}
+
+// Lower bound on the total stocks any completion of the current partial packing will use
+static int computeNodeLowerBound(PackingState *state, int currentPieceIndex)
+{
+    // Pieces are sorted in descending order, so the last piece is the smallest one left to place
+    int smallest_piece = state->pieceSizes[state->totalPieces - 1];
+
+    // Space on open stocks that is too small for any remaining piece can never be used again
+    long long usable_space = sumFittingStockSpace(state->remainingStockSpace, state->currentStockCount, smallest_piece);
+
+    int lower_bound = state->currentStockCount;
+    long long overflow_length = state->remainingPieceLength[currentPieceIndex] - usable_space;
+    if (overflow_length > 0)
+    {
+        lower_bound += (int)((overflow_length + state->stockLength - 1) / state->stockLength);
+    }
+
+    // The L2 bound costs a pass over the remaining classes per distinct size, so only pay for it when it could prune
+    if (canImproveOnBest(state, lower_bound) && hasIncumbent(state))
     {
-        printf("ALL PIECES PLACED. EVALUATING SOLUTION\n\n");
-        int total_waste = 0;
-        // Add up all waste on all stocks for total value
-        for (int stock_index = 0; stock_index < state->currentStockCount; stock_index++) 
+        // Remaining pieces are the tail of the current piece's class followed by every later class
+        int first_class = state->classOfPiece[currentPieceIndex];
+        int first_class_remaining = state->classFirstPiece[first_class] + state->classCounts[first_class] - currentPieceIndex;
+        int l2_bound = computeL2Bound(&state->classSizes[first_class], &state->classCounts[first_class],
+                                      state->pieceClassCount - first_class, first_class_remaining,
+                                      state->remainingStockSpace, state->currentStockCount, smallest_piece, state->stockLength);
+        if (l2_bound > lower_bound)
         {
-            total_waste += state->remainingStockSpace[stock_index];
+            lower_bound = l2_bound;
         }
+    }
+
+    return lower_bound;
+}
+
+// Identical pieces are interchangeable, so a piece only tries stocks at or after the one the previous identical piece
+// went into. Returns the first stock index worth trying for the piece
+int getFirstCandidateStock(PackingState *state, int currentPieceIndex)
+{
+    if ((currentPieceIndex > 0) && (state->classOfPiece[currentPieceIndex] == state->classOfPiece[currentPieceIndex - 1]))
+    {
+        return state->currentAssignments[currentPieceIndex - 1];
+    }
+    return 0;
+}
+
+// Stocks with the same remaining space are interchangeable, so only the first one tried at a level matters.
+// Returns 1 if a stock in [firstStock, stockIndex) has the same remaining space as stockIndex
+int isEquivalentStockTried(PackingState *state, int firstStock, int stockIndex)
+{
+    return containsStockSpace(state->remainingStockSpace, firstStock, stockIndex, state->remainingStockSpace[stockIndex]);
+}
+
+// Enters the search node where currentPieceIndex is next to place: counts it, evaluates a complete packing, and prunes.
+// Returns 1 with the piece's frame ready if the node has placements to try, 0 if it is done with
+static int openSearchNode(PackingState *state, int currentPieceIndex)
+{
+    // A packing matching the root lower bound has already been found, nothing left can beat it
+    if (state->stopSearch)
+    {
+        return 0;
+    }
+
+    // Out of budget: unwind and keep the best packing found so far
+    state->nodeCount++;
+    if (((state->nodeCount & (CUTLIST_BUDGET_CHECK_INTERVAL - 1)) == 0) && isSearchBudgetExhausted(state))
+    {
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Search budget exhausted after %lld nodes.\n\n", state->nodeCount);
+        state->budgetExhausted = 1;
+        state->stopSearch = 1;
+        return 0;
+    }
 
-        printf("\nEvaluating solution: Stock Used = %d, Waste = %d\n\n", state->currentStockCount, total_waste);
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nFIND BEST PACKING: NEW SEARCH NODE\n");
+    if (currentPieceIndex > state->stats.maxDepth)
+    {
+        state->stats.maxDepth = currentPieceIndex;
+    }
+
+    // Base Case: If all pieces have been assigned to a stock, evaluate solution for amount of stock used and total waste
+    if (currentPieceIndex == state->totalPieces) 
+    {
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "ALL PIECES PLACED. EVALUATING SOLUTION\n\n");
+        // Every piece is packed, so the waste is whatever of the open stocks the pieces do not fill
+        int total_waste = (int)(state->openedLength - state->remainingPieceLength[0]);
 
-        // Replace existing best solution with currently evaluated solution if it has less total waste
-        if (total_waste < state->optimalWaste) 
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nEvaluating solution: Stock Used = %d, Waste = %d\n\n", state->currentStockCount, total_waste);
+
+        // Replace existing best solution with currently evaluated solution if it has less total waste, or with a
+        // catalogue if it costs less
+        int improves = (state->stockTypeCount > 0) ? beatsIncumbentCost(state, state->currentCost) : beatsIncumbent(state, total_waste);
+        if (improves) 
         {
             state->optimalWaste = total_waste;
             state->optimalStockCount = state->currentStockCount;
+            state->optimalTask = state->taskIndex;
+
+            // Pieces before optimalPrefixLength have not moved since the last improvement, so only the rest is copied
+            memcpy(&state->optimalAssignments[state->optimalPrefixLength], &state->currentAssignments[state->optimalPrefixLength],
+                   (size_t)(state->totalPieces - state->optimalPrefixLength) * sizeof(int));
+            state->optimalPrefixLength = state->totalPieces;
+            if (state->stockTypeCount > 0)
+            {
+                state->optimalCost = state->currentCost;
+                memcpy(state->optimalStockTypes, state->currentStockTypes, (size_t)state->currentStockCount * sizeof(int));
+            }
 
-            for (int piece_index = 0; piece_index < state->totalPieces; piece_index++) 
+            // Let the other workers of a parallel solve prune against it straight away. It is only an improvement
+            // of the solve's best packing if it still beats theirs, which publishing decides
+            if (state->sharedIncumbent)
+            {
+                publishIncumbent(state->sharedIncumbent, total_waste, state->taskIndex, state->currentAssignments,
+                                 state->currentStockCount, state->totalPieces);
+            }
+            else
             {
-                state->optimalAssignments[piece_index] = state->currentAssignments[piece_index];
+                recordCutlistImprovement(state, state->nodeCount, state->currentStockCount, total_waste, state->currentCost);
             }
 
             // Print out best case every time one is found
-            printf("New Best Found: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
-            char *output = getStockAssignmentsAsString(state);
-            printf("%s", output);
-            free(output);
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "New Best Found: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
+            traceStockAssignments(state, CUTLIST_TRACE_FULL);
+
+            // Nothing can use fewer stocks (or cost less) than the root lower bound, so this packing is proven optimal
+            if ((state->stockTypeCount > 0) ? (state->optimalCost <= state->rootCostLowerBound) : (state->optimalStockCount <= state->rootLowerBound))
+            {
+                CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Best packing matches the lower bound. Search complete.\n\n");
+                state->stopSearch = 1;
+            }
         }
-        return;
+        return 0;
     }
     else
     {
-        printf("CURRENT PIECE BEING PLACED: %u\n\n", (currentPieceIndex + 1));
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "CURRENT PIECE BEING PLACED: %u\n\n", (currentPieceIndex + 1));
     }
 
-    // Pruning: Stop early if currently evaluated case is already worse than best known case
-    if ((state->currentStockCount) > state->optimalStockCount) 
+    // Pruning: Stop early if no way of placing the remaining pieces can beat the best known case
+    if (state->stockTypeCount > 0)
     {
-        printf("\nCurrent case being evaluated is the same or worse than best known solution. Skipping...\n\n");
-        return;
+        long long cost_bound = computeNodeCostLowerBound(state, currentPieceIndex);
+        if ((cost_bound == LLONG_MAX) || !beatsIncumbentCost(state, cost_bound))
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nCurrent case costs at least %lld, the same or worse than best known solution. Skipping...\n\n", cost_bound);
+            state->stats.prunes[CUTLIST_PRUNE_LOWER_BOUND]++;
+            return 0;
+        }
+    }
+    else
+    {
+        int lower_bound = computeNodeLowerBound(state, currentPieceIndex);
+        if (!canImproveOnBest(state, lower_bound)) 
+        {
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nCurrent case needs at least %d stocks, the same or worse than best known solution. Skipping...\n\n", lower_bound);
+            state->stats.prunes[CUTLIST_PRUNE_LOWER_BOUND]++;
+            return 0;
+        }
     }
 
+    // Pruning: Stop early if the same state was reached through other placements and searched to a bound that cannot
+    // beat the best known case. Which stocks are open and how full does not depend on the order they were filled in
+    SearchFrame *frame = &state->searchStack[currentPieceIndex];
+    int first_stock = getFirstCandidateStock(state, currentPieceIndex);
+    uint64_t state_key = 0;
+    if (state->transpositions)
+    {
+        // With a catalogue the state also covers the stock still on hand, and the bound is on the cost still to pay
+        int stock_bound;
+        if (state->stockTypeCount > 0)
+        {
+            state_key = hashCatalogueSearchState(state->remainingStockSpace, state->currentStockCount, first_stock,
+                                                 state->pieceSizes[state->totalPieces - 1], currentPieceIndex,
+                                                 state->stockTypeOnHand, state->stockTypeCount);
+            if (probeTransposition(state->transpositions, state_key, &stock_bound) && !beatsIncumbentCost(state, state->currentCost + stock_bound))
+            {
+                CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nEquivalent state already searched, costs at least %d more. Skipping...\n\n", stock_bound);
+                state->stats.prunes[CUTLIST_PRUNE_TRANSPOSITION]++;
+                return 0;
+            }
+        }
+        else
+        {
+            state_key = hashSearchState(state->remainingStockSpace, state->currentStockCount, first_stock,
+                                        state->pieceSizes[state->totalPieces - 1], currentPieceIndex);
+            if (probeTransposition(state->transpositions, state_key, &stock_bound) && !canImproveOnBest(state, stock_bound))
+            {
+                CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nEquivalent state already searched, needs at least %d stocks. Skipping...\n\n", stock_bound);
+                state->stats.prunes[CUTLIST_PRUNE_TRANSPOSITION]++;
+                return 0;
+            }
+        }
+    }
+
+    // The piece tries the open stocks from first_stock on, a block at a time, then new stocks
+    frame->stateKey = state_key;
+    frame->firstStock = first_stock;
+    frame->blockStart = first_stock;
+    frame->fittingStocks = (first_stock < state->currentStockCount) ?
+                           getFittingStockMask(state->remainingStockSpace, first_stock, state->currentStockCount, state->pieceSizes[currentPieceIndex]) : 0;
+    frame->nextType = -1;
+    frame->previousLength = 0;
+    frame->placedStock = -1;
+    return 1;
+}
+
+// Places the piece where its frame says to try next. Returns 1 with the piece placed, 0 once every placement is tried
+static int placeNextCandidate(PackingState *state, int currentPieceIndex, SearchFrame *frame)
+{
     // Grab size of piece currently being placed
     int current_piece_size = state->pieceSizes[currentPieceIndex];
 
-    // Try placing piece into any existing stock
-    for (int stock_index = 0; (stock_index < state->currentStockCount); stock_index++) 
+    // Try placing piece into any existing stock. The stocks with room for it are found a block at a time with one
+    // vector compare; children restore every stock they touch, so a block's mask stays valid across its children
+    while (frame->nextType < 0)
     {
-        // Only place piece if there's room for it in the existing stock
-        if (state->remainingStockSpace[stock_index] >= current_piece_size) 
+        if (frame->fittingStocks == 0)
         {
-            printf("%-20s | Stock #%2d | Piece #%2d (size: %3d) | Remaining Space in Stock #%2d: %3d\n",
-               "Placing piece", (stock_index + 1), (currentPieceIndex + 1), current_piece_size,
-               (stock_index + 1), (state->remainingStockSpace[stock_index] - current_piece_size));
+            frame->blockStart += CUTLIST_STOCK_MASK_WIDTH;
+            if (frame->blockStart >= state->currentStockCount)
+            {
+                frame->nextType = 0;
+                break;
+            }
+            frame->fittingStocks = getFittingStockMask(state->remainingStockSpace, frame->blockStart, state->currentStockCount, current_piece_size);
+            continue;
+        }
 
-            state->remainingStockSpace[stock_index] -= current_piece_size;
-            state->currentAssignments[currentPieceIndex] = stock_index;
+        int stock_index = frame->blockStart + getLowestSetBit(frame->fittingStocks);
+        frame->fittingStocks &= frame->fittingStocks - 1;
 
-            // Print out current state of stocks and which pieces are cut from them
-            char *output = getStockAssignmentsAsString(state);
-            printf("%s", output);
-            free(output);
+        // Only place piece if no equivalent stock was already tried
+        if (isEquivalentStockTried(state, frame->firstStock, stock_index)) 
+        {
+            state->stats.prunes[CUTLIST_PRUNE_SYMMETRY]++;
+            continue;
+        }
 
-            // Recursive call: find placement of next piece
-            findBestPacking(state, currentPieceIndex + 1);
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "%-20s | Stock #%2d | Piece #%2d (size: %3d) | Remaining Space in Stock #%2d: %3d\n",
+           "Placing piece", (stock_index + 1), (currentPieceIndex + 1), current_piece_size,
+           (stock_index + 1), (state->remainingStockSpace[stock_index] - current_piece_size));
 
-            // Backtrack: Remove piece to try placing it somewhere else to see if it leads to a more efficient packing
-            printf("BACKTRACKING: Removing piece %d (size %d) from Stock #%d to try for a more optimal placement...\n", 
-                   currentPieceIndex, current_piece_size, (stock_index + 1));
+        state->remainingStockSpace[stock_index] -= current_piece_size;
+        state->currentAssignments[currentPieceIndex] = stock_index;
+        frame->placedStock = stock_index;
 
-            // Restore space on stock after having backtracked piece off of it
-            state->remainingStockSpace[stock_index] += current_piece_size;
+        // Print out current state of stocks and which pieces are cut from them
+        traceStockAssignments(state, CUTLIST_TRACE_FULL);
+        return 1;
+    }
 
-            // Explicitly mark piece as unassigned
-            state->currentAssignments[currentPieceIndex] = -1;
+    // Open a new stock if needed. Without a catalogue every new stock is stockLength long; with one, every kind on hand
+    // that fits the piece is tried, longest first, but only the cheapest kind left of each length
+    int new_stock_kinds = (state->stockTypeCount > 0) ? state->stockTypeCount : 1;
+    while (frame->nextType < new_stock_kinds)
+    {
+        int type_index = frame->nextType++;
+        int stock_length = state->stockLength;
+        if (state->stockTypeCount > 0)
+        {
+            stock_length = state->stockTypeLengths[type_index];
+            if (stock_length < current_piece_size)
+            {
+                frame->nextType = new_stock_kinds;
+                break;
+            }
+            if (state->stockTypeOnHand[type_index] == 0)
+            {
+                continue;
+            }
+            if (stock_length == frame->previousLength)
+            {
+                state->stats.prunes[CUTLIST_PRUNE_SYMMETRY]++;
+                continue;
+            }
 
-            // Print updated stock assignments AFTER removing the piece
-            printf("\nUpdated Stock Assignments after Backtracking:\n");
-            output = getStockAssignmentsAsString(state);
-            printf("%s", output);
-            free(output);
+            frame->previousLength = stock_length;
+            state->stockTypeOnHand[type_index]--;
+            state->currentStockTypes[state->currentStockCount] = type_index;
+            state->currentCost += state->stockTypeCosts[type_index];
         }
+
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "%-20s | Stock #%2d | Piece #%2d (size: %3d) | Remaining Space in Stock #%2d: %3d\n",
+           "Starting new stock", (state->currentStockCount + 1), (currentPieceIndex + 1), current_piece_size,
+           (state->currentStockCount + 1), (stock_length - current_piece_size));
+
+        // Reduce available space on new stock by length of piece added to it
+        state->remainingStockSpace[state->currentStockCount] = stock_length - current_piece_size;
+
+        // Record current piece's stock number assignment
+        state->currentAssignments[currentPieceIndex] = state->currentStockCount;
+        frame->placedStock = state->currentStockCount;
+
+        // Increase the total number of stocks used
+        state->currentStockCount++;
+        state->openedLength += stock_length;
+
+        traceStockAssignments(state, CUTLIST_TRACE_FULL);
+        return 1;
     }
 
-    // Open a new stock if needed
-    printf("%-20s | Stock #%2d | Piece #%2d (size: %3d) | Remaining Space in Stock #%2d: %3d\n",
-       "Starting new stock", (state->currentStockCount + 1), (currentPieceIndex + 1), current_piece_size,
-       (state->currentStockCount + 1), (state->stockLength - current_piece_size));
+    return 0;
+}
+
+// Takes the piece back off the stock placeNextCandidate put it on, closing the stock if it was opened for the piece
+static void undoPlacement(PackingState *state, int currentPieceIndex, SearchFrame *frame)
+{
+    int current_piece_size = state->pieceSizes[currentPieceIndex];
+    int stock_index = frame->placedStock;
 
-    // Reduce available space on new stock by length of piece added to it
-    state->remainingStockSpace[state->currentStockCount] = state->stockLength - current_piece_size;
+    // The piece is leaving the stock the best packing may also have it on
+    if (currentPieceIndex < state->optimalPrefixLength)
+    {
+        state->optimalPrefixLength = currentPieceIndex;
+    }
 
-    // Record current piece's stock number assignment
-    state->currentAssignments[currentPieceIndex] = state->currentStockCount;
+    if (frame->nextType < 0)
+    {
+        // Backtrack: Remove piece to try placing it somewhere else to see if it leads to a more efficient packing
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "BACKTRACKING: Removing piece %d (size %d) from Stock #%d to try for a more optimal placement...\n", 
+               currentPieceIndex, current_piece_size, (stock_index + 1));
 
-    // Increase the total number of stocks used
-    state->currentStockCount++;
+        // Restore space on stock after having backtracked piece off of it
+        state->remainingStockSpace[stock_index] += current_piece_size;
 
-    char *output = getStockAssignmentsAsString(state);
-    printf("%s", output);
-    free(output);
+        // Explicitly mark piece as unassigned
+        state->currentAssignments[currentPieceIndex] = -1;
 
-    // Recursive call: find placement of next piece
-    findBestPacking(state, currentPieceIndex + 1);
+        // Print updated stock assignments AFTER removing the piece
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nUpdated Stock Assignments after Backtracking:\n");
+        traceStockAssignments(state, CUTLIST_TRACE_FULL);
+    }
+    else
+    {
+        // Backtrack: Remove piece to try placing it somewhere else to see if it leads to a more efficient packing. Undo new stock addition as it is now empty
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "BACKTRACKING: Undo addition of new stock. Closing Stock #%d (piece %d removed)...\n", 
+               state->currentStockCount, (currentPieceIndex + 1));
 
-    // Backtrack: Remove piece to try placing it somewhere else to see if it leads to a more efficient packing. Undo new stock addition as it is now empty
-    printf("BACKTRACKING: Undo addition of new stock. Closing Stock #%d (piece %d removed)...\n", 
-           state->currentStockCount, (currentPieceIndex + 1));
+        state->currentStockCount--;
+        state->openedLength -= state->remainingStockSpace[state->currentStockCount] + current_piece_size;
+        state->remainingStockSpace[state->currentStockCount] = 0;
+        if (state->stockTypeCount > 0)
+        {
+            int type_index = frame->nextType - 1;
+            state->stockTypeOnHand[type_index]++;
+            state->currentCost -= state->stockTypeCosts[type_index];
+        }
 
-    state->currentStockCount--;
-    state->remainingStockSpace[state->currentStockCount] = 0;
+        // Explicitly mark piece as unassigned
+        state->currentAssignments[currentPieceIndex] = -1;
 
-    // Explicitly mark piece as unassigned
-    state->currentAssignments[currentPieceIndex] = -1;
+        // Print updated stock assignments AFTER removing the new stock
+        CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_FULL, "\nUpdated Stock Assignments after Backtracking (New Stock Removal):\n");
+        traceStockAssignments(state, CUTLIST_TRACE_FULL);
+    }
 
-    // Print updated stock assignments AFTER removing the new stock
-    printf("\nUpdated Stock Assignments after Backtracking (New Stock Removal):\n");
-    output = getStockAssignmentsAsString(state);
-    printf("%s", output);
-    free(output);
+    frame->placedStock = -1;
 }
 
-// Function to generate stock assignments as a string
-char* getStockAssignmentsAsString(PackingState *state) 
+// The whole subtree has been searched: every completion of this state was either found or pruned against the best
+// packing, which can only have improved since, so none can use fewer stocks (or cost less) than it does. A cost
+// bound too large for the entry is stored capped, which only weakens it
+static void closeSearchNode(PackingState *state, int currentPieceIndex, const SearchFrame *frame)
 {
-    // Allocate a sufficiently large buffer
-    int buffer_size = 1024;
-    char *output = (char*)malloc(buffer_size);
-    if (!output) return NULL;  // Return NULL if memory allocation fails
-
-    output[0] = '\0';  // Ensure string starts empty
-    char temp[100];     // Temporary buffer for each line
+    if (state->transpositions && !state->stopSearch && hasIncumbent(state))
+    {
+        int stock_bound;
+        if (state->stockTypeCount > 0)
+        {
+            long long cost_to_pay = state->optimalCost - state->currentCost;
+            stock_bound = (cost_to_pay > INT_MAX) ? INT_MAX : (int)cost_to_pay;
+        }
+        else
+        {
+            stock_bound = (int)((getIncumbentWaste(state) + state->remainingPieceLength[0]) / state->stockLength);
+        }
+        storeTransposition(state->transpositions, frame->stateKey, currentPieceIndex, stock_bound);
+    }
+}
 
-    strcat(output, "Stock assignments:\n");
+// Depth-first search for the best packing of pieces [currentPieceIndex, totalPieces), the pieces before it already
+// placed. Runs over state->searchStack instead of recursing, so the call stack stays flat however many pieces there
+// are: a piece's frame holds its next placement to try, and the search goes down a piece after placing one and back up
+// a piece once every placement has been tried
+void findBestPacking(PackingState *state, int currentPieceIndex) 
+{
+    int root_piece = currentPieceIndex;
+    int piece_index = root_piece;
+    if (!openSearchNode(state, piece_index))
+    {
+        return;
+    }
 
-    for (int stock_index = 0; stock_index < state->currentStockCount; stock_index++) 
+    for (;;)
     {
-        snprintf(temp, sizeof(temp), "Stock #%d: ", stock_index + 1);
-        strcat(output, temp);
+        SearchFrame *frame = &state->searchStack[piece_index];
+        if (frame->placedStock >= 0)
+        {
+            undoPlacement(state, piece_index, frame);
+        }
 
-        int first = 1;
-        for (int piece_index = 0; piece_index < state->totalPieces; piece_index++) 
+        if (!state->stopSearch && placeNextCandidate(state, piece_index, frame))
         {
-            if (state->currentAssignments[piece_index] == stock_index) 
+            // Go down into the placement's subtree, unless there is nothing to search below it
+            if (openSearchNode(state, piece_index + 1))
             {
-                if (!first) strcat(output, ", ");
-                snprintf(temp, sizeof(temp), "%d", state->pieceSizes[piece_index]);
-                strcat(output, temp);
-                first = 0;
+                piece_index++;
             }
+            continue;
         }
-        strcat(output, "\n");
+
+        // Every placement of the piece is tried, or the search is stopping: back up to the previous piece
+        closeSearchNode(state, piece_index, frame);
+        if (piece_index == root_piece)
+        {
+            return;
+        }
+        piece_index--;
+    }
+}
+
+// Function to generate stock assignments as a string, in CUTLIST_FORMAT_TEXT through a growable sink. Sizes are as
+// the search packs them, with the kerf included. Kept for existing callers; new code can write any format straight to
+// a file or buffer with writeCutlistAssignments
+char* getStockAssignmentsAsString(PackingState *state) 
+{
+    // The pieces are listed as the caller asked for them, without the kerf, as the trace prints them
+    const int *piece_lengths = state->pieceSizes;
+    int *lengths_copy = NULL;
+    if ((state->kerfWidth != 0) && (state->totalPieces > 0))
+    {
+        lengths_copy = (int *)malloc((size_t)state->totalPieces * sizeof(int));
+        if (!lengths_copy)
+        {
+            return NULL;
+        }
+        for (int piece_index = 0; piece_index < state->totalPieces; piece_index++)
+        {
+            lengths_copy[piece_index] = state->pieceSizes[piece_index] - state->kerfWidth;
+        }
+        piece_lengths = lengths_copy;
     }
 
-    strcat(output, "\n");
-    return output;  // Caller must free the returned string
+    CutlistSink sink;
+    initCutlistGrowableSink(&sink);
+    CutlistSinkError error = writeCutlistAssignments(&sink, CUTLIST_FORMAT_TEXT, piece_lengths, state->currentAssignments,
+                                                     state->totalPieces, state->currentStockCount);
+    free(lengths_copy);
+    if (error != CUTLIST_SINK_OK)
+    {
+        freeCutlistSink(&sink);
+        return NULL;
+    }
+    return sink.buffer;  // Caller must free the returned string
 }
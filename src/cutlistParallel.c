@@ -0,0 +1,335 @@
+#include "cutlistParallel.h"
+
+// Packs a (waste, task) pair so that comparing keys compares waste first and task second
+static uint64_t makeIncumbentKey(long long waste, int taskIndex)
+{
+    return ((uint64_t)waste << 32) | (uint32_t)taskIndex;
+}
+
+// Returns 1 if a packing with this much waste found in taskIndex would replace the shared best packing
+int beatsSharedIncumbent(SharedIncumbent *incumbent, long long waste, int taskIndex)
+{
+    if (waste > INT_MAX)
+    {
+        return 0;
+    }
+
+    uint64_t best_key = atomic_load_explicit(&incumbent->key, memory_order_relaxed);
+    return makeIncumbentKey(waste, taskIndex) < best_key;
+}
+
+long long getSharedIncumbentWaste(SharedIncumbent *incumbent)
+{
+    return (long long)(atomic_load_explicit(&incumbent->key, memory_order_relaxed) >> 32);
+}
+
+// Records a better packing found by a worker. Another worker may have published an even better one since the
+// caller checked, so the comparison is repeated under the lock
+void publishIncumbent(SharedIncumbent *incumbent, long long waste, int taskIndex, const int *assignments,
+                      int stockCount, int pieceCount)
+{
+    uint64_t new_key = makeIncumbentKey(waste, taskIndex);
+
+    pthread_mutex_lock(&incumbent->lock);
+    if (new_key < atomic_load_explicit(&incumbent->key, memory_order_relaxed))
+    {
+        memcpy(incumbent->assignments, assignments, (size_t)pieceCount * sizeof(int));
+        incumbent->stockCount = stockCount;
+        atomic_store_explicit(&incumbent->key, new_key, memory_order_release);
+        recordCutlistImprovement(incumbent->rootState, atomic_load_explicit(&incumbent->nodeCount, memory_order_relaxed),
+                                 stockCount, (int)waste, 0);
+    }
+    pthread_mutex_unlock(&incumbent->lock);
+}
+
+// Adds a worker's nodes to the count shared by all workers and checks the shared budget, and whether the solve was
+// cancelled. Once one worker runs out every worker does, so they all unwind together
+int chargeSharedSearchBudget(SharedIncumbent *incumbent, long long nodes, long long nodeLimit, double deadline,
+                             const atomic_int *cancelRequested)
+{
+    if (atomic_load_explicit(&incumbent->budgetExhausted, memory_order_relaxed))
+    {
+        return 1;
+    }
+
+    long long node_count = atomic_fetch_add_explicit(&incumbent->nodeCount, nodes, memory_order_relaxed) + nodes;
+    int exhausted = ((nodeLimit > 0) && (node_count >= nodeLimit)) ||
+                    (cancelRequested && atomic_load_explicit(cancelRequested, memory_order_relaxed)) ||
+                    ((deadline > 0) && (getCutlistWallSeconds() >= deadline));
+    if (exhausted)
+    {
+        atomic_store_explicit(&incumbent->budgetExhausted, 1, memory_order_relaxed);
+    }
+    return exhausted;
+}
+
+// Walks the first targetDepth levels of the search tree in serial search order, applying the same symmetry rules as
+// findBestPacking, and records the stock assignments leading to each node at that depth as one task.
+// prefixes may be NULL to only count the tasks. Returns the running task count
+static int collectTasks(PackingState *state, int pieceIndex, int targetDepth, int *prefixes, int taskCount)
+{
+    if (pieceIndex == targetDepth)
+    {
+        if (prefixes)
+        {
+            memcpy(&prefixes[(size_t)taskCount * targetDepth], state->currentAssignments, (size_t)targetDepth * sizeof(int));
+        }
+        return taskCount + 1;
+    }
+
+    int piece_size = state->pieceSizes[pieceIndex];
+
+    // Existing stocks first, in the order findBestPacking tries them
+    int first_stock = getFirstCandidateStock(state, pieceIndex);
+    for (int stock_index = first_stock; stock_index < state->currentStockCount; stock_index++)
+    {
+        if ((state->remainingStockSpace[stock_index] >= piece_size) && !isEquivalentStockTried(state, first_stock, stock_index))
+        {
+            state->remainingStockSpace[stock_index] -= piece_size;
+            state->currentAssignments[pieceIndex] = stock_index;
+            taskCount = collectTasks(state, pieceIndex + 1, targetDepth, prefixes, taskCount);
+            state->remainingStockSpace[stock_index] += piece_size;
+            state->currentAssignments[pieceIndex] = -1;
+        }
+    }
+
+    // Then a new stock
+    state->remainingStockSpace[state->currentStockCount] = state->stockLength - piece_size;
+    state->currentAssignments[pieceIndex] = state->currentStockCount;
+    state->currentStockCount++;
+    taskCount = collectTasks(state, pieceIndex + 1, targetDepth, prefixes, taskCount);
+    state->currentStockCount--;
+    state->remainingStockSpace[state->currentStockCount] = 0;
+    state->currentAssignments[pieceIndex] = -1;
+
+    return taskCount;
+}
+
+// Puts a worker's state at the root of a task's subtree by replaying the task's stock assignments
+static void replayTaskPrefix(PackingState *state, const int *prefix, int depth)
+{
+    state->currentStockCount = 0;
+    state->openedLength = 0;
+    state->optimalPrefixLength = 0;
+
+    for (int piece_index = 0; piece_index < depth; piece_index++)
+    {
+        int stock_index = prefix[piece_index];
+        if (stock_index == state->currentStockCount)
+        {
+            state->remainingStockSpace[stock_index] = state->stockLength;
+            state->currentStockCount++;
+            state->openedLength += state->stockLength;
+        }
+        state->remainingStockSpace[stock_index] -= state->pieceSizes[piece_index];
+        state->currentAssignments[piece_index] = stock_index;
+    }
+}
+
+// Takes the next task from the worker's own queue, or steals the last task of another worker's queue once its own
+// is empty. Returns -1 when no work is left anywhere
+static int takeTask(SearchWorker *worker)
+{
+    ParallelSearch *search = worker->search;
+    int task_index = -1;
+
+    pthread_mutex_lock(&worker->queue.lock);
+    if (worker->queue.head < worker->queue.tail)
+    {
+        task_index = worker->queue.head++;
+    }
+    pthread_mutex_unlock(&worker->queue.lock);
+
+    for (int offset = 1; (task_index < 0) && (offset < search->workerCount); offset++)
+    {
+        SearchWorker *victim = &search->workers[(worker->workerIndex + offset) % search->workerCount];
+
+        pthread_mutex_lock(&victim->queue.lock);
+        if (victim->queue.head < victim->queue.tail)
+        {
+            task_index = --victim->queue.tail;
+        }
+        pthread_mutex_unlock(&victim->queue.lock);
+    }
+
+    return task_index;
+}
+
+static void *runSearchWorker(void *argument)
+{
+    SearchWorker *worker = (SearchWorker *)argument;
+    ParallelSearch *search = worker->search;
+
+    int task_index;
+    while (!atomic_load_explicit(&search->incumbent.budgetExhausted, memory_order_relaxed) && ((task_index = takeTask(worker)) >= 0))
+    {
+        replayTaskPrefix(&worker->state, &search->taskPrefixes[(size_t)task_index * search->taskDepth], search->taskDepth);
+        worker->state.taskIndex = task_index;
+        worker->state.stopSearch = 0;
+        findBestPacking(&worker->state, search->taskDepth);
+    }
+
+    return NULL;
+}
+
+// Splits the search tree into tasks at a shallow depth and searches them on threadCount threads (the calling thread
+// included), with idle threads stealing tasks from busy ones. Workers prune against one shared incumbent, and the
+// result is the packing the serial search would return. state must be prepared as for findBestPacking(state, 0).
+// Returns 0 with the best packing in state, or -1 without touching it if the workers could not be set up
+int findBestPackingParallel(PackingState *state, int threadCount)
+{
+    if ((threadCount <= 1) || (state->totalPieces == 0))
+    {
+        return -1;
+    }
+
+    ParallelSearch search;
+    search.rootState = state;
+    search.workerCount = threadCount;
+
+    // Go deeper until there are enough tasks to keep every thread busy while the slow ones finish
+    int target_task_count = threadCount * CUTLIST_TASKS_PER_THREAD;
+    search.taskDepth = 1;
+    search.taskCount = collectTasks(state, 0, search.taskDepth, NULL, 0);
+    while ((search.taskCount < target_task_count) && (search.taskDepth < state->totalPieces))
+    {
+        search.taskDepth++;
+        search.taskCount = collectTasks(state, 0, search.taskDepth, NULL, 0);
+    }
+
+    size_t piece_array_size = (size_t)state->totalPieces * sizeof(int);
+    search.taskPrefixes = (int *)malloc((size_t)search.taskCount * search.taskDepth * sizeof(int));
+    search.workers = (SearchWorker *)calloc((size_t)threadCount, sizeof(SearchWorker));
+    search.incumbent.assignments = (int *)malloc(piece_array_size);
+    int *worker_buffers = (int *)malloc(3 * piece_array_size * (size_t)threadCount);
+    SearchFrame *worker_stacks = (SearchFrame *)malloc((size_t)state->totalPieces * sizeof(SearchFrame) * (size_t)threadCount);
+    pthread_t *threads = (pthread_t *)malloc((size_t)threadCount * sizeof(pthread_t));
+    int *started = (int *)malloc((size_t)threadCount * sizeof(int));
+
+    // Every worker gets a table as big as the caller's. Bounds hold whichever task proved them, so a worker keeps
+    // using its table across all the tasks it searches
+    TranspositionTable *root_table = state->transpositions;
+    long long transposition_entries = 0;
+    unsigned char *transposition_memory = NULL;
+    if (root_table)
+    {
+        transposition_entries = (long long)(root_table->bucketCount * CUTLIST_TRANSPOSITION_BUCKET_SIZE);
+        transposition_memory = (unsigned char *)malloc(getTranspositionEntryBytes(transposition_entries) * (size_t)threadCount);
+    }
+
+    if (!search.taskPrefixes || !search.workers || !search.incumbent.assignments || !worker_buffers || !worker_stacks || !threads ||
+        !started || (root_table && !transposition_memory))
+    {
+        free(search.taskPrefixes);
+        free(search.workers);
+        free(search.incumbent.assignments);
+        free(worker_buffers);
+        free(worker_stacks);
+        free(threads);
+        free(started);
+        free(transposition_memory);
+        return -1;
+    }
+
+    collectTasks(state, 0, search.taskDepth, search.taskPrefixes, 0);
+
+    // Start from whatever packing the caller already has, so it keeps winning ties it would win serially
+    atomic_init(&search.incumbent.key, makeIncumbentKey(state->optimalWaste, state->optimalTask));
+    pthread_mutex_init(&search.incumbent.lock, NULL);
+    atomic_init(&search.incumbent.nodeCount, state->nodeCount);
+    atomic_init(&search.incumbent.budgetExhausted, 0);
+    memcpy(search.incumbent.assignments, state->optimalAssignments, piece_array_size);
+    search.incumbent.stockCount = state->optimalStockCount;
+    search.incumbent.rootState = state;
+
+    // Each worker gets its own assignments, stock space and search stack, and a contiguous run of tasks to start with
+    for (int worker_index = 0; worker_index < threadCount; worker_index++)
+    {
+        SearchWorker *worker = &search.workers[worker_index];
+        worker->search = &search;
+        worker->workerIndex = worker_index;
+        worker->state = *state;
+        worker->state.traceLevel = CUTLIST_TRACE_OFF;
+        worker->state.sharedIncumbent = &search.incumbent;
+        worker->state.nodeCount = 0;
+        memset(&worker->state.stats, 0, sizeof(worker->state.stats));
+        worker->state.currentAssignments = &worker_buffers[(size_t)(3 * worker_index) * state->totalPieces];
+        worker->state.remainingStockSpace = &worker_buffers[(size_t)(3 * worker_index + 1) * state->totalPieces];
+        worker->state.optimalAssignments = &worker_buffers[(size_t)(3 * worker_index + 2) * state->totalPieces];
+        worker->state.searchStack = &worker_stacks[(size_t)worker_index * state->totalPieces];
+        if (root_table)
+        {
+            initTranspositionTable(&worker->transpositions,
+                                   &transposition_memory[getTranspositionEntryBytes(transposition_entries) * (size_t)worker_index],
+                                   transposition_entries);
+            worker->state.transpositions = &worker->transpositions;
+        }
+
+        pthread_mutex_init(&worker->queue.lock, NULL);
+        worker->queue.head = (int)((long long)search.taskCount * worker_index / threadCount);
+        worker->queue.tail = (int)((long long)search.taskCount * (worker_index + 1) / threadCount);
+    }
+
+    // Threads that fail to start just leave their tasks to be stolen by the others
+    for (int worker_index = 1; worker_index < threadCount; worker_index++)
+    {
+        started[worker_index] = (pthread_create(&threads[worker_index], NULL, runSearchWorker, &search.workers[worker_index]) == 0);
+    }
+    runSearchWorker(&search.workers[0]);
+    for (int worker_index = 1; worker_index < threadCount; worker_index++)
+    {
+        if (started[worker_index])
+        {
+            pthread_join(threads[worker_index], NULL);
+        }
+    }
+
+    // Hand the shared best packing back to the caller's state
+    uint64_t best_key = atomic_load(&search.incumbent.key);
+    state->optimalWaste = (int)(best_key >> 32);
+    state->optimalTask = (int)(uint32_t)best_key;
+    state->optimalStockCount = search.incumbent.stockCount;
+    memcpy(state->optimalAssignments, search.incumbent.assignments, piece_array_size);
+    state->budgetExhausted = atomic_load(&search.incumbent.budgetExhausted);
+
+    // Workers counted their own nodes and prunes, and searched below the task depth
+    state->stats.memoryBytes += (size_t)search.taskCount * search.taskDepth * sizeof(int) + (size_t)threadCount * sizeof(SearchWorker) +
+                                (piece_array_size * 3 + (size_t)state->totalPieces * sizeof(SearchFrame)) * (size_t)threadCount +
+                                piece_array_size + (size_t)threadCount * (sizeof(pthread_t) + sizeof(int)) +
+                                (root_table ? getTranspositionEntryBytes(transposition_entries) * (size_t)threadCount : 0);
+    for (int worker_index = 0; worker_index < threadCount; worker_index++)
+    {
+        const CutlistStats *worker_stats = &search.workers[worker_index].state.stats;
+        state->nodeCount += search.workers[worker_index].state.nodeCount;
+        for (int reason = 0; reason < CUTLIST_PRUNE_REASON_COUNT; reason++)
+        {
+            state->stats.prunes[reason] += worker_stats->prunes[reason];
+        }
+        if (worker_stats->maxDepth > state->stats.maxDepth)
+        {
+            state->stats.maxDepth = worker_stats->maxDepth;
+        }
+        if (root_table)
+        {
+            root_table->hits += search.workers[worker_index].transpositions.hits;
+            root_table->misses += search.workers[worker_index].transpositions.misses;
+            root_table->stores += search.workers[worker_index].transpositions.stores;
+            root_table->replacements += search.workers[worker_index].transpositions.replacements;
+        }
+    }
+
+    for (int worker_index = 0; worker_index < threadCount; worker_index++)
+    {
+        pthread_mutex_destroy(&search.workers[worker_index].queue.lock);
+    }
+    pthread_mutex_destroy(&search.incumbent.lock);
+    free(search.taskPrefixes);
+    free(search.workers);
+    free(search.incumbent.assignments);
+    free(worker_buffers);
+    free(worker_stacks);
+    free(threads);
+    free(started);
+    free(transposition_memory);
+    return 0;
+}
@@ -0,0 +1,801 @@
+#include "cutlistPatterns.h"
+#include "cutlistTransposition.h"
+
+#include <limits.h>
+#include <stdint.h>
+
+// Slack for floating point comparisons in the simplex and the knapsack
+#define CUTLIST_PATTERN_EPSILON 1e-9
+
+// Where the search is at one stock: the demand it was opened with and the first class its patterns must include
+typedef struct {
+    uint64_t demandKey;        // Transposition key of the demand left before the stock
+    int demandPieces;          // Pieces left before the stock
+    int firstClass;            // Largest class still needed, every pattern of the stock cuts at least one of it
+} PatternStockFrame;
+
+// Where the enumeration of one stock's patterns is at one class: what is left of the stock once the larger classes
+// have their counts. The count being tried is the class's entry in the stock's pattern
+typedef struct {
+    long long laterDemandLength; // Length of the pieces of this class and the smaller ones still needed
+    int space;                 // Length left on the stock
+    int smallestLeftover;      // Smallest piece a larger class leaves out of the pattern, INT_MAX if none
+} PatternClassFrame;
+
+// Working memory of the pattern engine, carved from one scratch block
+typedef struct {
+    // Column generation over the classes
+    double *basisInverse;      // classCount x classCount, row major
+    double *basisCost;         // 1 for a pattern column in the basis, 0 for a surplus column
+    double *basicValue;        // Value of every basic column
+    double *duals;             // Value of one piece of every class in the current LP solution
+    double *enteringColumn;    // basisInverse times the column entering the basis
+    double *knapsackValue;     // Best dual value that fits in every length up to stockLength
+    unsigned char *knapsackTaken; // Chunk x length: 1 if the chunk is in the best packing of that length
+    int *chunkClass;           // Bounded knapsack items split into powers of two: class of every chunk
+    int *chunkCount;           // and how many pieces of it the chunk holds
+    int *pricedPattern;        // Pattern found by the last pricing, one count per class
+    int *basisPatterns;        // classCount x classCount: pattern of every basic column, zeros for a surplus column
+    int chunkTotal;
+
+    // Search over patterns, one row of classCount per stock
+    int *demand;               // (pieceCount + 1) rows: pieces of every class still to cut before stock k
+    int *patterns;             // pieceCount rows: pieces of every class cut from stock k
+    int *nextPiece;            // Per class, the next sorted piece to hand a stock when writing assignments
+    PatternStockFrame *stockFrames; // pieceCount frames, one per stock the search may have open
+    PatternClassFrame *classFrames; // pieceCount rows of classCount + 1: one per class, and one for the complete pattern
+} PatternWorkspace;
+
+typedef struct {
+    PackingState *state;
+    PatternWorkspace *workspace;
+    int classCount;
+    long long diveNodeLimit;   // Node count at which the current dive gives up, 0 outside a dive
+    int diveAborted;
+} PatternSearch;
+
+// Number of knapsack chunks of a class: pieces are split into groups of 1, 2, 4, ... so every count up to the bound
+// is a sum of distinct chunks
+static int getChunkCount(int bound)
+{
+    int chunk_count = 0;
+    for (int chunk_size = 1; bound > 0; chunk_size *= 2)
+    {
+        bound -= (chunk_size < bound) ? chunk_size : bound;
+        chunk_count++;
+    }
+    return chunk_count;
+}
+
+static void *takePatternScratch(unsigned char **cursor, size_t bytes)
+{
+    void *buffer = *cursor;
+    *cursor += (bytes + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    return buffer;
+}
+
+// Carves the workspace out of scratch, or with scratch NULL only measures it. Returns the bytes used
+static size_t layoutPatternWorkspace(PatternWorkspace *workspace, void *scratch, int classCount, int chunkTotal,
+                                     int pieceCount, int stockLength)
+{
+    PatternWorkspace measured;
+    if (!workspace)
+    {
+        workspace = &measured;
+    }
+
+    unsigned char *base = (unsigned char *)scratch;
+    unsigned char *cursor = base;
+    size_t class_count = (size_t)classCount;
+    workspace->basisInverse = (double *)takePatternScratch(&cursor, class_count * class_count * sizeof(double));
+    workspace->basisCost = (double *)takePatternScratch(&cursor, class_count * sizeof(double));
+    workspace->basicValue = (double *)takePatternScratch(&cursor, class_count * sizeof(double));
+    workspace->duals = (double *)takePatternScratch(&cursor, class_count * sizeof(double));
+    workspace->enteringColumn = (double *)takePatternScratch(&cursor, class_count * sizeof(double));
+    workspace->knapsackValue = (double *)takePatternScratch(&cursor, (size_t)(stockLength + 1) * sizeof(double));
+    workspace->knapsackTaken = (unsigned char *)takePatternScratch(&cursor, (size_t)chunkTotal * (size_t)(stockLength + 1));
+    workspace->chunkClass = (int *)takePatternScratch(&cursor, (size_t)chunkTotal * sizeof(int));
+    workspace->chunkCount = (int *)takePatternScratch(&cursor, (size_t)chunkTotal * sizeof(int));
+    workspace->pricedPattern = (int *)takePatternScratch(&cursor, class_count * sizeof(int));
+    workspace->basisPatterns = (int *)takePatternScratch(&cursor, class_count * class_count * sizeof(int));
+    workspace->demand = (int *)takePatternScratch(&cursor, (size_t)(pieceCount + 1) * class_count * sizeof(int));
+    workspace->patterns = (int *)takePatternScratch(&cursor, (size_t)pieceCount * class_count * sizeof(int));
+    workspace->nextPiece = (int *)takePatternScratch(&cursor, class_count * sizeof(int));
+    workspace->stockFrames = (PatternStockFrame *)takePatternScratch(&cursor, (size_t)pieceCount * sizeof(PatternStockFrame));
+    workspace->classFrames = (PatternClassFrame *)takePatternScratch(&cursor, (size_t)pieceCount * (class_count + 1) *
+                                                                                  sizeof(PatternClassFrame));
+    workspace->chunkTotal = chunkTotal;
+    return (size_t)(cursor - base);
+}
+
+size_t getPatternScratchSize(int pieceCount, int stockLength)
+{
+    if ((pieceCount <= 0) || (stockLength > CUTLIST_PATTERN_MAX_STOCK_LENGTH))
+    {
+        return 0;
+    }
+
+    // Every class splits into at most log2(pieces) + 1 chunks, and never more chunks than pieces
+    int class_count = (pieceCount < CUTLIST_PATTERN_MAX_CLASSES) ? pieceCount : CUTLIST_PATTERN_MAX_CLASSES;
+    long long chunk_total = (long long)class_count * getChunkCount(pieceCount);
+    if (chunk_total > pieceCount)
+    {
+        chunk_total = pieceCount;
+    }
+    return layoutPatternWorkspace(NULL, NULL, class_count, (int)chunk_total, pieceCount, stockLength);
+}
+
+int isPatternEngineEligible(const PackingState *state)
+{
+    return (state->totalPieces > 0) && (state->pieceClassCount <= CUTLIST_PATTERN_MAX_CLASSES) &&
+           (state->stockLength <= CUTLIST_PATTERN_MAX_STOCK_LENGTH) &&
+           (state->classSizes[state->pieceClassCount - 1] > 0);
+}
+
+// Rough work estimates for the two exact engines. Branch-and-bound deals every class's pieces out over the open stocks,
+// C(count + stocks - 1, count) ways per class after symmetry breaking. The pattern engine pays for a knapsack over the
+// stock length per simplex pivot, about one pivot per class, and its search is then usually settled by the LP bound
+int isPatternEngineCheaper(const PackingState *state)
+{
+    if (!isPatternEngineEligible(state) || (state->totalPieces < CUTLIST_PATTERN_MIN_PIECES))
+    {
+        return 0;
+    }
+
+    int chunk_total = 0;
+    for (int class_index = 0; class_index < state->pieceClassCount; class_index++)
+    {
+        chunk_total += getChunkCount(state->classCounts[class_index]);
+    }
+    double pattern_cost = (double)state->pieceClassCount * state->pieceClassCount * chunk_total * (state->stockLength + 1.0);
+
+    // Multiply the branch-and-bound estimate up only until it passes the pattern engine's, it overflows long before
+    // the order gets large
+    double stock_count = (state->rootLowerBound > 1) ? state->rootLowerBound : 1;
+    double branch_cost = 1.0;
+    for (int class_index = 0; class_index < state->pieceClassCount; class_index++)
+    {
+        for (int count = 1; count <= state->classCounts[class_index]; count++)
+        {
+            branch_cost = branch_cost * (stock_count - 1.0 + count) / count;
+            if (branch_cost > pattern_cost)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Solves the bounded knapsack "most dual value on one stock" exactly over the chunks, leaving the best pattern in
+// pricedPattern. Returns its value
+static double pricePattern(PatternSearch *search)
+{
+    PatternWorkspace *workspace = search->workspace;
+    int stock_length = search->state->stockLength;
+    const int *class_sizes = search->state->classSizes;
+
+    for (int length = 0; length <= stock_length; length++)
+    {
+        workspace->knapsackValue[length] = 0.0;
+    }
+
+    for (int chunk_index = 0; chunk_index < workspace->chunkTotal; chunk_index++)
+    {
+        int class_index = workspace->chunkClass[chunk_index];
+        int chunk_length = workspace->chunkCount[chunk_index] * class_sizes[class_index];
+        double chunk_value = workspace->chunkCount[chunk_index] * workspace->duals[class_index];
+        unsigned char *taken = &workspace->knapsackTaken[(size_t)chunk_index * (stock_length + 1)];
+
+        // Negative duals never help, and the LP only prices them after every surplus column has been handled
+        for (int length = stock_length; length >= 0; length--)
+        {
+            taken[length] = 0;
+            if ((chunk_value > 0) && (length >= chunk_length) &&
+                (workspace->knapsackValue[length - chunk_length] + chunk_value > workspace->knapsackValue[length] + CUTLIST_PATTERN_EPSILON))
+            {
+                workspace->knapsackValue[length] = workspace->knapsackValue[length - chunk_length] + chunk_value;
+                taken[length] = 1;
+            }
+        }
+    }
+
+    // Walk the chunks backwards to recover which ones the best packing of a whole stock took
+    for (int class_index = 0; class_index < search->classCount; class_index++)
+    {
+        workspace->pricedPattern[class_index] = 0;
+    }
+    int length = stock_length;
+    for (int chunk_index = workspace->chunkTotal - 1; chunk_index >= 0; chunk_index--)
+    {
+        if (workspace->knapsackTaken[(size_t)chunk_index * (stock_length + 1) + length])
+        {
+            int class_index = workspace->chunkClass[chunk_index];
+            workspace->pricedPattern[class_index] += workspace->chunkCount[chunk_index];
+            length -= workspace->chunkCount[chunk_index] * class_sizes[class_index];
+        }
+    }
+
+    return workspace->knapsackValue[stock_length];
+}
+
+// Pivots the column in enteringColumn into the basis in place of the basic column of leavingRow. enteringPattern is
+// NULL for a surplus column
+static void pivotBasis(PatternSearch *search, int leavingRow, const int *enteringPattern)
+{
+    PatternWorkspace *workspace = search->workspace;
+    int class_count = search->classCount;
+    double *leaving_row = &workspace->basisInverse[(size_t)leavingRow * class_count];
+    double pivot = workspace->enteringColumn[leavingRow];
+
+    for (int column = 0; column < class_count; column++)
+    {
+        leaving_row[column] /= pivot;
+    }
+    workspace->basicValue[leavingRow] /= pivot;
+
+    for (int row = 0; row < class_count; row++)
+    {
+        double factor = workspace->enteringColumn[row];
+        if ((row == leavingRow) || (factor == 0.0))
+        {
+            continue;
+        }
+
+        double *inverse_row = &workspace->basisInverse[(size_t)row * class_count];
+        for (int column = 0; column < class_count; column++)
+        {
+            inverse_row[column] -= factor * leaving_row[column];
+        }
+        workspace->basicValue[row] -= factor * workspace->basicValue[leavingRow];
+    }
+
+    int *basis_pattern = &workspace->basisPatterns[(size_t)leavingRow * class_count];
+    for (int class_index = 0; class_index < class_count; class_index++)
+    {
+        basis_pattern[class_index] = enteringPattern ? enteringPattern[class_index] : 0;
+    }
+    workspace->basisCost[leavingRow] = enteringPattern ? 1.0 : 0.0;
+}
+
+// Gilmore-Gomory LP bound by column generation: minimise the stocks cut, with every class's demand covered by
+// patterns, adding the best-priced pattern each pivot. Stopping early is safe: for any duals y >= 0 and best pattern
+// value v, demand . y / v is a lower bound (Farley), so the bound never depends on the simplex having converged
+static int computePatternLowerBound(PatternSearch *search)
+{
+    PatternWorkspace *workspace = search->workspace;
+    PackingState *state = search->state;
+    int class_count = search->classCount;
+
+    // Start from one homogeneous pattern per class, a diagonal basis that already covers all demand
+    for (int row = 0; row < class_count; row++)
+    {
+        int per_stock = state->stockLength / state->classSizes[row];
+        if (per_stock > state->classCounts[row])
+        {
+            per_stock = state->classCounts[row];
+        }
+
+        for (int column = 0; column < class_count; column++)
+        {
+            workspace->basisInverse[(size_t)row * class_count + column] = (row == column) ? (1.0 / per_stock) : 0.0;
+            workspace->basisPatterns[(size_t)row * class_count + column] = (row == column) ? per_stock : 0;
+        }
+        workspace->basisCost[row] = 1.0;
+        workspace->basicValue[row] = (double)state->classCounts[row] / per_stock;
+    }
+
+    double best_bound = 0.0;
+    for (int iteration = 0; iteration < CUTLIST_PATTERN_MAX_SIMPLEX_ITERATIONS; iteration++)
+    {
+        // Duals of the current basis: y = c_B B^-1
+        for (int column = 0; column < class_count; column++)
+        {
+            double dual = 0.0;
+            for (int row = 0; row < class_count; row++)
+            {
+                dual += workspace->basisCost[row] * workspace->basisInverse[(size_t)row * class_count + column];
+            }
+            workspace->duals[column] = dual;
+        }
+
+        // A negative dual means covering more of that class than needed is cheaper: its surplus column enters
+        int surplus_class = -1;
+        for (int class_index = 0; class_index < class_count; class_index++)
+        {
+            if (workspace->duals[class_index] < -CUTLIST_PATTERN_EPSILON)
+            {
+                surplus_class = class_index;
+                break;
+            }
+        }
+
+        const int *entering_pattern = NULL;
+        if (surplus_class >= 0)
+        {
+            for (int row = 0; row < class_count; row++)
+            {
+                workspace->enteringColumn[row] = -workspace->basisInverse[(size_t)row * class_count + surplus_class];
+            }
+        }
+        else
+        {
+            // Every dual is non-negative, so the Farley bound applies to them as they are
+            double pattern_value = pricePattern(search);
+            double dual_demand = 0.0;
+            for (int class_index = 0; class_index < class_count; class_index++)
+            {
+                dual_demand += workspace->duals[class_index] * state->classCounts[class_index];
+            }
+            if ((pattern_value > CUTLIST_PATTERN_EPSILON) && (dual_demand / pattern_value > best_bound))
+            {
+                best_bound = dual_demand / pattern_value;
+            }
+
+            // No pattern prices out: the LP is solved
+            if (pattern_value <= 1.0 + CUTLIST_PATTERN_EPSILON)
+            {
+                break;
+            }
+
+            entering_pattern = workspace->pricedPattern;
+            for (int row = 0; row < class_count; row++)
+            {
+                double entry = 0.0;
+                for (int column = 0; column < class_count; column++)
+                {
+                    entry += workspace->basisInverse[(size_t)row * class_count + column] * workspace->pricedPattern[column];
+                }
+                workspace->enteringColumn[row] = entry;
+            }
+        }
+
+        // Ratio test, ties to the lowest row so degenerate pivots cannot cycle forever
+        int leaving_row = -1;
+        double best_ratio = 0.0;
+        for (int row = 0; row < class_count; row++)
+        {
+            if (workspace->enteringColumn[row] > CUTLIST_PATTERN_EPSILON)
+            {
+                double ratio = workspace->basicValue[row] / workspace->enteringColumn[row];
+                if ((leaving_row < 0) || (ratio < best_ratio - CUTLIST_PATTERN_EPSILON))
+                {
+                    leaving_row = row;
+                    best_ratio = ratio;
+                }
+            }
+        }
+        if (leaving_row < 0)
+        {
+            break;
+        }
+
+        pivotBasis(search, leaving_row, entering_pattern);
+    }
+
+    // Round up, letting through only what floating point error could have added
+    int bound = (int)best_bound;
+    return (best_bound - bound > 1e-6) ? (bound + 1) : bound;
+}
+
+// Writes the stocks cut so far as the new best packing, handing every stock the next unassigned pieces of its classes
+static void recordPatternPacking(PatternSearch *search, int stockCount)
+{
+    PackingState *state = search->state;
+    PatternWorkspace *workspace = search->workspace;
+
+    for (int class_index = 0; class_index < search->classCount; class_index++)
+    {
+        workspace->nextPiece[class_index] = state->classFirstPiece[class_index];
+    }
+
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        const int *pattern = &workspace->patterns[(size_t)stock_index * search->classCount];
+        for (int class_index = 0; class_index < search->classCount; class_index++)
+        {
+            for (int count = 0; count < pattern[class_index]; count++)
+            {
+                state->optimalAssignments[workspace->nextPiece[class_index]++] = stock_index;
+            }
+        }
+    }
+
+    state->optimalStockCount = stockCount;
+    state->optimalWaste = stockCount * state->stockLength - state->remainingPieceLength[0];
+    state->optimalTask = 0;
+    recordCutlistImprovement(state, state->nodeCount, stockCount, state->optimalWaste, 0);
+}
+
+static int isPatternSearchStopped(const PatternSearch *search)
+{
+    return search->state->stopSearch || search->diveAborted;
+}
+
+static PatternClassFrame *getPatternClassFrame(const PatternSearch *search, int stockIndex, int classIndex)
+{
+    return &search->workspace->classFrames[(size_t)stockIndex * (search->classCount + 1) + classIndex];
+}
+
+static int openPatternStock(PatternSearch *search, int stockIndex);
+
+// Enters class classIndex of stock stockIndex, its frame already filled in by the class before it. Stocks are filled
+// one class at a time, largest first, trying the most pieces of each class first so the first packings found are
+// greedy ones. Only maximal patterns are completed: a pattern with room for a piece that is still needed can take it
+// from a later stock without ever costing a stock. Past the last class the pattern is complete, and the next stock is
+// opened on the demand it leaves. Returns 1 if the class, or the next stock, has counts to try
+static int openPatternClass(PatternSearch *search, int stockIndex, int classIndex)
+{
+    PackingState *state = search->state;
+    PatternWorkspace *workspace = search->workspace;
+    PatternClassFrame *frame = getPatternClassFrame(search, stockIndex, classIndex);
+    const int *demand = &workspace->demand[(size_t)stockIndex * search->classCount];
+    int *pattern = &workspace->patterns[(size_t)stockIndex * search->classCount];
+
+    // Even cutting every remaining piece of the later classes cannot shrink the space below a piece left out
+    if (frame->space - frame->laterDemandLength >= frame->smallestLeftover)
+    {
+        return 0;
+    }
+
+    if (classIndex == search->classCount)
+    {
+        int *next_demand = &workspace->demand[(size_t)(stockIndex + 1) * search->classCount];
+        for (int class_index = 0; class_index < search->classCount; class_index++)
+        {
+            next_demand[class_index] = demand[class_index] - pattern[class_index];
+        }
+        return openPatternStock(search, stockIndex + 1);
+    }
+
+    // The count is lowered before every try, so start one above the most pieces of the class that fit
+    int max_count = frame->space / state->classSizes[classIndex];
+    if (max_count > demand[classIndex])
+    {
+        max_count = demand[classIndex];
+    }
+    pattern[classIndex] = max_count + 1;
+    return 1;
+}
+
+// Tries the next, smaller count of class classIndex on stock stockIndex, filling in the next class's frame. Returns 0
+// once every count is tried, with the class's count back at 0
+static int placeNextPatternCount(PatternSearch *search, int stockIndex, int classIndex)
+{
+    PatternWorkspace *workspace = search->workspace;
+    const PatternClassFrame *frame = getPatternClassFrame(search, stockIndex, classIndex);
+    const int *demand = &workspace->demand[(size_t)stockIndex * search->classCount];
+    int *pattern = &workspace->patterns[(size_t)stockIndex * search->classCount];
+
+    int min_count = (classIndex == workspace->stockFrames[stockIndex].firstClass) ? 1 : 0;
+    int count = pattern[classIndex] - 1;
+    if (isPatternSearchStopped(search) || (count < min_count))
+    {
+        pattern[classIndex] = 0;
+        return 0;
+    }
+    pattern[classIndex] = count;
+
+    int piece_size = search->state->classSizes[classIndex];
+    int leftover_size = (count < demand[classIndex]) ? piece_size : frame->smallestLeftover;
+    PatternClassFrame *next_frame = getPatternClassFrame(search, stockIndex, classIndex + 1);
+    next_frame->space = frame->space - count * piece_size;
+    next_frame->smallestLeftover = (leftover_size < frame->smallestLeftover) ? leftover_size : frame->smallestLeftover;
+    next_frame->laterDemandLength = frame->laterDemandLength - (long long)demand[classIndex] * piece_size;
+    return 1;
+}
+
+// Leaves stock stockIndex once every pattern of it is tried
+static void closePatternStock(PatternSearch *search, int stockIndex)
+{
+    PackingState *state = search->state;
+    const PatternStockFrame *stock_frame = &search->workspace->stockFrames[stockIndex];
+
+    // Searched in full: no way of cutting this demand beats the incumbent, which can only have improved since
+    if (state->transpositions && !isPatternSearchStopped(search))
+    {
+        storeTransposition(state->transpositions, stock_frame->demandKey, state->totalPieces - stock_frame->demandPieces,
+                           state->optimalStockCount - stockIndex);
+    }
+}
+
+// Bin completion: the stock holding the largest piece still needed is cut next, from every maximal pattern that
+// includes it. The remaining demand is all that matters to the rest of the search, so it keys the transposition table.
+// Enters stock stockIndex, counting the node and pruning it. Returns 1 with its first class entered if the stock has
+// patterns to try, 0 if it is done with
+static int openPatternStock(PatternSearch *search, int stockIndex)
+{
+    PackingState *state = search->state;
+    PatternWorkspace *workspace = search->workspace;
+    const int *demand = &workspace->demand[(size_t)stockIndex * search->classCount];
+
+    state->nodeCount++;
+    if (((state->nodeCount & (CUTLIST_BUDGET_CHECK_INTERVAL - 1)) == 0) && isSearchBudgetExhausted(state))
+    {
+        state->budgetExhausted = 1;
+        state->stopSearch = 1;
+        return 0;
+    }
+    if ((search->diveNodeLimit > 0) && (state->nodeCount >= search->diveNodeLimit))
+    {
+        search->diveAborted = 1;
+        return 0;
+    }
+    if (stockIndex > state->stats.maxDepth)
+    {
+        state->stats.maxDepth = stockIndex;
+    }
+
+    int first_class = 0;
+    while ((first_class < search->classCount) && (demand[first_class] == 0))
+    {
+        first_class++;
+    }
+
+    // Every piece is cut: stockIndex stocks were used
+    if (first_class == search->classCount)
+    {
+        if (stockIndex < state->optimalStockCount)
+        {
+            recordPatternPacking(search, stockIndex);
+            CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "New Best Found: Stock Used = %d, Waste = %d\n\n", state->optimalStockCount, state->optimalWaste);
+            if (state->optimalStockCount <= state->rootLowerBound)
+            {
+                state->stopSearch = 1;
+            }
+        }
+        return 0;
+    }
+
+    // Pruning: the stocks still needed for the remaining pieces, from the L2 bound and from earlier searches of the
+    // same demand
+    int stocks_needed = computeL2Bound(&state->classSizes[first_class], &demand[first_class], search->classCount - first_class,
+                                       demand[first_class], NULL, 0, 0, state->stockLength);
+    if (stockIndex + stocks_needed >= state->optimalStockCount)
+    {
+        state->stats.prunes[CUTLIST_PRUNE_LOWER_BOUND]++;
+        return 0;
+    }
+
+    PatternStockFrame *stock_frame = &workspace->stockFrames[stockIndex];
+    stock_frame->demandKey = 0;
+    if (state->transpositions)
+    {
+        int stock_bound;
+        stock_frame->demandKey = hashRemainingDemand(state->classSizes, demand, search->classCount);
+        if (probeTransposition(state->transpositions, stock_frame->demandKey, &stock_bound) && (stockIndex + stock_bound >= state->optimalStockCount))
+        {
+            state->stats.prunes[CUTLIST_PRUNE_TRANSPOSITION]++;
+            return 0;
+        }
+    }
+
+    long long demand_length = 0;
+    int demand_pieces = 0;
+    for (int class_index = first_class; class_index < search->classCount; class_index++)
+    {
+        demand_length += (long long)demand[class_index] * state->classSizes[class_index];
+        demand_pieces += demand[class_index];
+    }
+    stock_frame->demandPieces = demand_pieces;
+    stock_frame->firstClass = first_class;
+
+    int *pattern = &workspace->patterns[(size_t)stockIndex * search->classCount];
+    for (int class_index = 0; class_index < first_class; class_index++)
+    {
+        pattern[class_index] = 0;
+    }
+
+    PatternClassFrame *frame = getPatternClassFrame(search, stockIndex, first_class);
+    frame->space = state->stockLength;
+    frame->smallestLeftover = INT_MAX;
+    frame->laterDemandLength = demand_length;
+    if (!openPatternClass(search, stockIndex, first_class))
+    {
+        closePatternStock(search, stockIndex);
+        return 0;
+    }
+    return 1;
+}
+
+// Searches the stocks from stockIndex on for the demand left before it. Runs over the workspace's stock and class
+// frames instead of recursing, so the call stack stays flat however many stocks there are: the search goes down a class
+// after giving one its count, from the last class on to the next stock, and back up once every count is tried
+static void searchPatterns(PatternSearch *search, int stockIndex)
+{
+    int root_stock = stockIndex;
+    int stock_index = root_stock;
+    if (!openPatternStock(search, stock_index))
+    {
+        return;
+    }
+    int class_index = search->workspace->stockFrames[stock_index].firstClass;
+
+    for (;;)
+    {
+        if (placeNextPatternCount(search, stock_index, class_index))
+        {
+            // Go down into the count's subtree, unless there is nothing to search below it
+            if (openPatternClass(search, stock_index, class_index + 1))
+            {
+                if (class_index + 1 < search->classCount)
+                {
+                    class_index++;
+                }
+                else
+                {
+                    stock_index++;
+                    class_index = search->workspace->stockFrames[stock_index].firstClass;
+                }
+            }
+            continue;
+        }
+
+        // Every count of the class is tried, or the search is stopping: back up a class, or from the stock's first
+        // class to the last class of the stock before it
+        if (class_index > search->workspace->stockFrames[stock_index].firstClass)
+        {
+            class_index--;
+            continue;
+        }
+        closePatternStock(search, stock_index);
+        if (stock_index == root_stock)
+        {
+            return;
+        }
+        stock_index--;
+        class_index = search->classCount - 1;
+    }
+}
+
+// LP rounding: cut every pattern of the LP solution as many whole times as the LP uses it, then search what is left,
+// usually a few stocks' worth, exactly. The LP is rarely more than a stock from the optimum, so this finds the optimum
+// or close to it long before a search from the root would. Gives up after CUTLIST_PATTERN_DIVE_NODES nodes
+static void diveFromLpSolution(PatternSearch *search)
+{
+    PackingState *state = search->state;
+    PatternWorkspace *workspace = search->workspace;
+    int class_count = search->classCount;
+    int stock_index = 0;
+
+    memcpy(workspace->demand, state->classCounts, (size_t)class_count * sizeof(int));
+    for (int row = 0; row < class_count; row++)
+    {
+        if (workspace->basisCost[row] == 0.0)
+        {
+            continue;
+        }
+
+        int copies = (int)(workspace->basicValue[row] + 1e-6);
+        for (int copy = 0; copy < copies; copy++)
+        {
+            const int *demand = &workspace->demand[(size_t)stock_index * class_count];
+            int *pattern = &workspace->patterns[(size_t)stock_index * class_count];
+            int *next_demand = &workspace->demand[(size_t)(stock_index + 1) * class_count];
+
+            // Patterns may cover more than what is left of a class once other patterns have taken their share
+            int piece_count = 0;
+            for (int class_index = 0; class_index < class_count; class_index++)
+            {
+                int count = workspace->basisPatterns[(size_t)row * class_count + class_index];
+                pattern[class_index] = (count < demand[class_index]) ? count : demand[class_index];
+                next_demand[class_index] = demand[class_index] - pattern[class_index];
+                piece_count += pattern[class_index];
+            }
+            if (piece_count == 0)
+            {
+                break;
+            }
+            stock_index++;
+        }
+    }
+
+    search->diveNodeLimit = state->nodeCount + CUTLIST_PATTERN_DIVE_NODES;
+    searchPatterns(search, stock_index);
+    search->diveNodeLimit = 0;
+    search->diveAborted = 0;
+}
+
+// Splits every class's pieces-per-stock bound into power-of-two chunks for the 0/1 knapsack. With workspace NULL only
+// counts them. Returns the number of chunks
+static int splitKnapsackChunks(const PackingState *state, PatternWorkspace *workspace)
+{
+    int chunk_index = 0;
+    for (int class_index = 0; class_index < state->pieceClassCount; class_index++)
+    {
+        int bound = state->stockLength / state->classSizes[class_index];
+        if (bound > state->classCounts[class_index])
+        {
+            bound = state->classCounts[class_index];
+        }
+        for (int chunk_size = 1; bound > 0; chunk_size *= 2)
+        {
+            int chunk_count = (chunk_size < bound) ? chunk_size : bound;
+            if (workspace)
+            {
+                workspace->chunkClass[chunk_index] = class_index;
+                workspace->chunkCount[chunk_index] = chunk_count;
+            }
+            chunk_index++;
+            bound -= chunk_count;
+        }
+    }
+    return chunk_index;
+}
+
+void findBestPackingByPatterns(PackingState *state, void *scratch)
+{
+    PatternWorkspace workspace;
+    PatternSearch search;
+    search.state = state;
+    search.workspace = &workspace;
+    search.classCount = state->pieceClassCount;
+    search.diveNodeLimit = 0;
+    search.diveAborted = 0;
+
+    int chunk_total = splitKnapsackChunks(state, NULL);
+    layoutPatternWorkspace(&workspace, scratch, search.classCount, chunk_total, state->totalPieces, state->stockLength);
+    splitKnapsackChunks(state, &workspace);
+
+    int lp_bound = computePatternLowerBound(&search);
+    CUTLIST_TRACE(state->traceLevel, CUTLIST_TRACE_SUMMARY, "Pattern LP bound on stock used: %d\n\n", lp_bound);
+    if (lp_bound > state->rootLowerBound)
+    {
+        state->rootLowerBound = lp_bound;
+    }
+    if (state->optimalStockCount <= state->rootLowerBound)
+    {
+        return;
+    }
+
+    diveFromLpSolution(&search);
+    if (state->stopSearch)
+    {
+        return;
+    }
+
+    memcpy(workspace.demand, state->classCounts, (size_t)search.classCount * sizeof(int));
+    searchPatterns(&search, 0);
+}
+
+// The LP only reads the classes and the stock length of a state
+static void initLpState(PackingState *state, const int *classSizes, const int *classCounts, int classCount, int stockLength)
+{
+    memset(state, 0, sizeof(*state));
+    state->classSizes = (int *)classSizes;
+    state->classCounts = (int *)classCounts;
+    state->pieceClassCount = classCount;
+    state->stockLength = stockLength;
+}
+
+size_t getPatternLpScratchSize(const int *classSizes, const int *classCounts, int classCount, int stockLength)
+{
+    PackingState state;
+    initLpState(&state, classSizes, classCounts, classCount, stockLength);
+    return layoutPatternWorkspace(NULL, NULL, classCount, splitKnapsackChunks(&state, NULL), 0, stockLength);
+}
+
+int computePatternLpSolution(const int *classSizes, const int *classCounts, int classCount, int stockLength,
+                             void *scratch, int *patterns, double *stockCounts)
+{
+    PackingState state;
+    PatternWorkspace workspace;
+    PatternSearch search;
+    initLpState(&state, classSizes, classCounts, classCount, stockLength);
+    search.state = &state;
+    search.workspace = &workspace;
+    search.classCount = classCount;
+    search.diveNodeLimit = 0;
+    search.diveAborted = 0;
+
+    layoutPatternWorkspace(&workspace, scratch, classCount, splitKnapsackChunks(&state, NULL), 0, stockLength);
+    splitKnapsackChunks(&state, &workspace);
+    int lp_bound = computePatternLowerBound(&search);
+
+    memcpy(patterns, workspace.basisPatterns, (size_t)classCount * classCount * sizeof(int));
+    for (int row = 0; row < classCount; row++)
+    {
+        stockCounts[row] = (workspace.basisCost[row] != 0.0) ? workspace.basicValue[row] : 0.0;
+    }
+    return lp_bound;
+}
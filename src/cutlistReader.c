@@ -0,0 +1,653 @@
+#include "cutlistReader.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Start of every binary order file. The byte order marker rejects a file written on a machine of the other endianness
+#define CUTLIST_ORDER_MAGIC 0x314F4C43u // "CLO1"
+#define CUTLIST_ORDER_BYTE_ORDER 0x01020304u
+
+// Record flag: data holds (length, quantity) runs rather than one length per piece
+#define CUTLIST_ORDER_RUNS 1u
+
+#define CUTLIST_ORDER_CSV_HEADER "order,stock_length,length,quantity\n"
+
+// Lengths or runs a binary writer stages before handing them to the sink
+#define CUTLIST_ORDER_WRITE_CHUNK 1024
+
+typedef struct {
+    uint32_t magic;
+    uint32_t byteOrder;
+} OrderFileHeader;
+
+// One order of a binary file, read in place from the mapping. recordBytes is a multiple of 8, so records follow each
+// other without losing alignment
+typedef struct {
+    uint32_t recordBytes;
+    uint32_t flags;
+    int64_t orderId;
+    int32_t stockLength;
+    int32_t kerfWidth;
+    int32_t trimLength;
+    int32_t entryCount;           // Lengths, or runs with CUTLIST_ORDER_RUNS
+    int32_t data[];
+} OrderRecord;
+
+// One CSV row
+typedef struct {
+    long long orderId;
+    long long stockLength;
+    long long length;
+    long long quantity;
+} OrderRow;
+
+struct CutlistOrderReader {
+    CutlistOrderFormat format;
+    CutlistInput defaults;
+    const unsigned char *data;
+    size_t size;
+    size_t position;
+    long long line;               // CSV line at position, from 1
+    OrderRow pendingRow;          // First row of the order the last chunk had no room for
+    long long pendingLine;
+    int hasPendingRow;
+    CutlistReadStatus status;
+    long long errorPosition;
+    int *pieces;                  // Pieces of the chunk's orders that are not read in place
+    size_t pieceCapacity;
+    size_t *pieceOffsets;         // Where each order of the chunk starts in pieces, SIZE_MAX if read in place
+    size_t offsetCapacity;
+    int mapped;
+#ifdef _WIN32
+    HANDLE mappedFile;
+    HANDLE mappingHandle;
+#endif
+};
+
+// Maps the whole file read-only. An empty file maps to no bytes. Returns 0, or -1 if it is missing or cannot be mapped
+static int mapOrderFile(CutlistOrderReader *reader, const char *path)
+{
+#ifdef _WIN32
+    reader->mappedFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (reader->mappedFile == INVALID_HANDLE_VALUE)
+    {
+        return -1;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(reader->mappedFile, &size) || (size.QuadPart < 0))
+    {
+        CloseHandle(reader->mappedFile);
+        return -1;
+    }
+    if (size.QuadPart == 0)
+    {
+        CloseHandle(reader->mappedFile);
+        return 0;
+    }
+    reader->mappingHandle = CreateFileMappingA(reader->mappedFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    reader->data = reader->mappingHandle ? (const unsigned char *)MapViewOfFile(reader->mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!reader->data)
+    {
+        if (reader->mappingHandle) CloseHandle(reader->mappingHandle);
+        CloseHandle(reader->mappedFile);
+        return -1;
+    }
+    reader->size = (size_t)size.QuadPart;
+#else
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        return -1;
+    }
+    struct stat file_status;
+    if (fstat(descriptor, &file_status) != 0)
+    {
+        close(descriptor);
+        return -1;
+    }
+    if (file_status.st_size == 0)
+    {
+        close(descriptor);
+        return 0;
+    }
+    void *mapping = mmap(NULL, (size_t)file_status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        return -1;
+    }
+    // The file is read once front to back, so the kernel can read ahead and drop pages behind
+    posix_madvise(mapping, (size_t)file_status.st_size, POSIX_MADV_SEQUENTIAL);
+    reader->data = (const unsigned char *)mapping;
+    reader->size = (size_t)file_status.st_size;
+#endif
+    reader->mapped = 1;
+    return 0;
+}
+
+static void unmapOrderFile(CutlistOrderReader *reader)
+{
+    if (!reader->mapped)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(reader->data);
+    CloseHandle(reader->mappingHandle);
+    CloseHandle(reader->mappedFile);
+#else
+    munmap((void *)reader->data, reader->size);
+#endif
+    reader->mapped = 0;
+}
+
+static void failOrderRead(CutlistOrderReader *reader, CutlistReadStatus status, long long position)
+{
+    reader->status = status;
+    reader->errorPosition = position;
+}
+
+// Skips a CSV header row, a first row that does not start with a number
+static void skipCsvHeader(CutlistOrderReader *reader)
+{
+    size_t index = 0;
+    while ((index < reader->size) && ((reader->data[index] == ' ') || (reader->data[index] == '\t')))
+    {
+        index++;
+    }
+    if ((index == reader->size) || (reader->data[index] == '-') || ((reader->data[index] >= '0') && (reader->data[index] <= '9')) ||
+        (reader->data[index] == '\r') || (reader->data[index] == '\n'))
+    {
+        return;
+    }
+    const unsigned char *line_end = (const unsigned char *)memchr(reader->data, '\n', reader->size);
+    reader->position = line_end ? (size_t)(line_end - reader->data) + 1 : reader->size;
+    reader->line = 2;
+}
+
+static CutlistOrderReader *createOrderReader(CutlistOrderFormat format, const CutlistInput *defaults)
+{
+    CutlistOrderReader *reader = (CutlistOrderReader *)calloc(1, sizeof(CutlistOrderReader));
+    if (!reader) return NULL;
+
+    reader->format = format;
+    if (defaults)
+    {
+        reader->defaults = *defaults;
+    }
+    reader->defaults.requiredPieces = NULL;
+    reader->defaults.pieceCount = 0;
+    reader->line = 1;
+    return reader;
+}
+
+// Checks the binary file header, or skips the CSV one, once the reader has its bytes
+static void startOrderFile(CutlistOrderReader *reader)
+{
+    if (reader->format == CUTLIST_ORDER_CSV)
+    {
+        skipCsvHeader(reader);
+        return;
+    }
+    if (reader->size == 0)
+    {
+        return;
+    }
+
+    const OrderFileHeader *header = (const OrderFileHeader *)reader->data;
+    if ((reader->size < sizeof(OrderFileHeader)) || (header->magic != CUTLIST_ORDER_MAGIC) || (header->byteOrder != CUTLIST_ORDER_BYTE_ORDER))
+    {
+        failOrderRead(reader, CUTLIST_READ_MALFORMED, 0);
+        return;
+    }
+    reader->position = sizeof(OrderFileHeader);
+}
+
+CutlistOrderReader *openCutlistOrderReader(const char *path, CutlistOrderFormat format, const CutlistInput *defaults)
+{
+    CutlistOrderReader *reader = createOrderReader(format, defaults);
+    if (!reader) return NULL;
+
+    if (!path || (mapOrderFile(reader, path) != 0))
+    {
+        failOrderRead(reader, CUTLIST_READ_OPEN_FAILED, 0);
+        return reader;
+    }
+    startOrderFile(reader);
+    return reader;
+}
+
+CutlistOrderReader *openCutlistOrderReaderFromMemory(const void *data, size_t size, CutlistOrderFormat format,
+                                                     const CutlistInput *defaults)
+{
+    CutlistOrderReader *reader = createOrderReader(format, defaults);
+    if (!reader) return NULL;
+
+    reader->data = (const unsigned char *)data;
+    reader->size = data ? size : 0;
+    startOrderFile(reader);
+    return reader;
+}
+
+void closeCutlistOrderReader(CutlistOrderReader *reader)
+{
+    if (!reader) return;
+
+    unmapOrderFile(reader);
+    free(reader->pieces);
+    free(reader->pieceOffsets);
+    free(reader);
+}
+
+CutlistReadStatus getCutlistOrderReaderStatus(const CutlistOrderReader *reader, long long *position)
+{
+    if (position)
+    {
+        *position = reader->errorPosition;
+    }
+    return reader->status;
+}
+
+// Makes room for count more pieces after used. Returns 0, or -1 if the buffer cannot grow
+static int reserveOrderPieces(CutlistOrderReader *reader, size_t used, size_t count)
+{
+    if (count <= reader->pieceCapacity - used)
+    {
+        return 0;
+    }
+
+    size_t capacity = reader->pieceCapacity ? reader->pieceCapacity : 1024;
+    while (capacity - used < count)
+    {
+        if (capacity > SIZE_MAX / 2 / sizeof(int))
+        {
+            return -1;
+        }
+        capacity *= 2;
+    }
+    int *pieces = (int *)realloc(reader->pieces, capacity * sizeof(int));
+    if (!pieces)
+    {
+        return -1;
+    }
+    reader->pieces = pieces;
+    reader->pieceCapacity = capacity;
+    return 0;
+}
+
+// Appends quantity pieces of one length to the order at the end of the chunk, read at position. Returns 0, or -1 on
+// failure
+static int appendOrderRun(CutlistOrderReader *reader, CutlistOrder *order, size_t *used, long long length, long long quantity,
+                          long long position)
+{
+    if ((length < INT_MIN) || (length > INT_MAX) || (quantity < 0) || (quantity > INT_MAX - order->input.pieceCount))
+    {
+        failOrderRead(reader, CUTLIST_READ_MALFORMED, position);
+        return -1;
+    }
+    if (reserveOrderPieces(reader, *used, (size_t)quantity) != 0)
+    {
+        failOrderRead(reader, CUTLIST_READ_OUT_OF_MEMORY, 0);
+        return -1;
+    }
+
+    int *pieces = &reader->pieces[*used];
+    for (long long count = 0; count < quantity; count++)
+    {
+        pieces[count] = (int)length;
+    }
+    *used += (size_t)quantity;
+    order->input.pieceCount += (int)quantity;
+    return 0;
+}
+
+// Reads one decimal integer field at *index, spaces around it allowed. Returns 0, or -1 if there is none or it overflows
+static int parseCsvNumber(const unsigned char *text, size_t end, size_t *index, long long *value)
+{
+    size_t position = *index;
+    while ((position < end) && ((text[position] == ' ') || (text[position] == '\t')))
+    {
+        position++;
+    }
+    int negative = (position < end) && (text[position] == '-');
+    position += negative;
+    if ((position == end) || (text[position] < '0') || (text[position] > '9'))
+    {
+        return -1;
+    }
+
+    long long number = 0;
+    while ((position < end) && (text[position] >= '0') && (text[position] <= '9'))
+    {
+        if (number > (LLONG_MAX - 9) / 10)
+        {
+            return -1;
+        }
+        number = number * 10 + (text[position++] - '0');
+    }
+    while ((position < end) && ((text[position] == ' ') || (text[position] == '\t')))
+    {
+        position++;
+    }
+
+    *value = negative ? -number : number;
+    *index = position;
+    return 0;
+}
+
+// Reads the next non-blank CSV row. Returns 1 with row and line set, 0 at the end of the file, or -1 if the row is
+// malformed
+static int readCsvRow(CutlistOrderReader *reader, OrderRow *row, long long *line)
+{
+    while (reader->position < reader->size)
+    {
+        const unsigned char *text = reader->data;
+        size_t start = reader->position;
+        const unsigned char *line_end = (const unsigned char *)memchr(text + start, '\n', reader->size - start);
+        size_t end = line_end ? (size_t)(line_end - text) : reader->size;
+        reader->position = line_end ? end + 1 : end;
+        *line = reader->line++;
+        if ((end > start) && (text[end - 1] == '\r'))
+        {
+            end--;
+        }
+
+        size_t index = start;
+        while ((index < end) && ((text[index] == ' ') || (text[index] == '\t')))
+        {
+            index++;
+        }
+        if (index == end)
+        {
+            continue;
+        }
+
+        // order,stock_length,length and an optional quantity, nothing after them
+        long long *fields[] = {&row->orderId, &row->stockLength, &row->length, &row->quantity};
+        row->quantity = 1;
+        for (int field = 0; field < 4; field++)
+        {
+            if (parseCsvNumber(text, end, &index, fields[field]) != 0)
+            {
+                return -1;
+            }
+            if (index == end)
+            {
+                return (field >= 2) ? 1 : -1;
+            }
+            if ((text[index] != ',') || (field == 3))
+            {
+                return -1;
+            }
+            index++;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static size_t readCsvOrders(CutlistOrderReader *reader, CutlistOrder *orders, size_t capacity)
+{
+    size_t count = 0;
+    size_t used = 0;
+    int in_order = 0;
+    for (;;)
+    {
+        OrderRow row;
+        long long line = 0;
+        if (reader->hasPendingRow)
+        {
+            row = reader->pendingRow;
+            line = reader->pendingLine;
+            reader->hasPendingRow = 0;
+        }
+        else
+        {
+            int parsed = readCsvRow(reader, &row, &line);
+            if (parsed == 0)
+            {
+                break;
+            }
+            if (parsed < 0)
+            {
+                failOrderRead(reader, CUTLIST_READ_MALFORMED, line);
+                return count;
+            }
+        }
+
+        // A row of another order ends this one, and is kept for the next chunk if this one is full
+        if (in_order && (row.orderId != orders[count].orderId))
+        {
+            in_order = 0;
+            if (++count == capacity)
+            {
+                reader->pendingRow = row;
+                reader->pendingLine = line;
+                reader->hasPendingRow = 1;
+                return count;
+            }
+        }
+
+        CutlistOrder *order = &orders[count];
+        if (!in_order)
+        {
+            order->orderId = row.orderId;
+            order->input = reader->defaults;
+            order->input.stockLength = (int)row.stockLength;
+            reader->pieceOffsets[count] = used;
+            in_order = 1;
+        }
+        if ((row.stockLength < INT_MIN) || (row.stockLength > INT_MAX) || (row.stockLength != order->input.stockLength))
+        {
+            failOrderRead(reader, CUTLIST_READ_MALFORMED, line);
+            return count;
+        }
+        if (appendOrderRun(reader, order, &used, row.length, row.quantity, line) != 0)
+        {
+            return count;
+        }
+    }
+    return count + in_order;
+}
+
+static size_t readBinaryOrders(CutlistOrderReader *reader, CutlistOrder *orders, size_t capacity)
+{
+    size_t count = 0;
+    size_t used = 0;
+    while ((count < capacity) && (reader->position < reader->size))
+    {
+        size_t offset = reader->position;
+        size_t bytes_left = reader->size - offset;
+        const OrderRecord *record = (const OrderRecord *)(reader->data + offset);
+        if ((bytes_left < sizeof(OrderRecord)) || (record->recordBytes < sizeof(OrderRecord)) || (record->recordBytes % 8 != 0) ||
+            (record->recordBytes > bytes_left) || (record->entryCount < 0) || (record->flags & ~CUTLIST_ORDER_RUNS) ||
+            (record->stockLength < 0))
+        {
+            failOrderRead(reader, CUTLIST_READ_MALFORMED, (long long)offset);
+            return count;
+        }
+        int runs = (record->flags & CUTLIST_ORDER_RUNS) != 0;
+        size_t data_bytes = (size_t)record->entryCount * sizeof(int32_t) * (runs ? 2 : 1);
+        if ((sizeof(OrderRecord) + data_bytes + 7) / 8 * 8 != record->recordBytes)
+        {
+            failOrderRead(reader, CUTLIST_READ_MALFORMED, (long long)offset);
+            return count;
+        }
+
+        CutlistOrder *order = &orders[count];
+        order->orderId = record->orderId;
+        order->input = reader->defaults;
+        order->input.stockLength = record->stockLength;
+        order->input.kerfWidth = record->kerfWidth;
+        order->input.trimLength = record->trimLength;
+        if (runs)
+        {
+            reader->pieceOffsets[count] = used;
+            for (int run_index = 0; run_index < record->entryCount; run_index++)
+            {
+                if (appendOrderRun(reader, order, &used, record->data[2 * run_index], record->data[2 * run_index + 1], (long long)offset) != 0)
+                {
+                    return count;
+                }
+            }
+        }
+        else
+        {
+            // Stored one length per piece, so the solver reads them straight from the mapping
+            reader->pieceOffsets[count] = SIZE_MAX;
+            order->input.requiredPieces = (const int *)record->data;
+            order->input.pieceCount = record->entryCount;
+        }
+        reader->position += record->recordBytes;
+        count++;
+    }
+    return count;
+}
+
+size_t readCutlistOrders(CutlistOrderReader *reader, CutlistOrder *orders, size_t capacity)
+{
+    if (capacity == 0)
+    {
+        capacity = CUTLIST_ORDER_CHUNK_DEFAULT;
+    }
+    if (reader->status != CUTLIST_READ_OK)
+    {
+        return 0;
+    }
+    if (capacity > reader->offsetCapacity)
+    {
+        size_t *offsets = (size_t *)realloc(reader->pieceOffsets, capacity * sizeof(size_t));
+        if (!offsets)
+        {
+            failOrderRead(reader, CUTLIST_READ_OUT_OF_MEMORY, 0);
+            return 0;
+        }
+        reader->pieceOffsets = offsets;
+        reader->offsetCapacity = capacity;
+    }
+
+    size_t count = (reader->format == CUTLIST_ORDER_CSV) ? readCsvOrders(reader, orders, capacity) :
+                                                           readBinaryOrders(reader, orders, capacity);
+
+    // The piece buffer may have moved while the chunk grew, so expanded orders get their pointers once it is done
+    for (size_t order_index = 0; order_index < count; order_index++)
+    {
+        if (reader->pieceOffsets[order_index] != SIZE_MAX)
+        {
+            orders[order_index].input.requiredPieces = (orders[order_index].input.pieceCount > 0) ?
+                                                       &reader->pieces[reader->pieceOffsets[order_index]] : NULL;
+        }
+    }
+    return count;
+}
+
+CutlistSinkError writeCutlistOrderHeader(CutlistSink *sink, CutlistOrderFormat format)
+{
+    if (format == CUTLIST_ORDER_CSV)
+    {
+        return appendToCutlistSink(sink, CUTLIST_ORDER_CSV_HEADER, strlen(CUTLIST_ORDER_CSV_HEADER));
+    }
+    OrderFileHeader header = {CUTLIST_ORDER_MAGIC, CUTLIST_ORDER_BYTE_ORDER};
+    return appendToCutlistSink(sink, (const char *)&header, sizeof(header));
+}
+
+// Returns the number of runs of equal lengths next to each other
+static int countOrderRuns(const int *pieces, int pieceCount)
+{
+    int run_count = 0;
+    for (int piece_index = 0; piece_index < pieceCount; piece_index++)
+    {
+        run_count += (piece_index == 0) || (pieces[piece_index] != pieces[piece_index - 1]);
+    }
+    return run_count;
+}
+
+CutlistSinkError writeCutlistOrder(CutlistSink *sink, CutlistOrderFormat format, long long orderId, const CutlistInput *input)
+{
+    const int *pieces = input->requiredPieces;
+    int piece_count = input->pieceCount;
+    if (format == CUTLIST_ORDER_CSV)
+    {
+        // An order without pieces is one row of quantity 0, so it is read back rather than lost
+        char row[96];
+        if (piece_count == 0)
+        {
+            int length = snprintf(row, sizeof(row), "%lld,%d,0,0\n", orderId, input->stockLength);
+            return appendToCutlistSink(sink, row, (size_t)length);
+        }
+        for (int piece_index = 0; piece_index < piece_count;)
+        {
+            int run_end = piece_index + 1;
+            while ((run_end < piece_count) && (pieces[run_end] == pieces[piece_index]))
+            {
+                run_end++;
+            }
+            int length = snprintf(row, sizeof(row), "%lld,%d,%d,%d\n", orderId, input->stockLength, pieces[piece_index], run_end - piece_index);
+            appendToCutlistSink(sink, row, (size_t)length);
+            piece_index = run_end;
+        }
+        return sink->error;
+    }
+
+    // Runs only when they are smaller than the lengths themselves, which are then readable in place
+    int run_count = countOrderRuns(pieces, piece_count);
+    int runs = 2 * run_count < piece_count;
+    int entry_count = runs ? run_count : piece_count;
+    size_t data_bytes = (size_t)entry_count * sizeof(int32_t) * (runs ? 2 : 1);
+    OrderRecord record = {0};
+    record.recordBytes = (uint32_t)((sizeof(OrderRecord) + data_bytes + 7) / 8 * 8);
+    record.flags = runs ? CUTLIST_ORDER_RUNS : 0;
+    record.orderId = orderId;
+    record.stockLength = input->stockLength;
+    record.kerfWidth = input->kerfWidth;
+    record.trimLength = input->trimLength;
+    record.entryCount = entry_count;
+    appendToCutlistSink(sink, (const char *)&record, sizeof(record));
+
+    if (!runs)
+    {
+        appendToCutlistSink(sink, (const char *)pieces, (size_t)piece_count * sizeof(int32_t));
+    }
+    else
+    {
+        int32_t staged[2 * CUTLIST_ORDER_WRITE_CHUNK];
+        int staged_count = 0;
+        for (int piece_index = 0; piece_index < piece_count;)
+        {
+            int run_end = piece_index + 1;
+            while ((run_end < piece_count) && (pieces[run_end] == pieces[piece_index]))
+            {
+                run_end++;
+            }
+            staged[staged_count++] = pieces[piece_index];
+            staged[staged_count++] = run_end - piece_index;
+            if (staged_count == 2 * CUTLIST_ORDER_WRITE_CHUNK)
+            {
+                appendToCutlistSink(sink, (const char *)staged, (size_t)staged_count * sizeof(int32_t));
+                staged_count = 0;
+            }
+            piece_index = run_end;
+        }
+        appendToCutlistSink(sink, (const char *)staged, (size_t)staged_count * sizeof(int32_t));
+    }
+
+    size_t padding = record.recordBytes - sizeof(OrderRecord) - data_bytes;
+    if (padding > 0)
+    {
+        const char zeroes[8] = {0};
+        appendToCutlistSink(sink, zeroes, padding);
+    }
+    return sink->error;
+}
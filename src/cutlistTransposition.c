@@ -0,0 +1,155 @@
+#include "cutlistTransposition.h"
+
+#include <string.h>
+
+// Buckets for about entryCount entries, rounded down to a power of two so a hash picks its bucket with a mask
+static size_t getTranspositionBucketCount(long long entryCount)
+{
+    size_t bucket_count = 1;
+    while ((long long)(bucket_count * 2 * CUTLIST_TRANSPOSITION_BUCKET_SIZE) <= entryCount)
+    {
+        bucket_count *= 2;
+    }
+    return bucket_count;
+}
+
+size_t getTranspositionEntryBytes(long long entryCount)
+{
+    return getTranspositionBucketCount(entryCount) * CUTLIST_TRANSPOSITION_BUCKET_SIZE * sizeof(TranspositionEntry);
+}
+
+// SplitMix64, a fixed sequence so hashes are the same on every run and platform
+static uint64_t getNextRandomKey(uint64_t *seed)
+{
+    uint64_t mixed = (*seed += 0x9E3779B97F4A7C15ull);
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+    return mixed ^ (mixed >> 31);
+}
+
+// Random key of a remaining-space value, one for stocks still open to the next piece and one for stocks ruled out. It is
+// the value's own place in the SplitMix64 sequence, so no table over every space up to the stock length is needed
+static uint64_t getSpaceKey(int space, int closed)
+{
+    uint64_t seed = 0x5EED + 0x9E3779B97F4A7C15ull * (2 * (uint64_t)(uint32_t)space + (uint64_t)closed);
+    return getNextRandomKey(&seed);
+}
+
+void initTranspositionTable(TranspositionTable *table, void *entryMemory, long long entryCount)
+{
+    table->entries = (TranspositionEntry *)entryMemory;
+    table->bucketCount = getTranspositionBucketCount(entryCount);
+    table->hits = 0;
+    table->misses = 0;
+    table->stores = 0;
+    table->replacements = 0;
+    memset(table->entries, 0, table->bucketCount * CUTLIST_TRANSPOSITION_BUCKET_SIZE * sizeof(TranspositionEntry));
+}
+
+// Final mix so the bucket bits depend on every key, keeping 0 free to mark empty entries
+static uint64_t finishHash(uint64_t hash)
+{
+    hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    return (hash != 0) ? hash : 1;
+}
+
+// Sum of the keys of every open stock, on top of a key for the next piece to place
+static uint64_t sumStateKeys(const int *remainingSpace, int stockCount, int firstStock, int deadSpace, int pieceIndex)
+{
+    // Summing keys hashes the multiset of spaces, the same as hashing them sorted without the sort
+    uint64_t hash = (uint64_t)(pieceIndex + 1) * 0x9E3779B97F4A7C15ull;
+    for (int stock_index = 0; stock_index < stockCount; stock_index++)
+    {
+        int space = remainingSpace[stock_index];
+        if (space < deadSpace)
+        {
+            hash += getSpaceKey(0, 0);
+        }
+        else
+        {
+            hash += getSpaceKey(space, stock_index < firstStock);
+        }
+    }
+    return hash;
+}
+
+uint64_t hashSearchState(const int *remainingSpace, int stockCount, int firstStock, int deadSpace, int pieceIndex)
+{
+    return finishHash(sumStateKeys(remainingSpace, stockCount, firstStock, deadSpace, pieceIndex));
+}
+
+uint64_t hashCatalogueSearchState(const int *remainingSpace, int stockCount, int firstStock, int deadSpace, int pieceIndex,
+                                  const int *stockTypeOnHand, int typeCount)
+{
+    uint64_t hash = sumStateKeys(remainingSpace, stockCount, firstStock, deadSpace, pieceIndex);
+
+    // One fixed random key per kind, counted once per stock on hand. Unlimited kinds never change their count
+    uint64_t seed = 0xCA7A;
+    for (int type_index = 0; type_index < typeCount; type_index++)
+    {
+        hash += (uint64_t)stockTypeOnHand[type_index] * getNextRandomKey(&seed);
+    }
+    return finishHash(hash);
+}
+
+uint64_t hashRemainingDemand(const int *classSizes, const int *classCounts, int classCount)
+{
+    uint64_t hash = 0;
+    for (int class_index = 0; class_index < classCount; class_index++)
+    {
+        hash += (uint64_t)classCounts[class_index] * getSpaceKey(classSizes[class_index], 0);
+    }
+    return finishHash(hash);
+}
+
+int probeTransposition(TranspositionTable *table, uint64_t key, int *stockBound)
+{
+    TranspositionEntry *bucket = &table->entries[(key & (table->bucketCount - 1)) * CUTLIST_TRANSPOSITION_BUCKET_SIZE];
+    for (int slot = 0; slot < CUTLIST_TRANSPOSITION_BUCKET_SIZE; slot++)
+    {
+        if (bucket[slot].key == key)
+        {
+            *stockBound = bucket[slot].stockBound;
+            table->hits++;
+            return 1;
+        }
+    }
+
+    table->misses++;
+    return 0;
+}
+
+// Replacement keeps the states with the most pieces left to place, whose subtrees cost the most to search again.
+// A new state always gets stored, so deep states still get reused while their part of the tree is being searched
+void storeTransposition(TranspositionTable *table, uint64_t key, int pieceIndex, int stockBound)
+{
+    TranspositionEntry *bucket = &table->entries[(key & (table->bucketCount - 1)) * CUTLIST_TRANSPOSITION_BUCKET_SIZE];
+    TranspositionEntry *victim = &bucket[0];
+
+    for (int slot = 0; slot < CUTLIST_TRANSPOSITION_BUCKET_SIZE; slot++)
+    {
+        TranspositionEntry *entry = &bucket[slot];
+        if ((entry->key == key) || (entry->key == 0))
+        {
+            // Both bounds hold, so keep the stronger one
+            if ((entry->key == 0) || (stockBound > entry->stockBound))
+            {
+                entry->stockBound = stockBound;
+            }
+            entry->key = key;
+            entry->pieceIndex = pieceIndex;
+            table->stores++;
+            return;
+        }
+        if (entry->pieceIndex > victim->pieceIndex)
+        {
+            victim = entry;
+        }
+    }
+
+    victim->key = key;
+    victim->stockBound = stockBound;
+    victim->pieceIndex = pieceIndex;
+    table->replacements++;
+}
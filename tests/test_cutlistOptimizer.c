@@ -1,6 +1,16 @@
 #include "unity.h"
 #include "cutlistOptimizer.h"
-
+#include "cutlistBatch.h"
+#include "cutlistCache.h"
+#include "cutlistDemand.h"
+#include "cutlistFormat.h"
+#include "cutlistIncremental.h"
+#include "cutlistKernels.h"
+#include "cutlistLocalSearch.h"
+#include "cutlistReader.h"
+#include "cutlistTransposition.h"
+
+#include <pthread.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -23,8 +33,8 @@ void testWhenGreedyAlgorithmIsSufficient(void)
     // Stock #1: [100, 80]    (20 leftover)
     // Stock #2: [75, 50, 25] (50 leftover)
     
-    // rearranged required list = 100, 80, 75, 50, 25
-    int expected_assignments[]  =  {0,  0,  1,  1,  1};  // Expected stock indices per piece
+    // required list          =  50, 75, 100, 25, 80
+    int expected_assignments[]  =  {1,  1,  0,   1,  0};  // Expected stock indices per piece, in input order
 
     for (int i = 0; i < input.pieceCount; i++) 
     {
@@ -64,8 +74,8 @@ void testWhenGreedyAlgorithmIsNotSufficient(void)
     // Stock #2: [65, 60, 45] (30 leftover)
     // Stock #3: [35]         (165 leftover)
     
-    // rearranged required list = 120, 70, 65, 60, 45, 35
-    int expected_assignments[]  =  {0,  1,  1,  1,  0,  0};  // Expected stock indices per piece
+    // required list          =  60, 35, 45, 65, 70, 120
+    int expected_assignments[]  =  {1,  0,  0,  1,  1,  0};  // Expected stock indices per piece, in input order
 
     for (int i = 0; i < input.pieceCount; i++) 
     {
@@ -251,6 +261,798 @@ void testCutlistOptimizationWithVeryLargeDataset(void)
     free(result.assignments);
 }
 
+void testLargeDatasetReachesLowerBound(void) 
+{
+    int required[20];
+    int stockLength = 1000;
+
+    for (int i = 0; i < 20; i++) 
+    {
+        required[i] = (i % 10) * 25 + 10;
+    }
+
+    CutlistInput input = {required, 20, stockLength};  
+
+    CutlistResult result;
+    result.assignments = (int *)malloc(input.pieceCount * sizeof(int)); 
+    optimizeCutlist(input, &result);
+
+    // Pieces add up to 2450, so 3 stocks is the best possible and the search must find it
+    TEST_ASSERT_EQUAL_INT(3, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(3 * 1000 - 2450, result.waste);
+
+    // Every stock must hold no more than its length
+    int used_length[20] = {0};
+    for (int i = 0; i < input.pieceCount; i++) 
+    {
+        TEST_ASSERT_TRUE(result.assignments[i] >= 0 && result.assignments[i] < result.stockUsed);
+        used_length[result.assignments[i]] += required[i];
+    }
+    for (int i = 0; i < result.stockUsed; i++) 
+    {
+        TEST_ASSERT_TRUE(used_length[i] <= stockLength);
+    }
+
+    free(result.assignments);
+}
+
+void testRepeatedLengthsProveOptimum(void) 
+{
+    // Few distinct lengths with many copies each; the optimum (14) is one above the lower bound (13),
+    // so the search has to exhaust the tree to prove it
+    int required[33];
+    int piece_count = 0;
+    for (int i = 0; i < 12; i++) required[piece_count++] = 34;
+    for (int i = 0; i < 12; i++) required[piece_count++] = 33;
+    for (int i = 0; i < 9; i++) required[piece_count++] = 45;
+
+    CutlistInput input = {required, piece_count, 100};  
+
+    CutlistResult result;
+    result.assignments = (int *)malloc(input.pieceCount * sizeof(int)); 
+    optimizeCutlist(input, &result);
+
+    TEST_ASSERT_EQUAL_INT(14, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(14 * 100 - 1209, result.waste);
+
+    free(result.assignments);
+}
+
+void testComputeStockLowerBound(void) 
+{
+    // Total length bound: 250 / 100 rounds up to 3
+    int sum_bound_pieces[] = {50, 50, 50, 50, 50};
+    TEST_ASSERT_EQUAL_INT(3, computeStockLowerBound(sum_bound_pieces, 5, 100));
+
+    // No two pieces longer than half a stock can share one, even though the total length fits in 2
+    int large_pieces[] = {70, 70, 70};
+    TEST_ASSERT_EQUAL_INT(3, computeStockLowerBound(large_pieces, 3, 120));
+
+    // 45s cannot join the 60s, and three 45s need two stocks of their own
+    int mixed_pieces[] = {60, 60, 45, 45, 45};
+    TEST_ASSERT_EQUAL_INT(4, computeStockLowerBound(mixed_pieces, 5, 100));
+
+    TEST_ASSERT_EQUAL_INT(0, computeStockLowerBound(NULL, 0, 100));
+}
+
+void testTracingDoesNotChangeResult(void) 
+{
+    int required[] = {60, 35, 45, 65, 70, 120};
+    CutlistTraceLevel levels[] = {CUTLIST_TRACE_OFF, CUTLIST_TRACE_SUMMARY, CUTLIST_TRACE_FULL};
+    int expected_assignments[] = {1, 0, 0, 1, 1, 0};
+
+    for (int level = 0; level < 3; level++) 
+    {
+        CutlistInput input = {required, 6, 200, levels[level]};
+
+        CutlistResult result;
+        result.assignments = (int *)malloc(input.pieceCount * sizeof(int)); 
+        optimizeCutlist(input, &result);
+
+        TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+        TEST_ASSERT_EQUAL_INT(5, result.waste);
+        for (int i = 0; i < input.pieceCount; i++) 
+        {
+            TEST_ASSERT_EQUAL_INT(expected_assignments[i], result.assignments[i]);
+        }
+
+        free(result.assignments);
+    }
+}
+
+void testInputIsNotModified(void) 
+{
+    int required[] = {25, 100, 50, 100, 75, 25};
+    int original[] = {25, 100, 50, 100, 75, 25};
+    CutlistInput input = {required, 6, 200};
+
+    CutlistResult result;
+    result.assignments = (int *)malloc(input.pieceCount * sizeof(int)); 
+    optimizeCutlist(input, &result);
+
+    TEST_ASSERT_EQUAL_INT_ARRAY(original, required, 6);
+
+    // Sorted: 100, 100, 75, 50, 25, 25 -> Stock #1: [100, 100], Stock #2: [75, 50, 25, 25]
+    // Equal lengths keep their input order, so the assignments map back to the caller's pieces
+    int expected_assignments[] = {1, 0, 1, 0, 1, 1};
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT_ARRAY(expected_assignments, result.assignments, 6);
+
+    free(result.assignments);
+}
+
+void testSortsManyPieces(void) 
+{
+    // Enough pieces that a quadratic sort would stand out, with lengths spanning more than one radix byte
+    enum { PIECE_COUNT = 10000 };
+    int *required = (int *)malloc(PIECE_COUNT * sizeof(int));
+    for (int i = 0; i < PIECE_COUNT; i++) 
+    {
+        required[i] = 1000 + (int)((i * 7919L) % 4000);
+    }
+
+    CutlistInput input = {required, PIECE_COUNT, 6000};
+    CutlistResult result;
+    result.assignments = (int *)malloc(input.pieceCount * sizeof(int)); 
+    optimizeCutlist(input, &result);
+
+    // Every stock must hold no more than its length
+    int *used_length = (int *)calloc(PIECE_COUNT, sizeof(int));
+    for (int i = 0; i < PIECE_COUNT; i++) 
+    {
+        TEST_ASSERT_TRUE(result.assignments[i] >= 0 && result.assignments[i] < result.stockUsed);
+        used_length[result.assignments[i]] += required[i];
+    }
+    for (int i = 0; i < result.stockUsed; i++) 
+    {
+        TEST_ASSERT_TRUE(used_length[i] <= 6000);
+    }
+
+    free(used_length);
+    free(result.assignments);
+    free(required);
+}
+
+void testParallelSearchMatchesSerial(void) 
+{
+    // 24 lengths from a fixed LCG; the optimum (12 stocks) is above the lower bound, so the whole tree is searched
+    int required[24];
+    unsigned int seed = 32;
+    for (int i = 0; i < 24; i++) 
+    {
+        seed = seed * 1103515245u + 12345u;
+        required[i] = 200 + (int)((seed >> 16) % 400);
+    }
+
+    CutlistInput input = {required, 24, 1000};
+    int serial_assignments[24];
+    CutlistResult serial_result;
+    serial_result.assignments = serial_assignments;
+    optimizeCutlist(input, &serial_result);
+    TEST_ASSERT_EQUAL_INT(12, serial_result.stockUsed);
+
+    // Every thread count must return exactly the serial packing, not just one as good
+    int thread_counts[] = {2, 4, 7};
+    for (int i = 0; i < 3; i++) 
+    {
+        input.threadCount = thread_counts[i];
+        int parallel_assignments[24];
+        CutlistResult parallel_result;
+        parallel_result.assignments = parallel_assignments;
+        optimizeCutlist(input, &parallel_result);
+
+        TEST_ASSERT_EQUAL_INT(serial_result.stockUsed, parallel_result.stockUsed);
+        TEST_ASSERT_EQUAL_INT(serial_result.waste, parallel_result.waste);
+        TEST_ASSERT_EQUAL_INT_ARRAY(serial_assignments, parallel_assignments, 24);
+    }
+
+    // More threads than the tree has tasks still works
+    int small[] = {60, 35, 45, 65, 70, 120};
+    int expected_assignments[] = {1, 0, 0, 1, 1, 0};
+    CutlistInput small_input = {small, 6, 200, CUTLIST_TRACE_OFF, 64};
+    int small_assignments[6];
+    CutlistResult small_result;
+    small_result.assignments = small_assignments;
+    optimizeCutlist(small_input, &small_result);
+    TEST_ASSERT_EQUAL_INT(2, small_result.stockUsed);
+    TEST_ASSERT_EQUAL_INT_ARRAY(expected_assignments, small_assignments, 6);
+}
+
+// Fills pieces with lengths in [200, 600) from a fixed LCG, the same on every platform
+static void generateHardOrder(unsigned int seed, int *pieces, int pieceCount)
+{
+    for (int i = 0; i < pieceCount; i++) 
+    {
+        seed = seed * 1103515245u + 12345u;
+        pieces[i] = 200 + (int)((seed >> 16) % 400);
+    }
+}
+
+// Asserts every piece is on a stock in [0, stockUsed) and no stock holds more than its length
+static void assertValidPacking(const int *pieces, int pieceCount, int stockLength, const CutlistResult *result)
+{
+    long long *used_length = (long long *)calloc(pieceCount + 1, sizeof(long long));
+    for (int i = 0; i < pieceCount; i++) 
+    {
+        TEST_ASSERT_TRUE(result->assignments[i] >= 0 && result->assignments[i] < result->stockUsed);
+        used_length[result->assignments[i]] += pieces[i];
+    }
+    for (int i = 0; i < result->stockUsed; i++) 
+    {
+        TEST_ASSERT_TRUE(used_length[i] <= stockLength);
+    }
+    free(used_length);
+}
+
+void testGreedyStrategies(void) 
+{
+    int required[] = {60, 35, 45, 65, 70, 120};
+    int assignments[6];
+    CutlistResult result;
+    result.assignments = assignments;
+
+    // First fit: [120, 70], [65, 60, 45], [35]
+    CutlistInput input = {required, 6, 200, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_FIRST_FIT_DECREASING};
+    optimizeCutlist(input, &result);
+    int first_fit_assignments[] = {1, 2, 1, 1, 0, 0};
+    TEST_ASSERT_EQUAL_INT(3, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(3 * 200 - 395, result.waste);
+    TEST_ASSERT_EQUAL_INT_ARRAY(first_fit_assignments, assignments, 6);
+    TEST_ASSERT_EQUAL_INT(2, result.stockLowerBound);
+    TEST_ASSERT_FALSE(result.provenOptimal);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0 / 3.0, result.optimalityGap);
+
+    // Best fit opens the same three stocks
+    input.strategy = CUTLIST_STRATEGY_BEST_FIT_DECREASING;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(3, result.stockUsed);
+    assertValidPacking(required, 6, 200, &result);
+
+    // Best fit puts 40 on the stock it fills exactly: [90, 10], [60, 40], [50, 30]
+    int tight[] = {90, 60, 50, 40, 30, 10};
+    CutlistInput tight_input = {tight, 6, 100, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_BEST_FIT_DECREASING};
+    optimizeCutlist(tight_input, &result);
+    TEST_ASSERT_EQUAL_INT(3, result.stockUsed);
+    TEST_ASSERT_TRUE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(result.assignments[1], result.assignments[3]);
+}
+
+void testExactSearchProvesOptimality(void) 
+{
+    int required[] = {60, 35, 45, 65, 70, 120};
+    int assignments[6];
+    CutlistResult result;
+    result.assignments = assignments;
+
+    CutlistInput input = {required, 6, 200};
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_TRUE(result.provenOptimal);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, result.optimalityGap);
+}
+
+void testNodeBudgetReturnsBestSoFar(void) 
+{
+    // Takes about a minute to prove optimal, so a small node budget has to cut it short
+    int required[26];
+    generateHardOrder(30, required, 26);
+
+    CutlistSolveOptions options = {0.0, 5000};
+    int assignments[26];
+    CutlistResult result;
+    result.assignments = assignments;
+
+    int thread_counts[] = {1, 3};
+    for (int i = 0; i < 2; i++) 
+    {
+        CutlistInput input = {required, 26, 1000, CUTLIST_TRACE_OFF, thread_counts[i], CUTLIST_STRATEGY_EXACT, &options};
+        optimizeCutlist(input, &result);
+
+        TEST_ASSERT_FALSE(result.provenOptimal);
+        TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_NODE_LIMIT, result.stopReason);
+        TEST_ASSERT_TRUE(result.stockUsed >= result.stockLowerBound);
+        TEST_ASSERT_TRUE(result.optimalityGap > 0.0);
+        assertValidPacking(required, 26, 1000, &result);
+    }
+}
+
+void testTimeBudgetReturnsQuickly(void) 
+{
+    int required[26];
+    generateHardOrder(30, required, 26);
+
+    CutlistSolveOptions options = {0.05, 0};
+    int assignments[26];
+    CutlistResult result;
+    result.assignments = assignments;
+    CutlistInput input = {required, 26, 1000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_EXACT, &options};
+
+    optimizeCutlist(input, &result);
+
+    TEST_ASSERT_FALSE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_TIME_LIMIT, result.stopReason);
+    TEST_ASSERT_TRUE(result.stats.nodesExpanded > 0);
+    TEST_ASSERT_TRUE(result.stockUsed >= result.stockLowerBound);
+    assertValidPacking(required, 26, 1000, &result);
+}
+
+typedef struct {
+    int calls;
+    int lastStockUsed;
+    atomic_int *cancel;
+} ProgressLog;
+
+// Checks every improvement is better than the one before, and cancels the solve once it has seen enough of them
+static void logProgress(const CutlistImprovement *improvement, void *userData)
+{
+    ProgressLog *log = (ProgressLog *)userData;
+    TEST_ASSERT_TRUE((log->calls == 0) || (improvement->stockUsed <= log->lastStockUsed));
+    log->calls++;
+    log->lastStockUsed = improvement->stockUsed;
+    if (log->cancel)
+    {
+        atomic_store(log->cancel, 1);
+    }
+}
+
+void testCancellationAndProgress(void) 
+{
+    int required[26];
+    generateHardOrder(30, required, 26);
+    int assignments[26];
+    CutlistResult result;
+    result.assignments = assignments;
+
+    // Every improvement reaches the callback, on one thread or several, ending with the packing returned
+    ProgressLog log = {0, 0, NULL};
+    CutlistSolveOptions options = {0, 20000};
+    options.onImprovement = logProgress;
+    options.userData = &log;
+    CutlistInput input = {required, 26, 1000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_BRANCH_AND_BOUND, &options};
+    for (int threads = 1; threads <= 3; threads += 2)
+    {
+        log.calls = 0;
+        input.threadCount = threads;
+        optimizeCutlist(input, &result);
+        TEST_ASSERT_EQUAL_INT(result.stats.improvementCount, log.calls);
+        TEST_ASSERT_EQUAL_INT(result.stockUsed, log.lastStockUsed);
+    }
+
+    // Cancelling from the callback on the greedy packing stops a search that would take a minute at its first budget
+    // check, keeping the greedy packing. A flag set before the solve stops it just the same
+    atomic_int cancel;
+    atomic_init(&cancel, 0);
+    log.cancel = &cancel;
+    options.nodeLimit = 0;
+    options.cancelRequested = &cancel;
+    for (int threads = 1; threads <= 3; threads += 2)
+    {
+        log.calls = 0;
+        input.threadCount = threads;
+        optimizeCutlist(input, &result);
+        TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+        TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_CANCELLED, result.stopReason);
+        TEST_ASSERT_FALSE(result.provenOptimal);
+        TEST_ASSERT_TRUE(result.stats.nodesExpanded <= CUTLIST_BUDGET_CHECK_INTERVAL * threads);
+        assertValidPacking(required, 26, 1000, &result);
+    }
+}
+
+void testStockKernelsMatchScalarScan(void) 
+{
+    // Spaces from a small range so there are plenty of repeats, and every start and length around the vector widths
+    int remaining_space[150];
+    unsigned int seed = 7;
+    for (int i = 0; i < 150; i++) 
+    {
+        seed = seed * 1103515245u + 12345u;
+        remaining_space[i] = (int)((seed >> 16) % 20);
+    }
+
+    for (int first_stock = 0; first_stock < 20; first_stock++) 
+    {
+        for (int stock_count = first_stock; stock_count <= 150; stock_count++) 
+        {
+            int piece_size = (first_stock + stock_count) % 21;
+
+            uint64_t expected_mask = 0;
+            long long expected_space = 0;
+            for (int i = first_stock; (i < stock_count) && (i < first_stock + CUTLIST_STOCK_MASK_WIDTH); i++) 
+            {
+                expected_mask |= (uint64_t)(remaining_space[i] >= piece_size) << (i - first_stock);
+            }
+            for (int i = 0; i < stock_count; i++) 
+            {
+                expected_space += (remaining_space[i] >= piece_size) ? remaining_space[i] : 0;
+            }
+
+            TEST_ASSERT_TRUE(getFittingStockMask(remaining_space, first_stock, stock_count, piece_size) == expected_mask);
+            TEST_ASSERT_TRUE(sumFittingStockSpace(remaining_space, stock_count, piece_size) == expected_space);
+
+            int expected_found = 0;
+            for (int i = first_stock; i < stock_count; i++) 
+            {
+                expected_found |= (remaining_space[i] == piece_size);
+            }
+            TEST_ASSERT_EQUAL_INT(expected_found, containsStockSpace(remaining_space, first_stock, stock_count, piece_size));
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, getLowestSetBit(1));
+    TEST_ASSERT_EQUAL_INT(63, getLowestSetBit((uint64_t)1 << 63));
+}
+
+void testTranspositionTableKeepsPacking(void) 
+{
+    int required[24];
+    generateHardOrder(32, required, 24);
+
+    // No table, a single full bucket that replaces constantly, and the default size
+    CutlistSolveOptions options[] = {{0.0, 0, -1}, {0.0, 0, CUTLIST_TRANSPOSITION_BUCKET_SIZE}, {0.0, 0, 0}};
+    int assignments[3][24];
+    long long node_counts[3];
+    long long hit_counts[3];
+
+    for (int i = 0; i < 3; i++) 
+    {
+        CutlistSolver *solver = createCutlistSolver(24);
+        CutlistResult result;
+        result.assignments = assignments[i];
+        CutlistInput input = {required, 24, 1000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_EXACT, &options[i]};
+
+        TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, input, &result));
+        TEST_ASSERT_EQUAL_INT(12, result.stockUsed);
+        TEST_ASSERT_TRUE(result.provenOptimal);
+
+        node_counts[i] = solver->state.nodeCount;
+        hit_counts[i] = solver->state.transpositions ? solver->state.transpositions->hits : 0;
+        destroyCutlistSolver(solver);
+    }
+
+    TEST_ASSERT_EQUAL_INT_ARRAY(assignments[0], assignments[1], 24);
+    TEST_ASSERT_EQUAL_INT_ARRAY(assignments[0], assignments[2], 24);
+    TEST_ASSERT_TRUE(hit_counts[2] > 0);
+    TEST_ASSERT_TRUE(node_counts[2] < node_counts[0]);
+}
+
+void testPatternEngineMatchesBranchAndBound(void) 
+{
+    unsigned int seed = 11;
+    for (int order = 0; order < 40; order++) 
+    {
+        // A handful of distinct lengths, repeated
+        int sizes[5];
+        int required[40];
+        int piece_count = 10 + order % 25;
+        for (int i = 0; i < 5; i++) 
+        {
+            seed = seed * 1103515245u + 12345u;
+            sizes[i] = 20 + (int)((seed >> 16) % 160);
+        }
+        for (int i = 0; i < piece_count; i++) 
+        {
+            seed = seed * 1103515245u + 12345u;
+            required[i] = sizes[(seed >> 16) % 5];
+        }
+
+        int pattern_assignments[40];
+        int search_assignments[40];
+        CutlistResult pattern_result;
+        CutlistResult search_result;
+        pattern_result.assignments = pattern_assignments;
+        search_result.assignments = search_assignments;
+
+        CutlistInput input = {required, piece_count, 200, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_PATTERNS};
+        optimizeCutlist(input, &pattern_result);
+        input.strategy = CUTLIST_STRATEGY_BRANCH_AND_BOUND;
+        optimizeCutlist(input, &search_result);
+
+        TEST_ASSERT_TRUE(pattern_result.provenOptimal);
+        TEST_ASSERT_EQUAL_INT(search_result.stockUsed, pattern_result.stockUsed);
+        TEST_ASSERT_EQUAL_INT(search_result.waste, pattern_result.waste);
+        assertValidPacking(required, piece_count, 200, &pattern_result);
+    }
+}
+
+void testPatternEngineSolvesLargeOrder(void) 
+{
+    // 300 pieces in 12 lengths on 6 m stocks, far beyond what placing one piece at a time can prove
+    int sizes[12];
+    int required[300];
+    unsigned int seed = 5;
+    for (int i = 0; i < 12; i++) 
+    {
+        seed = seed * 1103515245u + 12345u;
+        sizes[i] = 300 + (int)((seed >> 16) % 2700);
+    }
+    for (int i = 0; i < 300; i++) 
+    {
+        seed = seed * 1103515245u + 12345u;
+        required[i] = sizes[(seed >> 16) % 12];
+    }
+
+    int assignments[300];
+    CutlistResult result;
+    result.assignments = assignments;
+    CutlistSolveOptions options = {0, 10000, 0};
+    CutlistInput input = {required, 300, 6000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_EXACT, &options};
+
+    optimizeCutlist(input, &result);
+
+    TEST_ASSERT_TRUE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(result.stockLowerBound, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_COMPLETED, result.stopReason);
+    TEST_ASSERT_TRUE(result.stats.nodesExpanded < options.nodeLimit);
+    assertValidPacking(required, 300, 6000, &result);
+}
+
+void testDecompositionImprovesLargeOrder(void)
+{
+    // 10000 pieces of 1601 lengths, two to five to a stock: too many lengths for the pattern engine, and too many
+    // pieces for one search to get past the greedy packing
+    int piece_count = 10000;
+    int *required = (int *)malloc(piece_count * sizeof(int));
+    unsigned int seed = 11;
+    for (int i = 0; i < piece_count; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        required[i] = 1000 + (int)((seed >> 16) % 1601);
+    }
+
+    CutlistResult greedy_result;
+    greedy_result.assignments = (int *)malloc(piece_count * sizeof(int));
+    CutlistInput input = {required, piece_count, 6000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_BEST_FIT_DECREASING};
+    optimizeCutlist(input, &greedy_result);
+
+    CutlistResult result;
+    result.assignments = (int *)malloc(piece_count * sizeof(int));
+    CutlistSolveOptions options = {0, 20000, 0};
+    input.strategy = CUTLIST_STRATEGY_DECOMPOSE;
+    input.options = &options;
+    optimizeCutlist(input, &result);
+
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    TEST_ASSERT_TRUE(result.stockUsed < greedy_result.stockUsed);
+    TEST_ASSERT_TRUE(result.stockLowerBound <= result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(greedy_result.stockLowerBound, result.stockLowerBound);
+    TEST_ASSERT_FALSE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_NODE_LIMIT, result.stopReason);
+    assertValidPacking(required, piece_count, 6000, &result);
+
+    // The default strategy decomposes an order this large on its own
+    int decomposed_stock_used = result.stockUsed;
+    input.strategy = CUTLIST_STRATEGY_EXACT;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(decomposed_stock_used, result.stockUsed);
+    assertValidPacking(required, piece_count, 6000, &result);
+
+    free(result.assignments);
+    free(greedy_result.assignments);
+    free(required);
+}
+
+// Checks that every piece is on a stock of a kind long enough for everything cut from it, and no kind runs out
+static void assertValidCataloguePacking(const int *pieces, int pieceCount, const CutlistStockType *stockTypes, int stockTypeCount,
+                                        const CutlistResult *result)
+{
+    long long cost = 0;
+    for (int stock = 0; stock < result->stockUsed; stock++) 
+    {
+        int kind = result->stockTypeOfStock[stock];
+        TEST_ASSERT_TRUE((kind >= 0) && (kind < stockTypeCount));
+        cost += stockTypes[kind].cost;
+
+        int used = 0;
+        for (int i = 0; i < pieceCount; i++) 
+        {
+            TEST_ASSERT_TRUE((result->assignments[i] >= 0) && (result->assignments[i] < result->stockUsed));
+            used += (result->assignments[i] == stock) ? pieces[i] : 0;
+        }
+        TEST_ASSERT_TRUE(used <= stockTypes[kind].length);
+    }
+    TEST_ASSERT_EQUAL_INT(cost, result->cost);
+
+    for (int kind = 0; kind < stockTypeCount; kind++) 
+    {
+        int taken = 0;
+        for (int stock = 0; stock < result->stockUsed; stock++) 
+        {
+            taken += (result->stockTypeOfStock[stock] == kind);
+        }
+        TEST_ASSERT_TRUE((stockTypes[kind].count == CUTLIST_STOCK_UNLIMITED) || (taken <= stockTypes[kind].count));
+    }
+}
+
+void testStockCatalogueMinimizesCost(void) 
+{
+    int required[] = {2400, 3600, 1200, 2400};
+    int assignments[4];
+    int stock_types[4];
+    CutlistResult result;
+    result.assignments = assignments;
+    result.stockTypeOfStock = stock_types;
+
+    // Long bars are cheaper per metre. Two 6 m bars cost 1200, a 6 m and a 3.6 m bar cut without waste cost 1020
+    CutlistStockType yard[] = {{2400, CUTLIST_STOCK_UNLIMITED, 300}, {3600, 5, 420}, {6000, 1, 600}};
+    CutlistInput input = {required, 4, 0, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_EXACT, NULL, yard, 3};
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    TEST_ASSERT_EQUAL_INT(1020, result.cost);
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(0, result.waste);
+    TEST_ASSERT_EQUAL_INT(1, result.provenOptimal);
+    assertValidCataloguePacking(required, 4, yard, 3, &result);
+
+    // Without 6 m bars and with one 3.6 m bar, the 3.6 m piece takes it and the rest go on 2.4 m bars
+    CutlistStockType short_yard[] = {{2400, CUTLIST_STOCK_UNLIMITED, 300}, {3600, 1, 420}, {6000, 0, 600}};
+    input.stockTypes = short_yard;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    TEST_ASSERT_EQUAL_INT(1320, result.cost);
+    assertValidCataloguePacking(required, 4, short_yard, 3, &result);
+
+    // Of two kinds with the same length the cheaper one is used
+    CutlistStockType priced_yard[] = {{6000, CUTLIST_STOCK_UNLIMITED, 700}, {6000, 1, 500}, {3600, 1, 420}};
+    input.stockTypes = priced_yard;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(920, result.cost);
+    assertValidCataloguePacking(required, 4, priced_yard, 3, &result);
+
+    // The greedy strategies pack against the catalogue too
+    input.stockTypes = yard;
+    input.strategy = CUTLIST_STRATEGY_FIRST_FIT_DECREASING;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    assertValidCataloguePacking(required, 4, yard, 3, &result);
+
+    // Too little stock on hand, and a catalogue without a buffer for the stock kinds
+    CutlistStockType empty_yard[] = {{3600, 2, 420}, {6000, 0, 600}};
+    input.stockTypes = empty_yard;
+    input.stockTypeCount = 2;
+    input.strategy = CUTLIST_STRATEGY_EXACT;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_INSUFFICIENT_STOCK, result.status);
+    TEST_ASSERT_EQUAL_INT(-1, result.stockUsed);
+
+    result.stockTypeOfStock = NULL;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_INVALID_INPUT, result.status);
+}
+
+void testKerfAndTrim(void) 
+{
+    int assignments[40];
+    CutlistResult result;
+    result.assignments = assignments;
+
+    // Two cuts' worth of kerf between three pieces, none after the last: an exact fit
+    int exact[] = {32, 32, 32};
+    CutlistInput input = {exact, 3, 100};
+    input.kerfWidth = 2;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(1, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(0, result.waste);
+
+    // 60 + 2 + 39 is one more than the stock, so the 60 goes alone and leaves 40, the 39s leave 100 - 80 = 20
+    int tight[] = {60, 39, 39};
+    input.requiredPieces = tight;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(60, result.waste);
+    TEST_ASSERT_TRUE(result.assignments[1] == result.assignments[2]);
+
+    // Trim comes off every stock before cutting
+    int trimmed[] = {45, 45, 46};
+    input.requiredPieces = trimmed;
+    input.kerfWidth = 0;
+    input.trimLength = 10;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(200, result.cost);
+
+    int too_long[] = {95};
+    input.requiredPieces = too_long;
+    input.pieceCount = 1;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_PIECE_TOO_LONG, result.status);
+
+    // Every engine gives the same stock count as packing the pieces and stocks the kerf and trim make them
+    int required[40];
+    int packed[40];
+    generateHardOrder(11, required, 40);
+    for (int i = 0; i < 40; i++) 
+    {
+        packed[i] = required[i] + 3;
+    }
+    CutlistInput kerf_input = {required, 40, 1000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_EXACT};
+    kerf_input.kerfWidth = 3;
+    kerf_input.trimLength = 20;
+    CutlistInput packed_input = {packed, 40, 983};
+    CutlistResult packed_result;
+    int packed_assignments[40];
+    packed_result.assignments = packed_assignments;
+    optimizeCutlist(packed_input, &packed_result);
+
+    CutlistStrategy strategies[] = {CUTLIST_STRATEGY_BRANCH_AND_BOUND, CUTLIST_STRATEGY_PATTERNS, CUTLIST_STRATEGY_EXACT};
+    for (int i = 0; i < 3; i++) 
+    {
+        kerf_input.strategy = strategies[i];
+        optimizeCutlist(kerf_input, &result);
+        TEST_ASSERT_EQUAL_INT(packed_result.stockUsed, result.stockUsed);
+        TEST_ASSERT_EQUAL_INT(packed_result.waste, result.waste);
+        TEST_ASSERT_EQUAL_INT(result.stockUsed * 1000, result.cost);
+        assertValidPacking(packed, 40, 983, &result);
+    }
+}
+
+void testStockLengthNearIntMax(void)
+{
+    // Scratch and hash keys grow with the pieces, not the stock length, so a few pieces on a huge stock are cheap. Lengths
+    // are ints, so the order's total length stays below INT_MAX
+    int required[] = {1500000000, 600000000, 40000000, 100};
+    int assignments[4];
+    CutlistResult result;
+    result.assignments = assignments;
+    for (int strategy = CUTLIST_STRATEGY_EXACT; strategy <= CUTLIST_STRATEGY_BRANCH_AND_BOUND; strategy++)
+    {
+        CutlistInput input = {required, 4, INT_MAX - 1, CUTLIST_TRACE_OFF, 1, (CutlistStrategy)strategy};
+        optimizeCutlist(input, &result);
+        TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+        TEST_ASSERT_EQUAL_INT(1, result.stockUsed);
+        TEST_ASSERT_TRUE(result.provenOptimal);
+        TEST_ASSERT_TRUE(result.stats.memoryBytes < 4 * 1024 * 1024);
+        assertValidPacking(required, 4, INT_MAX - 1, &result);
+    }
+}
+
+void testSearchStats(void)
+{
+    int required[24];
+    int assignments[24];
+    generateHardOrder(32, required, 24);
+    CutlistResult result;
+    result.assignments = assignments;
+
+    // Serial and parallel searches count nodes and prunes, and their improvements end with the packing returned
+    CutlistInput input = {required, 24, 1000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_BRANCH_AND_BOUND};
+    for (int threads = 1; threads <= 4; threads += 3)
+    {
+        input.threadCount = threads;
+        optimizeCutlist(input, &result);
+        const CutlistStats *stats = &result.stats;
+        TEST_ASSERT_TRUE(result.provenOptimal);
+        TEST_ASSERT_TRUE(stats->nodesExpanded > 0);
+        TEST_ASSERT_TRUE(stats->prunes[CUTLIST_PRUNE_LOWER_BOUND] > 0);
+        TEST_ASSERT_TRUE((stats->maxDepth > 0) && (stats->maxDepth <= 24));
+        TEST_ASSERT_TRUE(stats->improvementCount >= 1);
+
+        const CutlistImprovement *last = &stats->improvements[(stats->improvementCount < CUTLIST_STATS_MAX_IMPROVEMENTS) ?
+                                                              (stats->improvementCount - 1) : (CUTLIST_STATS_MAX_IMPROVEMENTS - 1)];
+        TEST_ASSERT_EQUAL_INT(result.stockUsed, last->stockUsed);
+        TEST_ASSERT_EQUAL_INT(result.waste, last->waste);
+        TEST_ASSERT_EQUAL_INT(result.cost, last->cost);
+        TEST_ASSERT_TRUE((stats->secondsToFirstSolution >= 0) && (stats->secondsToFirstSolution <= stats->secondsToOptimum));
+        TEST_ASSERT_TRUE(stats->secondsToOptimum <= stats->totalSeconds);
+        TEST_ASSERT_TRUE(stats->transpositionHits + stats->transpositionMisses > 0);
+        TEST_ASSERT_TRUE(stats->memoryBytes > 0);
+    }
+
+    // A budget-limited search is not proven optimal, and a failed solve did no work
+    CutlistSolveOptions options = {0, 300, 0};
+    input.threadCount = 1;
+    input.options = &options;
+    optimizeCutlist(input, &result);
+    TEST_ASSERT_FALSE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(-1, (int)result.stats.secondsToOptimum);
+
+    int too_long[] = {1500};
+    CutlistInput failing = {too_long, 1, 1000};
+    optimizeCutlist(failing, &result);
+    TEST_ASSERT_EQUAL_INT(0, (int)result.stats.nodesExpanded);
+    TEST_ASSERT_EQUAL_INT(0, result.stats.improvementCount);
+    TEST_ASSERT_EQUAL_INT(-1, (int)result.stats.secondsToFirstSolution);
+}
+
 void testGetStockAssignmentsAsString(void) 
 {
     PackingState state;
@@ -261,6 +1063,7 @@ void testGetStockAssignmentsAsString(void)
 
     state.pieceSizes = piece_sizes;
     state.currentAssignments = assignments;
+    state.kerfWidth = 0;
 
     // Get stock assignments as a string
     char *output = getStockAssignmentsAsString(&state);
@@ -275,6 +1078,801 @@ void testGetStockAssignmentsAsString(void)
     TEST_ASSERT_EQUAL_STRING(expected_output, output);
 
     free(output);  // Clean up allocated memory
+
+    // Sizes in the search carry the kerf, the string lists the lengths asked for
+    int kerf_sizes[] = {103, 83, 78, 53, 28};
+    state.pieceSizes = kerf_sizes;
+    state.kerfWidth = 3;
+    output = getStockAssignmentsAsString(&state);
+    TEST_ASSERT_EQUAL_STRING(expected_output, output);
+    free(output);
+}
+
+void testGetStockAssignmentsAsStringManyPieces(void) 
+{
+    // Far more output than the old fixed 1024-byte buffer could hold
+    enum { PIECE_COUNT = 400 };
+    PackingState state;
+    int piece_sizes[PIECE_COUNT];
+    int assignments[PIECE_COUNT];
+    for (int i = 0; i < PIECE_COUNT; i++) 
+    {
+        piece_sizes[i] = 1000 + i;
+        assignments[i] = i / 4;
+    }
+
+    state.totalPieces = PIECE_COUNT;
+    state.currentStockCount = PIECE_COUNT / 4;
+    state.kerfWidth = 0;
+    state.pieceSizes = piece_sizes;
+    state.currentAssignments = assignments;
+
+    char *output = getStockAssignmentsAsString(&state);
+    TEST_ASSERT_NOT_NULL(output);
+
+    // Header, then 100 lines of "Stock #n: " followed by four 4-digit sizes with 3 separators, then a blank line
+    size_t expected_length = strlen("Stock assignments:\n") + 1;
+    for (int stock = 1; stock <= PIECE_COUNT / 4; stock++) 
+    {
+        expected_length += (size_t)snprintf(NULL, 0, "Stock #%d: ", stock) + 4 * 4 + 3 * 2 + 1;
+    }
+    TEST_ASSERT_EQUAL_INT(expected_length, strlen(output));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(output + strlen("Stock assignments:\n"), "Stock #1: 1000, 1001, 1002, 1003\n", 33));
+
+    free(output);
+}
+
+void testFormatResultAsCsvAndJson(void) 
+{
+    int required[] = {50, 75, 100, 25, 80};
+    int assignments[] = {1, 0, 0, -1, 1};  // Piece 3 left unplaced
+    CutlistInput input = {required, 5, 200};
+    CutlistResult result = {0};
+    result.assignments = assignments;
+    result.stockUsed = 2;
+
+    CutlistSink sink;
+    initCutlistGrowableSink(&sink);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistResult(&sink, CUTLIST_FORMAT_CSV, &input, &result));
+    TEST_ASSERT_EQUAL_STRING("stock,piece,length\n0,1,75\n0,2,100\n1,0,50\n1,4,80\n", sink.buffer);
+    freeCutlistSink(&sink);
+
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistResult(&sink, CUTLIST_FORMAT_JSON, &input, &result));
+    TEST_ASSERT_EQUAL_STRING("{\"stockCount\":2,\"stocks\":["
+                             "{\"stock\":0,\"pieces\":[{\"piece\":1,\"length\":75},{\"piece\":2,\"length\":100}]},"
+                             "{\"stock\":1,\"pieces\":[{\"piece\":0,\"length\":50},{\"piece\":4,\"length\":80}]}]}\n", sink.buffer);
+    freeCutlistSink(&sink);
+
+    // A fixed buffer keeps what fits, NUL-terminated, and reports the size the whole sheet needs
+    char buffer[32];
+    initCutlistBufferSink(&sink, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_TRUNCATED, writeCutlistResult(&sink, CUTLIST_FORMAT_TEXT, &input, &result));
+    TEST_ASSERT_EQUAL_STRING("Stock assignments:\nStock #1: 75", buffer);
+    TEST_ASSERT_EQUAL_INT(strlen("Stock assignments:\nStock #1: 75, 100\nStock #2: 50, 80\n\n"), sink.length);
+
+    // Without a buffer the sink only sizes the sheet
+    initCutlistBufferSink(&sink, NULL, 0);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_TRUNCATED, writeCutlistResult(&sink, CUTLIST_FORMAT_TEXT, &input, &result));
+    TEST_ASSERT_EQUAL_INT(strlen("Stock assignments:\nStock #1: 75, 100\nStock #2: 50, 80\n\n"), sink.length);
+}
+
+void testFormatLargeSheetStreamsToFile(void) 
+{
+    // Far more than one staging chunk, so the file sees several writes
+    enum { PIECE_COUNT = 10000 };
+    int *pieces = (int *)malloc(PIECE_COUNT * sizeof(int));
+    int *assignments = (int *)malloc(PIECE_COUNT * sizeof(int));
+    TEST_ASSERT_NOT_NULL(pieces);
+    TEST_ASSERT_NOT_NULL(assignments);
+    for (int i = 0; i < PIECE_COUNT; i++) 
+    {
+        pieces[i] = 100 + i % 900;
+        assignments[i] = (i * 7) % 2500;
+    }
+
+    FILE *file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+    CutlistSink file_sink;
+    initCutlistFileSink(&file_sink, file);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistAssignments(&file_sink, CUTLIST_FORMAT_CSV, pieces, assignments, PIECE_COUNT, 2500));
+
+    CutlistSink memory_sink;
+    initCutlistGrowableSink(&memory_sink);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistAssignments(&memory_sink, CUTLIST_FORMAT_CSV, pieces, assignments, PIECE_COUNT, 2500));
+    TEST_ASSERT_EQUAL_INT(memory_sink.length, file_sink.length);
+
+    // Header plus one row per piece, and the file holds exactly what the buffer does
+    int rows = 0;
+    for (size_t i = 0; i < memory_sink.length; i++) 
+    {
+        rows += (memory_sink.buffer[i] == '\n');
+    }
+    TEST_ASSERT_EQUAL_INT(PIECE_COUNT + 1, rows);
+
+    char *read_back = (char *)malloc(file_sink.length);
+    TEST_ASSERT_NOT_NULL(read_back);
+    rewind(file);
+    TEST_ASSERT_EQUAL_INT(file_sink.length, fread(read_back, 1, file_sink.length, file));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(read_back, memory_sink.buffer, file_sink.length));
+
+    free(read_back);
+    fclose(file);
+    freeCutlistSink(&memory_sink);
+    free(assignments);
+    free(pieces);
+}
+
+typedef struct {
+    const int *pieces;
+    int pieceCount;
+    CutlistStrategy strategy;
+    int *assignments;
+    CutlistResult result;
+} SolveJob;
+
+static void *runSolveJob(void *argument)
+{
+    SolveJob *job = (SolveJob *)argument;
+    CutlistSolveOptions options = {0, 20000, 0};
+    CutlistInput input = {job->pieces, job->pieceCount, 1000, CUTLIST_TRACE_OFF, 1, job->strategy, &options};
+    job->result.assignments = job->assignments;
+    optimizeCutlist(input, &job->result);
+    return NULL;
+}
+
+static void runSolveJobOnSmallStack(SolveJob *job)
+{
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 64 * 1024);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, &attributes, runSolveJob, job));
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attributes);
+}
+
+void testDeepSearchOnSmallStack(void)
+{
+    // The first packing the search finds places every piece, one search level each, on a thread with a 64 KB stack
+    static int required[3000];
+    static int assignments[3000];
+    generateHardOrder(17, required, 3000);
+    SolveJob job = {required, 3000, CUTLIST_STRATEGY_BRANCH_AND_BOUND, assignments};
+    runSolveJobOnSmallStack(&job);
+
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, job.result.status);
+    TEST_ASSERT_EQUAL_INT(3000, job.result.stats.maxDepth);
+    assertValidPacking(required, 3000, 1000, &job.result);
+
+    // With 64 sizes the default strategy takes the pattern engine, whose search from the rounded LP solution cuts
+    // dozens of stocks of 64 classes each
+    generateHardOrder(18, required, 3000);
+    for (int i = 0; i < 3000; i++)
+    {
+        required[i] = 20 + 7 * (required[i] % 64);
+    }
+    SolveJob pattern_job = {required, 3000, CUTLIST_STRATEGY_EXACT, assignments};
+    runSolveJobOnSmallStack(&pattern_job);
+
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, pattern_job.result.status);
+    TEST_ASSERT_TRUE(pattern_job.result.provenOptimal);
+    TEST_ASSERT_TRUE(pattern_job.result.stats.maxDepth > 0);
+    assertValidPacking(required, 3000, 1000, &pattern_job.result);
+}
+
+void testReoptimizeChangedOrder(void) 
+{
+    CutlistSolver *solver = createCutlistSolver(8);
+    TEST_ASSERT_NOT_NULL(solver);
+
+    // Four full stocks: [120, 80], [150, 50], [100, 100], [60, 140]
+    int required[] = {120, 80, 150, 50, 100, 100, 60, 140};
+    int assignments[8];
+    CutlistResult result;
+    result.assignments = assignments;
+    TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, (CutlistInput){required, 8, 200}, &result));
+    TEST_ASSERT_EQUAL_INT(4, result.stockUsed);
+
+    // Swap the 50 for a 30: it takes the 50's place and nothing else moves, so no search is needed
+    int swapped[] = {120, 80, 150, 100, 100, 60, 140, 30};
+    int removed_50[] = {3};
+    CutlistOrderChange swap = {removed_50, 1, 1};
+    int swapped_assignments[8];
+    CutlistResult swapped_result;
+    swapped_result.assignments = swapped_assignments;
+    TEST_ASSERT_EQUAL_INT(0, reoptimizeCutlist(solver, (CutlistInput){swapped, 8, 200}, &result, &swap, &swapped_result));
+    TEST_ASSERT_EQUAL_INT(4, swapped_result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(20, swapped_result.waste);
+    TEST_ASSERT_TRUE(swapped_result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(0, (int)swapped_result.stats.nodesExpanded);
+    TEST_ASSERT_EQUAL_INT(assignments[2], swapped_assignments[7]);
+    assertValidPacking(swapped, 8, 200, &swapped_result);
+
+    // Removing both pieces of a stock drops it, repairing the assignments in place
+    int shrunk[] = {150, 100, 100, 60, 140, 30};
+    int removed_first[] = {1, 0};
+    CutlistOrderChange shrink = {removed_first, 2, 0};
+    TEST_ASSERT_EQUAL_INT(0, reoptimizeCutlist(solver, (CutlistInput){shrunk, 6, 200}, &swapped_result, &shrink, &swapped_result));
+    TEST_ASSERT_EQUAL_INT(3, swapped_result.stockUsed);
+    TEST_ASSERT_TRUE(swapped_result.provenOptimal);
+    assertValidPacking(shrunk, 6, 200, &swapped_result);
+
+    // A removed piece named twice is not a change of this order
+    int removed_twice[] = {2, 2};
+    CutlistOrderChange bad_change = {removed_twice, 2, 0};
+    CutlistResult bad_result;
+    int bad_assignments[6];
+    bad_result.assignments = bad_assignments;
+    TEST_ASSERT_EQUAL_INT(-1, reoptimizeCutlist(solver, (CutlistInput){shrunk, 4, 200}, &swapped_result, &bad_change, &bad_result));
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_INVALID_INPUT, bad_result.status);
+
+    // A stock left with only a zero-length piece still holds a piece, and is kept
+    int with_empty[] = {100, 0};
+    int only_empty[] = {0};
+    int empty_assignments[2];
+    CutlistResult empty_result = {empty_assignments};
+    TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, (CutlistInput){with_empty, 2, 100}, &empty_result));
+    int removed_full[] = {0};
+    CutlistOrderChange drop_full = {removed_full, 1, 0};
+    TEST_ASSERT_EQUAL_INT(0, reoptimizeCutlist(solver, (CutlistInput){only_empty, 1, 100}, &empty_result, &drop_full, &empty_result));
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, empty_result.status);
+    TEST_ASSERT_EQUAL_INT(1, empty_result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(0, empty_result.assignments[0]);
+
+    // Larger changes, where the repaired packing may need the search to improve on it, end where a solve from scratch does
+    unsigned int seed = 7;
+    for (int round = 0; round < 20; round++) 
+    {
+        int pieces[40];
+        int changed[40];
+        int removed[4];
+        int before[40];
+        int after[40];
+        int scratch_assignments[40];
+        for (int i = 0; i < 40; i++) 
+        {
+            seed = seed * 1103515245u + 12345u;
+            pieces[i] = 50 + (int)((seed >> 16) % 400);
+        }
+        CutlistResult previous = {before};
+        TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, (CutlistInput){pieces, 36, 1000}, &previous));
+
+        // Remove every ninth piece and add the last four
+        int changed_count = 0;
+        for (int i = 0; i < 36; i++) 
+        {
+            if (i % 9 == 4) 
+            {
+                removed[i / 9] = i;
+            }
+            else 
+            {
+                changed[changed_count++] = pieces[i];
+            }
+        }
+        for (int i = 36; i < 40; i++) 
+        {
+            changed[changed_count++] = pieces[i];
+        }
+        CutlistOrderChange change = {removed, 4, 4};
+        CutlistInput changed_input = {changed, changed_count, 1000};
+        CutlistResult repaired = {after};
+        CutlistResult scratch = {scratch_assignments};
+        TEST_ASSERT_EQUAL_INT(0, reoptimizeCutlist(solver, changed_input, &previous, &change, &repaired));
+        TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, changed_input, &scratch));
+        TEST_ASSERT_TRUE(repaired.provenOptimal);
+        TEST_ASSERT_EQUAL_INT(scratch.stockUsed, repaired.stockUsed);
+        assertValidPacking(changed, changed_count, 1000, &repaired);
+    }
+
+    destroyCutlistSolver(solver);
+}
+
+void testResultCacheAcrossRestarts(void) 
+{
+    const char *path = "test_cutlist_cache.bin";
+    remove(path);
+    CutlistSolver *solver = createCutlistSolver(8);
+    CutlistCache *cache = openCutlistCache(path, 0);
+    TEST_ASSERT_NOT_NULL(solver);
+    TEST_ASSERT_NOT_NULL(cache);
+
+    int required[] = {60, 35, 45, 65, 70, 120};
+    int reordered[] = {120, 45, 60, 70, 35, 65};
+    int assignments[6];
+    CutlistResult result;
+    result.assignments = assignments;
+    TEST_ASSERT_EQUAL_INT(0, solveCutlistCached(cache, solver, (CutlistInput){required, 6, 200}, &result));
+    TEST_ASSERT_TRUE(result.stats.nodesExpanded > 0);
+
+    // The same multiset in another order is a hit, with the packing mapped onto the caller's pieces
+    TEST_ASSERT_EQUAL_INT(0, solveCutlistCached(cache, solver, (CutlistInput){reordered, 6, 200}, &result));
+    TEST_ASSERT_EQUAL_INT(0, (int)result.stats.nodesExpanded);
+    TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(5, result.waste);
+    TEST_ASSERT_TRUE(result.provenOptimal);
+    assertValidPacking(reordered, 6, 200, &result);
+
+    // Another stock length is another order
+    TEST_ASSERT_EQUAL_INT(0, solveCutlistCached(cache, solver, (CutlistInput){required, 6, 400}, &result));
+    CutlistCacheStats stats;
+    getCutlistCacheStats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(1, (int)stats.hits);
+    TEST_ASSERT_EQUAL_INT(2, (int)stats.misses);
+    TEST_ASSERT_EQUAL_INT(2, (int)stats.stores);
+    TEST_ASSERT_EQUAL_INT(2, (int)stats.entryCount);
+    TEST_ASSERT_EQUAL_INT(0, closeCutlistCache(cache));
+
+    // After a restart both results come from the store, and a cache too small for both keeps the newer one
+    cache = openCutlistCache(path, stats.bytes - 1);
+    TEST_ASSERT_NOT_NULL(cache);
+    getCutlistCacheStats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(2, (int)stats.loadedEntries);
+    TEST_ASSERT_EQUAL_INT(1, (int)stats.evictions);
+    TEST_ASSERT_EQUAL_INT(0, solveCutlistCached(cache, solver, (CutlistInput){reordered, 6, 400}, &result));
+    TEST_ASSERT_EQUAL_INT(0, (int)result.stats.nodesExpanded);
+    assertValidPacking(reordered, 6, 400, &result);
+    TEST_ASSERT_EQUAL_INT(0, closeCutlistCache(cache));
+
+    // Closing rewrote the store without the evicted result
+    cache = openCutlistCache(path, 0);
+    getCutlistCacheStats(cache, &stats);
+    TEST_ASSERT_EQUAL_INT(1, (int)stats.loadedEntries);
+    TEST_ASSERT_EQUAL_INT(0, closeCutlistCache(cache));
+
+    destroyCutlistSolver(solver);
+    remove(path);
+}
+
+void testSolverReusedAcrossSolves(void) 
+{
+    CutlistSolver *solver = createCutlistSolver(8);
+    TEST_ASSERT_NOT_NULL(solver);
+
+    // Growing to the largest input happens once, later solves reuse the same arena
+    int large[40];
+    for (int i = 0; i < 40; i++) 
+    {
+        large[i] = (i % 10) * 25 + 10;
+    }
+    CutlistInput large_input = {large, 40, 1000};
+    CutlistResult large_result;
+    int large_assignments[40];
+    large_result.assignments = large_assignments;
+    TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, large_input, &large_result));
+    TEST_ASSERT_EQUAL_INT(5, large_result.stockUsed);
+
+    unsigned char *arena = solver->arena;
+    size_t arena_capacity = solver->arenaCapacity;
+
+    for (int round = 0; round < 1000; round++) 
+    {
+        int required[] = {60, 35, 45, 65, 70, 120};
+        CutlistInput input = {required, 6, 200};
+        CutlistResult result;
+        int assignments[6];
+        result.assignments = assignments;
+
+        TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, input, &result));
+        TEST_ASSERT_EQUAL_INT(2, result.stockUsed);
+        TEST_ASSERT_EQUAL_INT(5, result.waste);
+    }
+
+    TEST_ASSERT_TRUE(arena == solver->arena);
+    TEST_ASSERT_EQUAL_INT(arena_capacity, solver->arenaCapacity);
+
+    // A failed solve reports the failure flags and leaves the solver usable
+    int too_long[] = {250};
+    CutlistInput bad_input = {too_long, 1, 200};
+    CutlistResult bad_result;
+    int bad_assignments[1];
+    bad_result.assignments = bad_assignments;
+    TEST_ASSERT_EQUAL_INT(-1, solveCutlist(solver, bad_input, &bad_result));
+    TEST_ASSERT_EQUAL_INT(-1, bad_result.stockUsed);
+
+    resetCutlistSolver(solver);
+    TEST_ASSERT_EQUAL_INT(0, solveCutlist(solver, large_input, &large_result));
+    TEST_ASSERT_EQUAL_INT(5, large_result.stockUsed);
+
+    destroyCutlistSolver(solver);
+}
+
+void testBatchMatchesSingleSolves(void) 
+{
+    enum { ORDER_COUNT = 48, MAX_PIECES = 16 };
+    int pieces[ORDER_COUNT][MAX_PIECES];
+    CutlistInput inputs[ORDER_COUNT];
+    CutlistResult expected[ORDER_COUNT];
+    CutlistResult results[ORDER_COUNT];
+    int expected_assignments[ORDER_COUNT][MAX_PIECES];
+    int assignments[ORDER_COUNT][MAX_PIECES];
+
+    // Every third order repeats an earlier one, one has a piece longer than the stock and one has no stock length
+    unsigned int seed = 7;
+    for (int order = 0; order < ORDER_COUNT; order++) 
+    {
+        CutlistInput input = {pieces[order], 4 + order % (MAX_PIECES - 3), 500};
+        inputs[order] = input;
+        for (int i = 0; i < MAX_PIECES; i++) 
+        {
+            seed = seed * 1103515245u + 12345u;
+            pieces[order][i] = 40 + (int)((seed >> 16) % 300);
+        }
+        if ((order > 0) && (order % 3 == 0)) 
+        {
+            inputs[order] = inputs[order / 2];
+            inputs[order].requiredPieces = pieces[order];
+            memcpy(pieces[order], pieces[order / 2], sizeof(pieces[order]));
+        }
+    }
+    pieces[10][2] = 900;
+    inputs[20].stockLength = 0;
+
+    for (int order = 0; order < ORDER_COUNT; order++) 
+    {
+        expected[order].assignments = expected_assignments[order];
+        optimizeCutlist(inputs[order], &expected[order]);
+    }
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_PIECE_TOO_LONG, expected[10].status);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_INVALID_INPUT, expected[20].status);
+
+    for (int thread_count = 1; thread_count <= 3; thread_count += 2) 
+    {
+        for (int reuse = 0; reuse <= 1; reuse++) 
+        {
+            CutlistBatchOptions options = {thread_count, reuse};
+            for (int order = 0; order < ORDER_COUNT; order++) 
+            {
+                results[order].assignments = assignments[order];
+            }
+
+            TEST_ASSERT_EQUAL_INT(2, optimizeCutlistBatch(inputs, results, ORDER_COUNT, &options));
+            for (int order = 0; order < ORDER_COUNT; order++) 
+            {
+                TEST_ASSERT_EQUAL_INT(expected[order].status, results[order].status);
+                TEST_ASSERT_EQUAL_INT(expected[order].stockUsed, results[order].stockUsed);
+                TEST_ASSERT_EQUAL_INT(expected[order].waste, results[order].waste);
+                TEST_ASSERT_TRUE(results[order].assignments == assignments[order]);
+                if (expected[order].status == CUTLIST_STATUS_OK) 
+                {
+                    TEST_ASSERT_EQUAL_INT_ARRAY(expected_assignments[order], assignments[order], inputs[order].pieceCount);
+                }
+            }
+        }
+    }
+}
+
+void testOrderFilesRoundTrip(void)
+{
+    int repeated[5000];
+    for (int i = 0; i < 5000; i++)
+    {
+        repeated[i] = 450;
+    }
+    int distinct[] = {100, 200, 300, 400};
+    int paired[] = {50, 50, 70, 70, 70, 90};
+    CutlistInput orders[] = {
+        {repeated, 5000, 6000, .kerfWidth = 3, .trimLength = 10},
+        {distinct, 4, 1000, .kerfWidth = 3, .trimLength = 10},
+        {paired, 6, 500, .kerfWidth = 3, .trimLength = 10},
+        {paired, 0, 800, .kerfWidth = 3, .trimLength = 10},
+    };
+    CutlistInput defaults = {NULL, 0, 0, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_FIRST_FIT_DECREASING, .kerfWidth = 3, .trimLength = 10};
+
+    for (int format = CUTLIST_ORDER_CSV; format <= CUTLIST_ORDER_BINARY; format++)
+    {
+        CutlistSink sink;
+        initCutlistGrowableSink(&sink);
+        writeCutlistOrderHeader(&sink, (CutlistOrderFormat)format);
+        for (int order = 0; order < 4; order++)
+        {
+            TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistOrder(&sink, (CutlistOrderFormat)format, 7 + order, &orders[order]));
+        }
+
+        // 5000 pieces of one length take one row or record, not 5000
+        TEST_ASSERT_TRUE(sink.length < 256);
+
+        // Two orders fit a chunk, so the last two come in a second one. The empty order survives in both formats
+        CutlistOrderReader *reader = openCutlistOrderReaderFromMemory(sink.buffer, sink.length, (CutlistOrderFormat)format, &defaults);
+        CutlistOrder read[2];
+        int read_count = 0;
+        size_t count;
+        while ((count = readCutlistOrders(reader, read, 2)) > 0)
+        {
+            for (size_t index = 0; index < count; index++, read_count++)
+            {
+                const CutlistInput *expected = &orders[read_count];
+                TEST_ASSERT_EQUAL_INT(7 + read_count, (int)read[index].orderId);
+                TEST_ASSERT_EQUAL_INT(expected->pieceCount, read[index].input.pieceCount);
+                TEST_ASSERT_EQUAL_INT(expected->stockLength, read[index].input.stockLength);
+                TEST_ASSERT_EQUAL_INT(3, read[index].input.kerfWidth);
+                TEST_ASSERT_EQUAL_INT(10, read[index].input.trimLength);
+                TEST_ASSERT_EQUAL_INT(CUTLIST_STRATEGY_FIRST_FIT_DECREASING, read[index].input.strategy);
+                if (expected->pieceCount > 0)
+                {
+                    TEST_ASSERT_EQUAL_INT_ARRAY(expected->requiredPieces, read[index].input.requiredPieces, expected->pieceCount);
+                }
+            }
+
+            // A binary order of distinct lengths is read in place
+            if ((format == CUTLIST_ORDER_BINARY) && (read_count == 2))
+            {
+                const char *pieces = (const char *)read[1].input.requiredPieces;
+                TEST_ASSERT_TRUE((pieces > sink.buffer) && (pieces < sink.buffer + sink.length));
+            }
+        }
+        TEST_ASSERT_EQUAL_INT(4, read_count);
+        TEST_ASSERT_EQUAL_INT(CUTLIST_READ_OK, getCutlistOrderReaderStatus(reader, NULL));
+        closeCutlistOrderReader(reader);
+        freeCutlistSink(&sink);
+    }
+
+    // A malformed row stops the reader and says which line it is on
+    const char *csv = "order,stock_length,length,quantity\r\n1,1000,100,2\r\n\n1,1000,abc\n";
+    CutlistOrderReader *reader = openCutlistOrderReaderFromMemory(csv, strlen(csv), CUTLIST_ORDER_CSV, NULL);
+    CutlistOrder read;
+    TEST_ASSERT_EQUAL_INT(0, (int)readCutlistOrders(reader, &read, 1));
+    long long line = 0;
+    TEST_ASSERT_EQUAL_INT(CUTLIST_READ_MALFORMED, getCutlistOrderReaderStatus(reader, &line));
+    TEST_ASSERT_EQUAL_INT(4, (int)line);
+    closeCutlistOrderReader(reader);
+
+    reader = openCutlistOrderReader("missing_cutlist_orders.csv", CUTLIST_ORDER_CSV, NULL);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_READ_OPEN_FAILED, getCutlistOrderReaderStatus(reader, NULL));
+    closeCutlistOrderReader(reader);
+}
+
+typedef struct {
+    int orderCount;
+    int mismatches;
+} OrderStreamCheck;
+
+// Checks every streamed result against a plain solve of the same order
+static void checkStreamedOrder(const CutlistOrder *order, const CutlistResult *result, void *userData)
+{
+    OrderStreamCheck *check = (OrderStreamCheck *)userData;
+    int assignments[16];
+    CutlistResult expected;
+    expected.assignments = assignments;
+    optimizeCutlist(order->input, &expected);
+    if ((order->orderId != 100 + check->orderCount) || (result->stockUsed != expected.stockUsed) ||
+        (memcmp(result->assignments, assignments, (size_t)order->input.pieceCount * sizeof(int)) != 0))
+    {
+        check->mismatches++;
+    }
+    check->orderCount++;
+}
+
+void testOrderStreamSolvesFile(void)
+{
+    const char *path = "test_cutlist_orders.bin";
+    FILE *file = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    CutlistSink sink;
+    initCutlistFileSink(&sink, file);
+    writeCutlistOrderHeader(&sink, CUTLIST_ORDER_BINARY);
+
+    // 50 orders of 4 to 16 pieces from 3 lengths each, so some are stored as runs and some length by length
+    unsigned int seed = 3;
+    for (int order = 0; order < 50; order++)
+    {
+        int pieces[16];
+        int lengths[3];
+        for (int i = 0; i < 3; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            lengths[i] = 100 + (int)((seed >> 16) % 800);
+        }
+        seed = seed * 1103515245u + 12345u;
+        int piece_count = 4 + (int)((seed >> 16) % 13);
+        for (int i = 0; i < piece_count; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            pieces[i] = lengths[(i * 3 / piece_count + (seed >> 16) % 2) % 3];
+        }
+        CutlistInput input = {pieces, piece_count, 1000};
+        writeCutlistOrder(&sink, CUTLIST_ORDER_BINARY, 100 + order, &input);
+    }
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, sink.error);
+    fclose(file);
+
+    CutlistOrderReader *reader = openCutlistOrderReader(path, CUTLIST_ORDER_BINARY, NULL);
+    CutlistBatchOptions options = {2, 1};
+    OrderStreamCheck check = {0, 0};
+    TEST_ASSERT_EQUAL_INT(0, (int)optimizeCutlistOrderStream(reader, 8, &options, checkStreamedOrder, &check));
+    TEST_ASSERT_EQUAL_INT(CUTLIST_READ_OK, getCutlistOrderReaderStatus(reader, NULL));
+    TEST_ASSERT_EQUAL_INT(50, check.orderCount);
+    TEST_ASSERT_EQUAL_INT(0, check.mismatches);
+    closeCutlistOrderReader(reader);
+    remove(path);
+}
+
+// Checks that a demand result is a packing of every piece: the patterns' stocks add up, no stock is overfilled, every
+// demand is cut exactly, and the waste is what the patterns leave
+static void assertDemandPacking(const CutlistDemandInput *input, const CutlistDemandResult *result)
+{
+    int *cut = (int *)calloc((size_t)input->demandCount, sizeof(int));
+    int capacity = input->stockLength - input->trimLength + input->kerfWidth;
+    long long stocks = 0;
+    long long waste = 0;
+    for (int pattern_index = 0; pattern_index < result->patternCount; pattern_index++)
+    {
+        const CutlistPattern *pattern = &result->patterns[pattern_index];
+        long long packed_length = 0;
+        for (int cut_index = pattern->firstCut; cut_index < pattern->firstCut + pattern->cutCount; cut_index++)
+        {
+            const CutlistPatternCut *pattern_cut = &result->cuts[cut_index];
+            packed_length += (long long)pattern_cut->quantity * (input->demands[pattern_cut->demandIndex].length + input->kerfWidth);
+            cut[pattern_cut->demandIndex] += pattern->repeat * pattern_cut->quantity;
+        }
+        TEST_ASSERT_TRUE(pattern->repeat > 0);
+        TEST_ASSERT_TRUE(packed_length <= capacity);
+        TEST_ASSERT_EQUAL_INT(capacity - packed_length, pattern->waste);
+        stocks += pattern->repeat;
+        waste += (long long)pattern->repeat * pattern->waste;
+    }
+    TEST_ASSERT_EQUAL_INT(result->stockUsed, (int)stocks);
+    TEST_ASSERT_TRUE(waste == result->waste);
+    for (int demand_index = 0; demand_index < input->demandCount; demand_index++)
+    {
+        TEST_ASSERT_EQUAL_INT(input->demands[demand_index].quantity, cut[demand_index]);
+    }
+    free(cut);
+}
+
+void testDemandMatchesExpandedPieces(void)
+{
+    // Two demands of one length keep their own pieces, a demand of none is left out
+    CutlistDemand demands[] = {{450, 7}, {300, 5}, {450, 3}, {120, 0}, {170, 4}};
+    CutlistDemandInput input = {demands, 5, 2000, .kerfWidth = 3, .trimLength = 10};
+    CutlistDemandResult result;
+    optimizeCutlistDemand(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    assertDemandPacking(&input, &result);
+
+    int pieces[19];
+    int assignments[19];
+    int expected_assignments[19];
+    TEST_ASSERT_EQUAL_INT(19, expandCutlistDemand(demands, 5, pieces));
+    CutlistInput piece_input = {pieces, 19, 2000, .kerfWidth = 3, .trimLength = 10};
+    CutlistResult expected;
+    expected.assignments = expected_assignments;
+    optimizeCutlist(piece_input, &expected);
+    TEST_ASSERT_EQUAL_INT(expected.stockUsed, result.stockUsed);
+    TEST_ASSERT_EQUAL_INT(expected.waste, (int)result.waste);
+    TEST_ASSERT_EQUAL_INT(expected.provenOptimal, result.provenOptimal);
+
+    // Expanded back, the patterns are a packing of the same pieces
+    TEST_ASSERT_EQUAL_INT(0, expandCutlistPatterns(demands, 5, &result, assignments));
+    int loads[19] = {0};
+    for (int piece_index = 0; piece_index < 19; piece_index++)
+    {
+        TEST_ASSERT_TRUE((assignments[piece_index] >= 0) && (assignments[piece_index] < result.stockUsed));
+        loads[assignments[piece_index]] += pieces[piece_index] + 3;
+    }
+    for (int stock_index = 0; stock_index < result.stockUsed; stock_index++)
+    {
+        TEST_ASSERT_TRUE(loads[stock_index] <= 2000 - 10 + 3);
+    }
+    freeCutlistDemandResult(&result);
+
+    // Equal stocks share one line of the sheet
+    CutlistDemand bars[] = {{400, 5}};
+    CutlistDemandInput bar_input = {bars, 1, 1000};
+    optimizeCutlistDemand(bar_input, &result);
+    char sheet[128];
+    CutlistSink sink;
+    initCutlistBufferSink(&sink, sheet, sizeof(sheet));
+    TEST_ASSERT_EQUAL_INT(CUTLIST_SINK_OK, writeCutlistPatterns(&sink, CUTLIST_FORMAT_TEXT, &bar_input, &result));
+    TEST_ASSERT_EQUAL_STRING("Cutting patterns:\n2 x Stock: 400 x 2\n1 x Stock: 400 x 1\n\n", sheet);
+    initCutlistBufferSink(&sink, sheet, sizeof(sheet));
+    writeCutlistPatterns(&sink, CUTLIST_FORMAT_CSV, &bar_input, &result);
+    TEST_ASSERT_EQUAL_STRING("pattern,stocks,demand,length,quantity\n0,2,0,400,2\n1,1,0,400,1\n", sheet);
+    freeCutlistDemandResult(&result);
+
+    CutlistDemand negative[] = {{400, 5}, {-1, 2}};
+    CutlistDemandInput negative_input = {negative, 2, 1000};
+    optimizeCutlistDemand(negative_input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_NEGATIVE_PIECE, result.status);
+    TEST_ASSERT_NULL(result.patterns);
+}
+
+void testDemandSolvesLargeQuantitiesInPatterns(void)
+{
+    // 2.9 million pieces: the LP over the 4 lengths settles it in a handful of patterns, proven optimal
+    CutlistDemand demands[] = {{450, 2000000}, {1210, 300000}, {730, 500000}, {2950, 120000}};
+    CutlistDemandInput input = {demands, 4, 6000, .kerfWidth = 3, .trimLength = 10};
+    CutlistDemandResult result;
+    optimizeCutlistDemand(input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    TEST_ASSERT_TRUE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(result.stockLowerBound, result.stockUsed);
+    TEST_ASSERT_TRUE(result.patternCount < 20);
+    assertDemandPacking(&input, &result);
+    freeCutlistDemandResult(&result);
+
+    // Pattern by pattern, the greedy is still first-fit decreasing
+    CutlistDemand order[] = {{1700, 3001}, {1210, 2500}, {730, 1999}, {450, 4000}, {333, 1234}, {95, 777}};
+    CutlistDemandInput order_input = {order, 6, 6000, .strategy = CUTLIST_STRATEGY_FIRST_FIT_DECREASING, .kerfWidth = 3};
+    optimizeCutlistDemand(order_input, &result);
+    assertDemandPacking(&order_input, &result);
+
+    int piece_count = 3001 + 2500 + 1999 + 4000 + 1234 + 777;
+    int *pieces = (int *)malloc(2 * (size_t)piece_count * sizeof(int));
+    expandCutlistDemand(order, 6, pieces);
+    CutlistInput piece_input = {pieces, piece_count, 6000, .strategy = CUTLIST_STRATEGY_FIRST_FIT_DECREASING, .kerfWidth = 3};
+    CutlistResult expected;
+    expected.assignments = &pieces[piece_count];
+    optimizeCutlist(piece_input, &expected);
+    TEST_ASSERT_EQUAL_INT(expected.stockUsed, result.stockUsed);
+    free(pieces);
+    freeCutlistDemandResult(&result);
+
+    // More lengths than the LP takes: the greedy patterns come back, reported as not searched
+    CutlistDemand many_lengths[100];
+    unsigned int seed = 3;
+    for (int i = 0; i < 100; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        many_lengths[i].length = 1000 + (int)((seed >> 16) % 1601);
+        many_lengths[i].quantity = 50;
+    }
+    CutlistDemandInput many_input = {many_lengths, 100, 6000};
+    optimizeCutlistDemand(many_input, &result);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_OK, result.status);
+    TEST_ASSERT_FALSE(result.provenOptimal);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STOP_SEARCH_SKIPPED, result.stopReason);
+    assertDemandPacking(&many_input, &result);
+    freeCutlistDemandResult(&result);
+}
+
+void testLocalSearchImprovesGreedyPacking(void)
+{
+    int piece_count = 3000;
+    int *required = (int *)malloc(piece_count * sizeof(int));
+    unsigned int seed = 11;
+    for (int i = 0; i < piece_count; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        required[i] = 1000 + (int)((seed >> 16) % 1601);
+    }
+
+    CutlistResult greedy_result;
+    greedy_result.assignments = (int *)malloc(piece_count * sizeof(int));
+    CutlistInput input = {required, piece_count, 6000, CUTLIST_TRACE_OFF, 1, CUTLIST_STRATEGY_BEST_FIT_DECREASING};
+    optimizeCutlist(input, &greedy_result);
+
+    // Two runs from the same seed end in the same packing, fewer stocks than the greedy one
+    CutlistResult results[2];
+    CutlistLocalSearchOptions options = {0, 50000, 2, 5};
+    for (int run = 0; run < 2; run++)
+    {
+        results[run] = greedy_result;
+        results[run].assignments = (int *)malloc(piece_count * sizeof(int));
+        memcpy(results[run].assignments, greedy_result.assignments, piece_count * sizeof(int));
+        TEST_ASSERT_EQUAL_INT(0, improveCutlistPacking(input, &options, &results[run]));
+        assertValidPacking(required, piece_count, 6000, &results[run]);
+    }
+    TEST_ASSERT_TRUE(results[0].stockUsed < greedy_result.stockUsed);
+    TEST_ASSERT_TRUE(results[0].stockUsed >= results[0].stockLowerBound);
+    TEST_ASSERT_EQUAL_INT(greedy_result.waste - (greedy_result.stockUsed - results[0].stockUsed) * 6000, results[0].waste);
+    TEST_ASSERT_EQUAL_INT(results[0].stockUsed, results[1].stockUsed);
+    TEST_ASSERT_EQUAL_INT_ARRAY(results[0].assignments, results[1].assignments, piece_count);
+    TEST_ASSERT_TRUE(results[0].stats.nodesExpanded >= greedy_result.stats.nodesExpanded + 50000);
+
+    // A packing that overfills a stock is left as it was
+    int stock_used = results[1].stockUsed;
+    for (int i = 0; i < 10; i++)
+    {
+        results[1].assignments[i] = results[1].assignments[10];
+    }
+    TEST_ASSERT_EQUAL_INT(-1, improveCutlistPacking(input, &options, &results[1]));
+    TEST_ASSERT_EQUAL_INT(stock_used, results[1].stockUsed);
+
+    free(results[0].assignments);
+    free(results[1].assignments);
+    free(greedy_result.assignments);
+    free(required);
 }
 
 void testOptimizeCutlist(void) 
@@ -298,16 +1896,14 @@ void testOptimizeCutlist(void)
     // Stock #1: [120, 45, 35] (0 leftover)
     // Stock #2: [70, 65, 60]  (0 leftover)
     
-    // rearranged required list = 120, 70, 65, 60, 45, 35
-    int expected_assignments[]  =  {0,  1,  1,  1,  0,  0};  // Expected stock indices per piece
+    // required list          =  60, 35, 45, 65, 70, 120
+    int expected_assignments[]  =  {1,  0,  0,  1,  1,  0};  // Expected stock indices per piece, in input order
 
     for (int i = 0; i < input.pieceCount; i++) 
     {
         TEST_ASSERT_EQUAL_INT(expected_assignments[i], result.assignments[i]);
     }
 
-    free(result.assignments);
-
     for (int i = 0; i < input.pieceCount; i++) 
     {
         if (expected_assignments[i] != result.assignments[i]) 
@@ -317,6 +1913,8 @@ void testOptimizeCutlist(void)
         }
         TEST_ASSERT_EQUAL_INT(expected_assignments[i], result.assignments[i]);
     }
+
+    free(result.assignments);
 }
 
 void testPieceTooLarge(void) 
@@ -332,6 +1930,7 @@ void testPieceTooLarge(void)
     // Expect failure flag values (-1)
     TEST_ASSERT_EQUAL_INT(-1, result.stockUsed);
     TEST_ASSERT_EQUAL_INT(-1, result.waste);
+    TEST_ASSERT_EQUAL_INT(CUTLIST_STATUS_PIECE_TOO_LONG, result.status);
 
     free(result.assignments);
 }
@@ -347,10 +1946,44 @@ int main(void)
     RUN_TEST(testAllPiecesFitMultipleStocksNoWaste);
     RUN_TEST(testStockWasteForced);
     RUN_TEST(testPieceTooLargeCannotFit);
-    // RUN_TEST(testCutlistOptimizationWithLargeDataset);
-    // RUN_TEST(testCutlistOptimizationWithVeryLargeDataset);
-
+    RUN_TEST(testCutlistOptimizationWithLargeDataset);
+    RUN_TEST(testCutlistOptimizationWithVeryLargeDataset);
+    RUN_TEST(testLargeDatasetReachesLowerBound);
+    RUN_TEST(testRepeatedLengthsProveOptimum);
+    RUN_TEST(testComputeStockLowerBound);
+
+    RUN_TEST(testTracingDoesNotChangeResult);
+    RUN_TEST(testInputIsNotModified);
+    RUN_TEST(testSortsManyPieces);
+    RUN_TEST(testParallelSearchMatchesSerial);
+    RUN_TEST(testGreedyStrategies);
+    RUN_TEST(testExactSearchProvesOptimality);
+    RUN_TEST(testNodeBudgetReturnsBestSoFar);
+    RUN_TEST(testTimeBudgetReturnsQuickly);
+    RUN_TEST(testCancellationAndProgress);
+    RUN_TEST(testStockKernelsMatchScalarScan);
+    RUN_TEST(testTranspositionTableKeepsPacking);
+    RUN_TEST(testPatternEngineMatchesBranchAndBound);
+    RUN_TEST(testPatternEngineSolvesLargeOrder);
+    RUN_TEST(testDecompositionImprovesLargeOrder);
+    RUN_TEST(testStockCatalogueMinimizesCost);
+    RUN_TEST(testKerfAndTrim);
+    RUN_TEST(testStockLengthNearIntMax);
+    RUN_TEST(testSearchStats);
     RUN_TEST(testGetStockAssignmentsAsString);
+    RUN_TEST(testGetStockAssignmentsAsStringManyPieces);
+    RUN_TEST(testFormatResultAsCsvAndJson);
+    RUN_TEST(testFormatLargeSheetStreamsToFile);
+    RUN_TEST(testSolverReusedAcrossSolves);
+    RUN_TEST(testReoptimizeChangedOrder);
+    RUN_TEST(testResultCacheAcrossRestarts);
+    RUN_TEST(testDeepSearchOnSmallStack);
+    RUN_TEST(testBatchMatchesSingleSolves);
+    RUN_TEST(testOrderFilesRoundTrip);
+    RUN_TEST(testOrderStreamSolvesFile);
+    RUN_TEST(testDemandMatchesExpandedPieces);
+    RUN_TEST(testDemandSolvesLargeQuantitiesInPatterns);
+    RUN_TEST(testLocalSearchImprovesGreedyPacking);
     RUN_TEST(testOptimizeCutlist);
     RUN_TEST(testPieceTooLarge);
 